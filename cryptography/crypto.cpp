@@ -10,106 +10,342 @@
 #include "crypto.h"
 
 /*
- * class ECDH
- * Wraps openssl and performs ECDH exchange
+ * class KeyExchange
+ * One side of a Diffie-Hellman style key exchange
+ */
+
+// Start with no secret
+KeyExchange::KeyExchange(): _done(false), _dead(false){}
+
+// Returns the public key for sharing with peer
+std::string KeyExchange::getPublicKey() const{
+    unsigned char buffer[maxPublicKeySize];
+    if(!getPublicKey(buffer)){
+        return std::string("");
+    }
+    return std::string((char*)buffer, publicKeyLength());
+}
+
+// Recieve public key from peer
+void KeyExchange::recieveKey(const std::string & otherKey){
+    recieveKey((const unsigned char *)otherKey.data(), otherKey.size());
+}
+
+// Retrieve shared secret
+std::string KeyExchange::getSecret() const{
+    if(!_done || _dead){
+        return std::string("");
+    }
+    else{
+        return std::string((char*)secret, secret_len);
+    }
+}
+
+// Copy shared secret to out
+std::size_t KeyExchange::getSecret(unsigned char * out, std::size_t len) const{
+    if(!_done || _dead || len < secret_len){
+        return 0;
+    }
+    std::copy(secret, secret + secret_len, out);
+    return secret_len;
+}
+
+// Handle errors reported by openssl API
+void KeyExchange::handleErrors(){
+    _dead = true;
+}
+
+// Wipe the secret
+KeyExchange::~KeyExchange(){
+	OPENSSL_cleanse(secret, sizeof(secret));
+}
+
+
+/*
+ * class ECDH : KeyExchange
+ * Wraps openssl and performs ECDH exchange on secp256k1
  */
 
 // Initialize context and generate key pair
-ECDH::ECDH(): _done(false), _dead(false){
-    // Create an Elliptic Curve Group object and set it up to use the secp256k1 curve
-	if(NULL == (group = EC_GROUP_new_by_curve_name(NID_secp256k1))) handleErrors();
-	std::cout << "created ec group\n";
-	
-	// Create an Elliptic Curve Key object
-	if(NULL == (key = EC_KEY_new())) handleErrors();
-	std::cout << "created ec\n";
-	
-	// Set the key to use the group we created
-	if(1 != EC_KEY_set_group(key, group)) handleErrors();
-	std::cout << "set ec group\n";
+ECDH::ECDH(){
+    const EC_GROUP * group = curve();
+    if(group == NULL){ handleErrors(); return; }
 	
-	if(NULL == (bn_ctx = BN_CTX_new())) handleErrors();
-	std::cout << "created bignum context\n";
+	// Create an Elliptic Curve Key object on the shared group
+	if(NULL == (key = EC_KEY_new())){ handleErrors(); return; }
+	if(1 != EC_KEY_set_group(key, group)){ handleErrors(); return; }
 	
 	// Generate the private and public key
-	if(1 != EC_KEY_generate_key(key)) handleErrors();
-	
-	std::cout << "generated keys\n";
+	if(1 != EC_KEY_generate_key(key)){ handleErrors(); return; }
 }
 
-// Returns the public key for sharing with peer
-std::string ECDH::getPublicKey() const{
+// Shared read-only secp256k1 group with generator precomputation, built once
+const EC_GROUP * ECDH::curve(){
+    static EC_GROUP * group = [](){
+        EC_GROUP * group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+        if(group != NULL){
+            // Best effort, the group still works without the table
+            EC_GROUP_precompute_mult(group, threadContext());
+        }
+        return group;
+    }();
+    return group;
+}
+
+// Per thread bignum context and scratch point, freed when the thread exits
+struct ECDHThreadCache {
+    BN_CTX * context = NULL;
+    EC_POINT * point = NULL;
+    
+    ~ECDHThreadCache(){
+        if(point != NULL) EC_POINT_free(point);
+        if(context != NULL) BN_CTX_free(context);
+    }
+};
+
+static thread_local ECDHThreadCache ecdhThreadCache;
+
+// Bignum context cached per thread
+BN_CTX * ECDH::threadContext(){
+    if(ecdhThreadCache.context == NULL){
+        ecdhThreadCache.context = BN_CTX_new();
+    }
+    return ecdhThreadCache.context;
+}
+
+// Scratch point cached per thread for decoding peer keys
+EC_POINT * ECDH::scratchPoint(){
+    if(ecdhThreadCache.point == NULL && curve() != NULL){
+        ecdhThreadCache.point = EC_POINT_new(curve());
+    }
+    return ecdhThreadCache.point;
+}
+
+// Length in bytes of the public key
+std::size_t ECDH::publicKeyLength() const{
+    return publicKeySize;
+}
+
+// Write the 64 byte public key to out
+bool ECDH::getPublicKey(unsigned char * out) const{
     if(_dead){
-        return std::string("");
+        return false;
     }
     
-    unsigned char buffer[65];
+    unsigned char buffer[publicKeySize + 1];
     
     const EC_POINT * point = EC_KEY_get0_public_key(key);
-    std::cout << "grabbed public key\n";
+    if(sizeof(buffer) != EC_POINT_point2oct(curve(), point, POINT_CONVERSION_UNCOMPRESSED, buffer, sizeof(buffer), threadContext())){
+        return false;
+    }
+    
+    // Drop the uncompressed point marker
+    std::copy(buffer + 1, buffer + sizeof(buffer), out);
+    return true;
+}
+
+// Recieve 64 byte public key from peer
+void ECDH::recieveKey(const unsigned char * otherKey, std::size_t len){
+    if(_done || _dead) return;
     
-    std::cout << EC_POINT_point2oct(group, point, POINT_CONVERSION_UNCOMPRESSED, buffer, 65, bn_ctx) << "\n";
+    // Decode into this thread's scratch point
+    EC_POINT * peerkey = scratchPoint();
+    if(peerkey == NULL || len != publicKeySize) return handleErrors();
     
-    std::cout << "public key converted\n";
+    // Peer sends raw x and y, prepend the uncompressed point marker
+    unsigned char octets[publicKeySize + 1];
+    octets[0] = 0x4;
+    std::copy(otherKey, otherKey + publicKeySize, octets + 1);
     
-    return std::string((char*)(buffer+1), 64);
+    if(1 != EC_POINT_oct2point(curve(), peerkey, octets, sizeof(octets), threadContext())) return handleErrors();
+
+	/* Derive the shared secret, secp256k1 gives 32 bytes */
+	int length = ECDH_compute_key(secret, secretSize, peerkey, key, NULL);
+	if(length <= 0) return handleErrors();
+	secret_len = length;
+	
+	_done = true;
 }
 
-// Recieve public key from peer
-void ECDH::recieveKey(const std::string & otherKey){
+// Free up memory
+ECDH::~ECDH(){
+    if(key != NULL) EC_KEY_free(key);
+}
+
+
+/*
+ * class X25519 : KeyExchange
+ * X25519 key exchange through the EVP_PKEY API
+ */
+
+// Generate key pair
+X25519::X25519(){
+    EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
+    if(ctx == NULL || 1 != EVP_PKEY_keygen_init(ctx) || 1 != EVP_PKEY_keygen(ctx, &_key)){
+        handleErrors();
+    }
+    EVP_PKEY_CTX_free(ctx);
+}
+
+// Length in bytes of the public key
+std::size_t X25519::publicKeyLength() const{
+    return publicKeySize;
+}
+
+// Write the 32 byte public key to out
+bool X25519::getPublicKey(unsigned char * out) const{
+    std::size_t len = publicKeySize;
+    return !_dead && 1 == EVP_PKEY_get_raw_public_key(_key, out, &len) && len == publicKeySize;
+}
+
+// Recieve 32 byte public key from peer
+void X25519::recieveKey(const unsigned char * otherKey, std::size_t len){
     if(_done || _dead) return;
+    if(len != publicKeySize) return handleErrors();
     
-    // Grab the keys
-    EC_POINT * peerkey = EC_POINT_new(group);
+    EVP_PKEY * peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, otherKey, len);
+    EVP_PKEY_CTX * ctx = peer ? EVP_PKEY_CTX_new(_key, NULL) : NULL;
     
-    // 
-    std::string octetString;
-    octetString.push_back((char)0x4);
-    octetString += otherKey;
+    // OpenSSL rejects low order points, which would give an all zero secret
+    secret_len = secretSize;
+    bool ok = ctx != NULL &&
+        1 == EVP_PKEY_derive_init(ctx) &&
+        1 == EVP_PKEY_derive_set_peer(ctx, peer) &&
+        1 == EVP_PKEY_derive(ctx, secret, &secret_len);
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(peer);
+    if(!ok || secret_len != secretSize) return handleErrors();
     
-    if(1 != EC_POINT_oct2point(group, peerkey, (unsigned char*)octetString.c_str(), octetString.size(), bn_ctx)) handleErrors();
-    std::cout << "converted string to ec point\n";
+    _done = true;
+}
 
-    /* Calculate the size of the buffer for the shared secret */
-	field_size = EC_GROUP_get_degree(group);
-	secret_len = (field_size+7)/8;
-	std::cout << "calculated field size\n";
+// Free key
+X25519::~X25519(){
+    EVP_PKEY_free(_key);
+}
 
-	/* Allocate the memory for the shared secret */
-	if(NULL == (secret = (unsigned char*)OPENSSL_malloc(secret_len))) handleErrors();
-	std::cout << "allocated space for shared secret\n";
 
-	/* Derive the shared secret */
-	secret_len = ECDH_compute_key(secret, secret_len, peerkey, key, NULL);
-	std::cout << "calculated shared secret\n";
-	
-	EC_POINT_free(peerkey);
-	std::cout << "free peerkey\n";
-	
-	_done = true;
+/*
+ * class ECDHKeyPool
+ * Pool of pregenerated ECDH key pairs, refilled by background threads
+ */
+
+// Start threads that keep up to depth key pairs ready
+ECDHKeyPool::ECDHKeyPool(std::size_t depth, unsigned int threads): _depth(depth), _stop(false), _stalls(0){
+    _keys.reserve(_depth);
+    for(unsigned int i=0; i<threads; i++){
+        _threads.emplace_back(&ECDHKeyPool::fill, this);
+    }
 }
 
-// Retrieve shared secret
-std::string ECDH::getSecret() const{
-    if(!_done || _dead){
-        return std::string("");
+// Take a ready key pair, generates one inline (and counts a stall) if the pool is empty
+std::unique_ptr<ECDH> ECDHKeyPool::acquire(){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_keys.empty()){
+            std::unique_ptr<ECDH> keys = std::move(_keys.back());
+            _keys.pop_back();
+            _refill.notify_one();
+            return keys;
+        }
     }
-    else{
-        return std::string((char*)secret, secret_len);
+    
+    _stalls++;
+    _refill.notify_one();
+    return std::unique_ptr<ECDH>(new ECDH());
+}
+
+// Number of key pairs ready to hand out
+std::size_t ECDHKeyPool::available(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _keys.size();
+}
+
+// Target number of ready key pairs
+std::size_t ECDHKeyPool::depth() const{
+    return _depth;
+}
+
+// Number of acquires that found the pool empty
+unsigned long long ECDHKeyPool::stalls() const{
+    return _stalls;
+}
+
+// Stop and join the refill threads
+ECDHKeyPool::~ECDHKeyPool(){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _refill.notify_all();
+    for(auto & thread : _threads){
+        thread.join();
     }
 }
 
-// Handle errors reported by openssl API
-void ECDH::handleErrors(){
-    _dead = true;
+// Refill thread body, generates keys outside the lock
+void ECDHKeyPool::fill(){
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(true){
+        _refill.wait(lock, [this]{ return _stop || _keys.size() < _depth; });
+        if(_stop) return;
+        
+        lock.unlock();
+        std::unique_ptr<ECDH> keys(new ECDH());
+        lock.lock();
+        
+        if(_keys.size() < _depth){
+            _keys.push_back(std::move(keys));
+        }
+    }
 }
 
-// Free up memory
-ECDH::~ECDH(){
-    if(key != NULL) EC_KEY_free(key);
-    if(group != NULL) EC_GROUP_free(group);
-	if(bn_ctx != NULL) BN_CTX_free(bn_ctx);
-	if(secret != NULL) delete secret;
+
+
+/*
+ * class AESGCM
+ * AES-256-GCM with a fixed key and preallocated cipher contexts
+ */
+
+// Set up encrypt and decrypt contexts for the given 32 byte key
+AESGCM::AESGCM(const std::string & key){
+    if(key.size() != keySize){
+        throw std::invalid_argument("AES-256-GCM needs a 32 byte key.");
+    }
+    const unsigned char * k = (const unsigned char *)key.data();
+    _encrypt = EVP_CIPHER_CTX_new();
+    _decrypt = EVP_CIPHER_CTX_new();
+    if(_encrypt == NULL || _decrypt == NULL ||
+       1 != EVP_EncryptInit_ex(_encrypt, EVP_aes_256_gcm(), NULL, k, NULL) ||
+       1 != EVP_DecryptInit_ex(_decrypt, EVP_aes_256_gcm(), NULL, k, NULL)){
+        EVP_CIPHER_CTX_free(_encrypt);
+        EVP_CIPHER_CTX_free(_decrypt);
+        throw std::runtime_error("Could not set up AES-256-GCM context.");
+    }
+}
+
+// Encrypt len bytes of data in place and write the tag
+bool AESGCM::encrypt(unsigned char * data, std::size_t len, const unsigned char * iv, unsigned char * tag){
+    int outlen;
+    return 1 == EVP_EncryptInit_ex(_encrypt, NULL, NULL, NULL, iv) &&
+           1 == EVP_EncryptUpdate(_encrypt, data, &outlen, data, len) &&
+           1 == EVP_EncryptFinal_ex(_encrypt, data + outlen, &outlen) &&
+           1 == EVP_CIPHER_CTX_ctrl(_encrypt, EVP_CTRL_GCM_GET_TAG, tagSize, tag);
+}
+
+// Decrypt len bytes of data in place, false if the tag does not match
+bool AESGCM::decrypt(unsigned char * data, std::size_t len, const unsigned char * iv, const unsigned char * tag){
+    int outlen;
+    return 1 == EVP_DecryptInit_ex(_decrypt, NULL, NULL, NULL, iv) &&
+           1 == EVP_DecryptUpdate(_decrypt, data, &outlen, data, len) &&
+           1 == EVP_CIPHER_CTX_ctrl(_decrypt, EVP_CTRL_GCM_SET_TAG, tagSize, (void *)tag) &&
+           1 == EVP_DecryptFinal_ex(_decrypt, data + outlen, &outlen);
+}
+
+// Free contexts
+AESGCM::~AESGCM(){
+    EVP_CIPHER_CTX_free(_encrypt);
+    EVP_CIPHER_CTX_free(_decrypt);
 }
 
 
@@ -118,6 +354,473 @@ ECDH::~ECDH(){
  * Crypto Functions
  */
 
+/*
+ * SHA extension kernels
+ * Hash one whole message per call straight on the cpu's SHA instructions,
+ * which skips the EVP dispatch that dominates the cost of small inputs.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+
+#define SHA_SIMD
+
+// Check for SHA extensions and SSE4.1
+static bool shaExtensions(){
+    unsigned int a, b, c, d;
+    if(!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1)) return false;
+    if(!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return false;
+    return (b & (1u << 29)) != 0;
+}
+
+static const bool hasShaExtensions = shaExtensions();
+
+// Longer messages go through EVP, whose own SHA code is faster once call overhead stops mattering
+static const std::size_t shaKernelMax = 256;
+
+static const unsigned int sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Run SHA-256 over count 64 byte blocks, state is ABEF and CDGH
+__attribute__((target("sha,sse4.1")))
+static void sha256Blocks(__m128i & abef, __m128i & cdgh, const unsigned char * data, std::size_t count){
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    for(; count > 0; count--, data += 64){
+        __m128i abefSave = abef, cdghSave = cdgh;
+        __m128i msg[4];
+        
+        #pragma GCC unroll 16
+        for(int i=0; i<16; i++){
+            if(i < 4){
+                msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), swap);
+            }
+            __m128i words = _mm_add_epi32(msg[i % 4], _mm_loadu_si128((const __m128i *)(sha256K + 4 * i)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            if(i >= 3 && i <= 14){
+                __m128i & next = msg[(i + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(msg[i % 4], msg[(i + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, msg[i % 4]);
+            }
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0e));
+            if(i >= 1 && i <= 12){
+                msg[(i + 3) % 4] = _mm_sha256msg1_epu32(msg[(i + 3) % 4], msg[i % 4]);
+            }
+        }
+        
+        abef = _mm_add_epi32(abef, abefSave);
+        cdgh = _mm_add_epi32(cdgh, cdghSave);
+    }
+}
+
+// Run SHA-1 over count 64 byte blocks
+__attribute__((target("sha,sse4.1")))
+static void sha1Blocks(__m128i & abcd, __m128i & e0, const unsigned char * data, std::size_t count){
+    const __m128i swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    for(; count > 0; count--, data += 64){
+        __m128i abcdSave = abcd, eSave = e0;
+        __m128i msg[4], e[2] = { e0, e0 };
+        
+        #pragma GCC unroll 20
+        for(int g=0; g<20; g++){
+            if(g < 4){
+                msg[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * g)), swap);
+            }
+            int cur = g & 1;
+            e[cur] = (g == 0) ? _mm_add_epi32(e[0], msg[0]) : _mm_sha1nexte_epu32(e[cur], msg[g % 4]);
+            e[cur ^ 1] = abcd;
+            if(g >= 3 && g <= 18){
+                msg[(g + 1) % 4] = _mm_sha1msg2_epu32(msg[(g + 1) % 4], msg[g % 4]);
+            }
+            switch(g / 5){
+                case 0: abcd = _mm_sha1rnds4_epu32(abcd, e[cur], 0); break;
+                case 1: abcd = _mm_sha1rnds4_epu32(abcd, e[cur], 1); break;
+                case 2: abcd = _mm_sha1rnds4_epu32(abcd, e[cur], 2); break;
+                default: abcd = _mm_sha1rnds4_epu32(abcd, e[cur], 3); break;
+            }
+            if(g >= 1 && g <= 16){
+                msg[(g + 3) % 4] = _mm_sha1msg1_epu32(msg[(g + 3) % 4], msg[g % 4]);
+            }
+            if(g >= 2 && g <= 17){
+                msg[(g + 2) % 4] = _mm_xor_si128(msg[(g + 2) % 4], msg[g % 4]);
+            }
+        }
+        
+        e0 = _mm_sha1nexte_epu32(e[0], eSave);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+}
+
+// Lay out the padded final blocks of a message, returns how many there are
+static std::size_t shaPad(const unsigned char * tail, std::size_t remainder, unsigned long long total, unsigned char * blocks){
+    std::fill(blocks, blocks + 128, 0);
+    std::copy(tail, tail + remainder, blocks);
+    blocks[remainder] = 0x80;
+    std::size_t count = remainder < 56 ? 1 : 2;
+    unsigned long long bits = total * 8;
+    for(int i=0; i<8; i++){
+        blocks[64 * count - 1 - i] = (unsigned char)(bits >> (8 * i));
+    }
+    return count;
+}
+
+// SHA-256 of one message
+__attribute__((target("sha,sse4.1")))
+static void sha256Message(const unsigned char * data, std::size_t len, unsigned char * out){
+    // Initial state arranged as ABEF and CDGH
+    __m128i abef = _mm_set_epi32(0x6a09e667, 0xbb67ae85, 0x510e527f, 0x9b05688c);
+    __m128i cdgh = _mm_set_epi32(0x3c6ef372, 0xa54ff53a, 0x1f83d9ab, 0x5be0cd19);
+    
+    sha256Blocks(abef, cdgh, data, len / 64);
+    unsigned char blocks[128];
+    std::size_t count = shaPad(data + len / 64 * 64, len % 64, len, blocks);
+    sha256Blocks(abef, cdgh, blocks, count);
+    
+    // Back to ABCD EFGH, then big-endian bytes
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    __m128i dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+    __m128i hgfe = _mm_alignr_epi8(dchg, feba, 8);
+    const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(dcba, swap));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_shuffle_epi8(hgfe, swap));
+}
+
+// SHA-1 of one message
+__attribute__((target("sha,sse4.1")))
+static void sha1Message(const unsigned char * data, std::size_t len, unsigned char * out){
+    __m128i abcd = _mm_set_epi32(0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476);
+    __m128i e = _mm_set_epi32(0xc3d2e1f0, 0, 0, 0);
+    
+    sha1Blocks(abcd, e, data, len / 64);
+    unsigned char blocks[128];
+    std::size_t count = shaPad(data + len / 64 * 64, len % 64, len, blocks);
+    sha1Blocks(abcd, e, blocks, count);
+    
+    const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(abcd, swap));
+    unsigned int last = (unsigned int)_mm_extract_epi32(e, 3);
+    for(int i=0; i<4; i++){
+        out[16 + i] = (unsigned char)(last >> (24 - 8 * i));
+    }
+}
+#endif
+
+
+/*
+ * class Hasher
+ * Incremental SHA-1 or SHA-256 hash with a reusable context
+ */
+
+// Set up a context for the given algorithm
+Hasher::Hasher(Algorithm algorithm): _algorithm(algorithm), _md(digest(algorithm)){
+    _ctx = EVP_MD_CTX_new();
+    if(_md == NULL || _ctx == NULL || 1 != EVP_DigestInit_ex(_ctx, _md, NULL)){
+        EVP_MD_CTX_free(_ctx);
+        throw std::runtime_error("Could not set up digest context.");
+    }
+}
+
+// Digest implementation for an algorithm, the built in tables work on OpenSSL 1.1 and 3
+const EVP_MD * Hasher::digest(Algorithm algorithm){
+    return algorithm == Sha1 ? EVP_sha1() : EVP_sha256();
+}
+
+// Add data to the running hash
+void Hasher::update(const void * data, std::size_t len){
+    if(1 != EVP_DigestUpdate(_ctx, data, len)){
+        throw std::runtime_error("Digest update failed.");
+    }
+}
+
+// Add string to the running hash
+void Hasher::update(const std::string & str){
+    update(str.data(), str.size());
+}
+
+// Write the digest to out and start over
+std::size_t Hasher::final(unsigned char * out){
+    unsigned int len = 0;
+    if(1 != EVP_DigestFinal_ex(_ctx, out, &len) || 1 != EVP_DigestInit_ex(_ctx, _md, NULL)){
+        throw std::runtime_error("Digest final failed.");
+    }
+    return len;
+}
+
+// Returns the digest and starts over
+std::string Hasher::final(){
+    unsigned char out[maxSize];
+    std::size_t len = final(out);
+    return std::string((char *)out, len);
+}
+
+// Drop any data added since the last final
+void Hasher::reset(){
+    if(1 != EVP_DigestInit_ex(_ctx, _md, NULL)){
+        throw std::runtime_error("Digest reset failed.");
+    }
+}
+
+// Digest size in bytes
+std::size_t Hasher::size() const{
+    return EVP_MD_size(_md);
+}
+
+// Hash count independent buffers, writing count * size() bytes to out
+void Hasher::hashBatch(const unsigned char * const * data, const std::size_t * lens, std::size_t count, unsigned char * out){
+    std::size_t step = size();
+    for(std::size_t i=0; i<count; i++, out += step){
+#ifdef SHA_SIMD
+        if(hasShaExtensions && lens[i] < shaKernelMax){
+            if(_algorithm == Sha1) sha1Message(data[i], lens[i], out);
+            else sha256Message(data[i], lens[i], out);
+            continue;
+        }
+#endif
+        update(data[i], lens[i]);
+        final(out);
+    }
+}
+
+// Hash count buffers of len bytes laid out back to back
+void Hasher::hashBatch(const unsigned char * data, std::size_t len, std::size_t count, unsigned char * out){
+    std::size_t step = size();
+#ifdef SHA_SIMD
+    if(hasShaExtensions && len < shaKernelMax){
+        for(std::size_t i=0; i<count; i++, data += len, out += step){
+            if(_algorithm == Sha1) sha1Message(data, len, out);
+            else sha256Message(data, len, out);
+        }
+        return;
+    }
+#endif
+    for(std::size_t i=0; i<count; i++, data += len, out += step){
+        update(data, len);
+        final(out);
+    }
+}
+
+// Free context
+Hasher::~Hasher(){
+    EVP_MD_CTX_free(_ctx);
+}
+
+// Derive key material from a shared secret with HKDF-SHA256
+std::string hkdf(const std::string & secret, const std::string & salt, const std::string & info, std::size_t length){
+    std::string out(length, '\0');
+    std::size_t outlen = length;
+    EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+    bool ok = ctx != NULL &&
+        1 == EVP_PKEY_derive_init(ctx) &&
+        1 == EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) &&
+        1 == EVP_PKEY_CTX_set1_hkdf_salt(ctx, (const unsigned char *)salt.data(), salt.size()) &&
+        1 == EVP_PKEY_CTX_set1_hkdf_key(ctx, (const unsigned char *)secret.data(), secret.size()) &&
+        1 == EVP_PKEY_CTX_add1_hkdf_info(ctx, (const unsigned char *)info.data(), info.size()) &&
+        1 == EVP_PKEY_derive(ctx, (unsigned char *)&out[0], &outlen);
+    EVP_PKEY_CTX_free(ctx);
+    if(!ok || outlen != length){
+        throw std::runtime_error("HKDF key derivation failed.");
+    }
+    return out;
+}
+
+static const char hex_table[17] = "0123456789abcdef";
+
+// Value of a hex digit, or -1
+static int hexValue(char c){
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Hex kernels
+ * Like the base64 kernels below, each handles whole blocks and returns how
+ * much input it consumed. Decoding stops at the first block with a bad digit
+ * and leaves it for the scalar code to report.
+ */
+
+// Encode bytes one at a time, returns bytes consumed
+static std::size_t hexEncodeScalar(const unsigned char * data, std::size_t len, char * out){
+    for(std::size_t i=0; i<len; i++){
+        out[2*i] = hex_table[data[i] >> 4];
+        out[2*i+1] = hex_table[data[i] & 0xf];
+    }
+    return len;
+}
+
+// Decoding is left entirely to the scalar tail
+static std::size_t hexDecodeScalar(const char *, std::size_t, unsigned char *){
+    return 0;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define HEX_SIMD
+
+// Map 16 hex digits of either case to nibbles, valid has all bits set if every digit is legal
+__attribute__((target("ssse3")))
+static inline __m128i hexNibbles(__m128i chars, __m128i & valid){
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    valid = _mm_or_si128(isDigit, isLetter);
+    return _mm_or_si128(_mm_and_si128(isDigit, digit),
+                        _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// Encode 16 bytes per step
+__attribute__((target("ssse3")))
+static std::size_t hexEncodeSSSE3(const unsigned char * data, std::size_t len, char * out){
+    const __m128i digits = _mm_loadu_si128((const __m128i *)hex_table);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    std::size_t i = 0;
+    for(; i + 16 <= len; i += 16, out += 32){
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, nibble));
+        _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+// Decode 32 digits per step
+__attribute__((target("ssse3")))
+static std::size_t hexDecodeSSSE3(const char * str, std::size_t len, unsigned char * out){
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    std::size_t i = 0;
+    for(; i + 32 <= len; i += 32, out += 16){
+        __m128i validFirst, validSecond;
+        __m128i first = hexNibbles(_mm_loadu_si128((const __m128i *)(str + i)), validFirst);
+        __m128i second = hexNibbles(_mm_loadu_si128((const __m128i *)(str + i + 16)), validSecond);
+        if(_mm_movemask_epi8(_mm_and_si128(validFirst, validSecond)) != 0xffff) break;
+        _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_maddubs_epi16(first, weights),
+                                                          _mm_maddubs_epi16(second, weights)));
+    }
+    return i;
+}
+
+// Encode 32 bytes per step, then 16 at a time
+__attribute__((target("avx2")))
+static std::size_t hexEncodeAVX2(const unsigned char * data, std::size_t len, char * out){
+    const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hex_table));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    std::size_t i = 0;
+    for(; i + 32 <= len; i += 32, out += 64){
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(bytes, nibble));
+        __m256i first = _mm256_unpacklo_epi8(high, low), second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i *)out, _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i + hexEncodeSSSE3(data + i, len - i, out);
+}
+
+// Map 32 hex digits of either case to nibbles, valid has all bits set if every digit is legal
+__attribute__((target("avx2")))
+static inline __m256i hexNibbles(__m256i chars, __m256i & valid){
+    __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+    valid = _mm256_or_si256(isDigit, isLetter);
+    return _mm256_or_si256(_mm256_and_si256(isDigit, digit),
+                           _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+// Decode 64 digits per step, then 32 at a time
+__attribute__((target("avx2")))
+static std::size_t hexDecodeAVX2(const char * str, std::size_t len, unsigned char * out){
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    std::size_t i = 0;
+    for(; i + 64 <= len; i += 64, out += 32){
+        __m256i validFirst, validSecond;
+        __m256i first = hexNibbles(_mm256_loadu_si256((const __m256i *)(str + i)), validFirst);
+        __m256i second = hexNibbles(_mm256_loadu_si256((const __m256i *)(str + i + 32)), validSecond);
+        if(_mm256_movemask_epi8(_mm256_and_si256(validFirst, validSecond)) != -1) break;
+        __m256i bytes = _mm256_packus_epi16(_mm256_maddubs_epi16(first, weights),
+                                            _mm256_maddubs_epi16(second, weights));
+        _mm256_storeu_si256((__m256i *)out, _mm256_permute4x64_epi64(bytes, 0xd8));
+    }
+    return i + hexDecodeSSSE3(str + i, len - i, out);
+}
+#endif
+
+// Hex kernels picked for this cpu
+struct HexKernels {
+    std::size_t (*encode)(const unsigned char *, std::size_t, char *);
+    std::size_t (*decode)(const char *, std::size_t, unsigned char *);
+    const char * name;
+};
+
+// Pick the widest kernels the cpu supports
+static HexKernels hexSelect(){
+#ifdef HEX_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        return HexKernels{hexEncodeAVX2, hexDecodeAVX2, "avx2"};
+    }
+    if(__builtin_cpu_supports("ssse3")){
+        return HexKernels{hexEncodeSSSE3, hexDecodeSSSE3, "ssse3"};
+    }
+#endif
+    return HexKernels{hexEncodeScalar, hexDecodeScalar, "scalar"};
+}
+
+static const HexKernels hexKernels = hexSelect();
+
+// Name of the hex kernel used on this cpu
+const char * hexKernel(){
+    return hexKernels.name;
+}
+
+// Encode binary data as lowercase hex
+std::string hexEncode(const std::string & bindata){
+    std::string retval(bindata.size()*2, '0');
+    hexEncode((const unsigned char *)bindata.data(), bindata.size(), &retval[0]);
+    return retval;
+}
+
+// Write 2*len hex digits for data to out
+void hexEncode(const unsigned char * data, std::size_t len, char * out){
+    std::size_t done = hexKernels.encode(data, len, out);
+    hexEncodeScalar(data + done, len - done, out + 2*done);
+}
+
+// Decode hex string to binary data
+std::string hexDecode(const std::string & hexdata){
+    std::string retval(hexdata.size()/2, '\0');
+    hexDecode(hexdata.data(), hexdata.size(), (unsigned char *)&retval[0]);
+    return retval;
+}
+
+// Decode len hex digits to len/2 bytes at out
+void hexDecode(const char * hexdata, std::size_t len, unsigned char * out){
+    if(len % 2 != 0){
+        throw std::invalid_argument("Hex string has an odd number of digits.");
+    }
+    for(std::size_t i=hexKernels.decode(hexdata, len, out); i<len; i+=2){
+        int high = hexValue(hexdata[i]), low = hexValue(hexdata[i+1]);
+        if(high < 0 || low < 0){
+            throw std::invalid_argument("This contains characters not legal in a hex string.");
+        }
+        out[i/2] = (unsigned char)((high << 4) | low);
+    }
+}
+
 static const char b64_table[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
 static const char reverse_table[128] = {
@@ -131,6 +834,208 @@ static const char reverse_table[128] = {
    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64
 };
 
+/*
+ * Base64 kernels
+ * Each kernel handles as many whole blocks as it safely can and returns how
+ * much input it consumed, the scalar code finishes the tail. The widest
+ * kernel the cpu supports is picked once at startup.
+ */
+
+// Encode whole 3 byte groups, returns bytes consumed
+static std::size_t base64EncodeScalar(const unsigned char * in, std::size_t len, char * out){
+    std::size_t i = 0;
+    for(; i + 3 <= len; i += 3){
+        unsigned int group = (in[i] << 16) | (in[i+1] << 8) | in[i+2];
+        *out++ = b64_table[group >> 18];
+        *out++ = b64_table[(group >> 12) & 0x3f];
+        *out++ = b64_table[(group >> 6) & 0x3f];
+        *out++ = b64_table[group & 0x3f];
+    }
+    return i;
+}
+
+// Decode whole blocks of 4 alphabet characters, stops at the first block
+// holding whitespace, padding or anything invalid. Returns characters consumed
+static std::size_t base64DecodeScalar(const char * in, std::size_t len, unsigned char * out, std::size_t * written){
+    std::size_t i = 0, o = 0;
+    for(; i + 4 <= len; i += 4){
+        unsigned char a = in[i], b = in[i+1], c = in[i+2], d = in[i+3];
+        if((a | b | c | d) > 127) break;
+        unsigned int va = reverse_table[a], vb = reverse_table[b], vc = reverse_table[c], vd = reverse_table[d];
+        if((va | vb | vc | vd) > 63) break;
+        unsigned int group = (va << 18) | (vb << 12) | (vc << 6) | vd;
+        out[o++] = (unsigned char)(group >> 16);
+        out[o++] = (unsigned char)(group >> 8);
+        out[o++] = (unsigned char)group;
+    }
+    *written = o;
+    return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define BASE64_SIMD
+
+// Spread 12 bytes into 16 six bit indices, one per byte
+__attribute__((target("ssse3")))
+static inline __m128i base64Split(__m128i in){
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(ac, bd);
+}
+
+// Map six bit indices to alphabet characters
+__attribute__((target("ssse3")))
+static inline __m128i base64Translate(__m128i indices){
+    const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(shift, range));
+}
+
+// Map 16 characters to six bit values, valid is zero unless some character is not in the alphabet
+__attribute__((target("ssse3")))
+static inline __m128i base64Values(__m128i in, __m128i & valid){
+    const __m128i lutLow = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHigh = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                          0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+    __m128i low = _mm_and_si128(in, nibble);
+    valid = _mm_and_si128(_mm_shuffle_epi8(lutLow, low), _mm_shuffle_epi8(lutHigh, high));
+    __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+    return _mm_add_epi8(in, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(slash, high)));
+}
+
+// Pack 16 six bit values into 12 bytes at the front of the register
+__attribute__((target("ssse3")))
+static inline __m128i base64Pack(__m128i values){
+    __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// Encode 12 bytes per step, reads 16
+__attribute__((target("ssse3")))
+static std::size_t base64EncodeSSSE3(const unsigned char * in, std::size_t len, char * out){
+    std::size_t i = 0;
+    for(; i + 16 <= len; i += 12, out += 16){
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)out, base64Translate(base64Split(bytes)));
+    }
+    return i;
+}
+
+// Decode 16 characters per step, writes 16 bytes per 12 decoded
+__attribute__((target("ssse3")))
+static std::size_t base64DecodeSSSE3(const char * in, std::size_t len, unsigned char * out, std::size_t * written){
+    std::size_t i = 0, o = 0;
+    for(; i + 16 <= len; i += 16, o += 12){
+        __m128i valid;
+        __m128i values = base64Values(_mm_loadu_si128((const __m128i *)(in + i)), valid);
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0xffff) break;
+        _mm_storeu_si128((__m128i *)(out + o), base64Pack(values));
+    }
+    *written = o;
+    return i;
+}
+
+// Encode 24 bytes per step, reads 28
+__attribute__((target("avx2")))
+static std::size_t base64EncodeAVX2(const unsigned char * in, std::size_t len, char * out){
+    const __m256i split = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                           1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    std::size_t i = 0;
+    for(; i + 28 <= len; i += 24, out += 32){
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + i))),
+                                                _mm_loadu_si128((const __m128i *)(in + i + 12)), 1);
+        bytes = _mm256_shuffle_epi8(bytes, split);
+        __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(ac, bd);
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *)out, _mm256_add_epi8(indices, _mm256_shuffle_epi8(shift, range)));
+    }
+    return i;
+}
+
+// Decode 32 characters per step, writes 32 bytes per 24 decoded
+__attribute__((target("avx2")))
+static std::size_t base64DecodeAVX2(const char * in, std::size_t len, unsigned char * out, std::size_t * written){
+    const __m256i lutLow = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lutHigh = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                             0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                             0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                             0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    std::size_t i = 0, o = 0;
+    for(; i + 32 <= len; i += 32, o += 24){
+        __m256i chars = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi32(chars, 4), nibble);
+        __m256i low = _mm256_and_si256(chars, nibble);
+        __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lutLow, low), _mm256_shuffle_epi8(lutHigh, high));
+        if(!_mm256_testz_si256(invalid, invalid)) break;
+        __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+        __m256i values = _mm256_add_epi8(chars, _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(slash, high)));
+        __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        words = _mm256_shuffle_epi8(words, pack);
+        words = _mm256_permutevar8x32_epi32(words, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)(out + o), words);
+    }
+    *written = o;
+    return i;
+}
+#endif
+
+// Base64 kernels picked for this cpu
+struct Base64Kernels {
+    std::size_t (*encode)(const unsigned char *, std::size_t, char *);
+    std::size_t (*decode)(const char *, std::size_t, unsigned char *, std::size_t *);
+    std::size_t slack;  // Bytes decode may store past its output
+    const char * name;
+};
+
+// Pick the widest kernels the cpu supports
+static Base64Kernels base64Select(){
+#ifdef BASE64_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        return Base64Kernels{base64EncodeAVX2, base64DecodeAVX2, 8, "avx2"};
+    }
+    if(__builtin_cpu_supports("ssse3")){
+        return Base64Kernels{base64EncodeSSSE3, base64DecodeSSSE3, 4, "ssse3"};
+    }
+#endif
+    return Base64Kernels{base64EncodeScalar, base64DecodeScalar, 0, "scalar"};
+}
+
+static const Base64Kernels base64Kernels = base64Select();
+
+// Name of the base64 kernel used on this cpu
+const char * base64Kernel(){
+    return base64Kernels.name;
+}
+
 // Encode the given binary data in base64
 std::string base64Encode(const std::string &bindata)
 {
@@ -141,68 +1046,95 @@ std::string base64Encode(const std::string &bindata)
       throw std::length_error("Converting too large a string to base64.");
    }
 
-   const std::size_t binlen = bindata.size();
-   // Use = signs so the end is properly padded.
-   string retval((((binlen + 2) / 3) * 4), '=');
-   std::size_t outpos = 0;
-   int bits_collected = 0;
-   unsigned int accumulator = 0;
-   const string::const_iterator binend = bindata.end();
-
-   for (string::const_iterator i = bindata.begin(); i != binend; ++i) {
-      accumulator = (accumulator << 8) | (*i & 0xffu);
-      bits_collected += 8;
-      while (bits_collected >= 6) {
-         bits_collected -= 6;
-         retval[outpos++] = b64_table[(accumulator >> bits_collected) & 0x3fu];
-      }
+   string retval(base64EncodedSize(bindata.size()), '=');
+   base64Encode((const unsigned char *)bindata.data(), bindata.size(), &retval[0]);
+   return retval;
+}
+
+// Write base64EncodedSize(len) characters for data to out
+void base64Encode(const unsigned char * in, std::size_t binlen, char * out)
+{
+   // Vector kernel first, then whole groups, then the partial group
+   std::size_t done = base64Kernels.encode(in, binlen, out);
+   done += base64EncodeScalar(in + done, binlen - done, out + done / 3 * 4);
+   out += done / 3 * 4;
+   if (binlen - done == 1) {
+      *out++ = b64_table[in[done] >> 2];
+      *out++ = b64_table[(in[done] & 0x3) << 4];
+      *out++ = '=';
+      *out++ = '=';
    }
-   if (bits_collected > 0) { // Any trailing bits that are missing.
-      assert(bits_collected < 6);
-      accumulator <<= 6 - bits_collected;
-      retval[outpos++] = b64_table[accumulator & 0x3fu];
+   else if (binlen - done == 2) {
+      *out++ = b64_table[in[done] >> 2];
+      *out++ = b64_table[((in[done] & 0x3) << 4) | (in[done+1] >> 4)];
+      *out++ = b64_table[(in[done+1] & 0xf) << 2];
+      *out++ = '=';
    }
-   assert(outpos >= (retval.size() - 2));
-   assert(outpos <= retval.size());
-   return retval;
 }
 
 // Decode the given base64 string into binary data
 std::string base64Decode(const std::string &ascdata)
 {
-   using std::string;
-   string retval;
-   const string::const_iterator last = ascdata.end();
+   std::string retval(base64DecodedMaxSize(ascdata.size()), '\0');
+   retval.resize(base64Decode(ascdata.data(), ascdata.size(), (unsigned char *)&retval[0]));
+   return retval;
+}
+
+// Decode len characters of base64 to out, returns the number of bytes written
+std::size_t base64Decode(const char * in, std::size_t len, unsigned char * out)
+{
+   const std::size_t capacity = base64DecodedMaxSize(len);
+   std::size_t i = 0, outpos = 0;
    int bits_collected = 0;
    unsigned int accumulator = 0;
 
-   for (string::const_iterator i = ascdata.begin(); i != last; ++i) {
-      const int c = *i;
-      if (std::isspace(c) || c == '=') {
+   while (i < len) {
+      // Whole blocks of alphabet characters go through the kernels, which
+      // may store a few bytes past what they decode so keep them clear of the end
+      if (bits_collected == 0) {
+         std::size_t written, room = capacity - outpos;
+         std::size_t limit = room > base64Kernels.slack ? (room - base64Kernels.slack) / 3 * 4 : 0;
+         std::size_t used = base64Kernels.decode(in + i, std::min(len - i, limit), out + outpos, &written);
+         i += used;
+         outpos += written;
+         used = base64DecodeScalar(in + i, len - i, out + outpos, &written);
+         i += used;
+         outpos += written;
+         if (i == len) break;
+      }
+      
+      // One character at a time around whitespace, padding and the tail
+      const int c = (unsigned char)in[i++];
+      if (c == ' ' || (c >= '\t' && c <= '\r') || c == '=') {
          // Skip whitespace and padding. Be liberal in what you accept.
          continue;
       }
-      if ((c > 127) || (c < 0) || (reverse_table[c] > 63)) {
+      if ((c > 127) || (reverse_table[c] > 63)) {
          throw std::invalid_argument("This contains characters not legal in a base64 encoded string.");
       }
       accumulator = (accumulator << 6) | reverse_table[c];
       bits_collected += 6;
       if (bits_collected >= 8) {
          bits_collected -= 8;
-         retval += (char)((accumulator >> bits_collected) & 0xffu);
+         out[outpos++] = (unsigned char)((accumulator >> bits_collected) & 0xffu);
       }
    }
-   return retval;
+   return outpos;
 }
 
 // Compute sha1 hash of string
 std::string sha1(const std::string & str){
     // Buffer to store hash result
-    unsigned char obuf[20];
+    unsigned char obuf[SHA_DIGEST_LENGTH];
 
     // Compute sha1 hash of input string
-    SHA1((unsigned char *)str.c_str(), str.size(), obuf);
+    sha1(str.data(), str.size(), obuf);
     
     // Convert results to string
-    return std::string((char *)obuf, 20);
+    return std::string((char *)obuf, SHA_DIGEST_LENGTH);
+}
+
+// Write the 20 byte sha1 hash of data to out
+void sha1(const void * data, std::size_t len, unsigned char * out){
+    SHA1((const unsigned char *)data, len, out);
 }
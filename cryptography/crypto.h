@@ -7,59 +7,311 @@
  * Encryption classes wrapping openssl functionality.
 */
 
+#ifndef __CRYPTO_H
+#define __CRYPTO_H
+
 #include <openssl/sha.h>
 #include <openssl/bio.h>
 #include <openssl/evp.h>
 #include <openssl/ec.h>
 #include <openssl/ecdh.h>
+#include <openssl/kdf.h>
 #include <iostream>
 #include <string>
 #include <cassert>
 #include <limits>
 #include <stdexcept>
 #include <cctype>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include <ios>
 
-// Class that wraps openssl and performs ECDH exchange
-class ECDH {
+// One side of a Diffie-Hellman style key exchange
+class KeyExchange {
 public:
-    // Initialize context and generate key pair
-    ECDH();
+    static const std::size_t maxPublicKeySize = 64;
+    static const std::size_t secretSize = 32;
+    
+    KeyExchange();
+    
+    // Length in bytes of the public key
+    virtual std::size_t publicKeyLength() const = 0;
     
     // Returns the public key for sharing with peer
     std::string getPublicKey() const;
     
+    // Write the public key to out, returns false on failure
+    virtual bool getPublicKey(unsigned char * out) const = 0;
+    
     // Recieve public key from peer
     void recieveKey(const std::string & otherKey);
     
+    // Recieve public key from peer
+    virtual void recieveKey(const unsigned char * otherKey, std::size_t len) = 0;
+    
     // Retrieve shared secret
     std::string getSecret() const;
     
+    // Copy shared secret to out, returns its length or 0 if there is none
+    std::size_t getSecret(unsigned char * out, std::size_t len) const;
+    
     // Handle errors reported by openssl API
     void handleErrors();
     
-    // Free up memory
-    ~ECDH();
+    // Wipe the secret
+    virtual ~KeyExchange();
     
 protected:
-    BN_CTX *bn_ctx = NULL;
-    EC_GROUP * group = NULL;
-    EC_KEY *key = NULL;
-    int field_size;
-	unsigned char *secret = NULL;
-	size_t secret_len;
+	unsigned char secret[secretSize];
+	size_t secret_len = 0;
 	
 	bool _done;
 	bool _dead;
+	
+private:
+    KeyExchange(const KeyExchange &) = delete;
+    KeyExchange & operator=(const KeyExchange &) = delete;
+};
+
+
+// Class that wraps openssl and performs ECDH exchange on secp256k1
+class ECDH : public KeyExchange {
+public:
+    static const std::size_t publicKeySize = 64;    // Raw x and y coordinates
+    
+    // Initialize context and generate key pair
+    ECDH();
+    
+    using KeyExchange::getPublicKey;
+    using KeyExchange::recieveKey;
+    
+    // Length in bytes of the public key
+    virtual std::size_t publicKeyLength() const;
+    
+    // Write the 64 byte public key to out, returns false on failure
+    virtual bool getPublicKey(unsigned char * out) const;
+    
+    // Recieve 64 byte public key from peer
+    virtual void recieveKey(const unsigned char * otherKey, std::size_t len);
+    
+    // Free up memory
+    ~ECDH();
+    
+    // Shared read-only secp256k1 group with generator precomputation, built once
+    static const EC_GROUP * curve();
+    
+protected:
+    // Bignum context cached per thread
+    static BN_CTX * threadContext();
+    
+    // Scratch point cached per thread for decoding peer keys
+    static EC_POINT * scratchPoint();
+    
+    EC_KEY *key = NULL;
+};
+
+
+// X25519 key exchange through the EVP_PKEY API
+class X25519 : public KeyExchange {
+public:
+    static const std::size_t publicKeySize = 32;
+    
+    // Generate key pair
+    X25519();
+    
+    using KeyExchange::getPublicKey;
+    using KeyExchange::recieveKey;
+    
+    // Length in bytes of the public key
+    virtual std::size_t publicKeyLength() const;
+    
+    // Write the 32 byte public key to out, returns false on failure
+    virtual bool getPublicKey(unsigned char * out) const;
+    
+    // Recieve 32 byte public key from peer
+    virtual void recieveKey(const unsigned char * otherKey, std::size_t len);
+    
+    // Free key
+    ~X25519();
+    
+protected:
+    EVP_PKEY * _key = NULL;
+};
+
+
+// Pool of pregenerated ECDH key pairs, refilled by background threads
+class ECDHKeyPool {
+public:
+    // Start threads that keep up to depth key pairs ready
+    ECDHKeyPool(std::size_t depth = 64, unsigned int threads = 1);
+    
+    // Take a ready key pair, generates one inline (and counts a stall) if the pool is empty
+    std::unique_ptr<ECDH> acquire();
+    
+    // Number of key pairs ready to hand out
+    std::size_t available();
+    
+    // Target number of ready key pairs
+    std::size_t depth() const;
+    
+    // Number of acquires that found the pool empty
+    unsigned long long stalls() const;
+    
+    // Stop and join the refill threads
+    ~ECDHKeyPool();
+    
+protected:
+    // Refill thread body
+    void fill();
+    
+    std::size_t _depth;     // Target pool size
+    std::vector<std::unique_ptr<ECDH>> _keys;   // Ready key pairs
+    std::vector<std::thread> _threads;  // Refill threads
+    std::mutex _mutex;      // Guards _keys and _stop
+    std::condition_variable _refill;    // Signalled when keys are taken
+    bool _stop;
+    std::atomic<unsigned long long> _stalls;    // Acquires that hit an empty pool
+    
+private:
+    ECDHKeyPool(const ECDHKeyPool &) = delete;
+    ECDHKeyPool & operator=(const ECDHKeyPool &) = delete;
+};
+
+
+// AES-256-GCM with a fixed key and preallocated cipher contexts
+class AESGCM {
+public:
+    static const std::size_t keySize = 32;
+    static const std::size_t ivSize = 12;
+    static const std::size_t tagSize = 16;
+    
+    // Set up encrypt and decrypt contexts for the given 32 byte key
+    AESGCM(const std::string & key);
+    
+    // Encrypt len bytes of data in place and write the 16 byte tag
+    bool encrypt(unsigned char * data, std::size_t len, const unsigned char * iv, unsigned char * tag);
+    
+    // Decrypt len bytes of data in place, returns false if the tag does not match
+    bool decrypt(unsigned char * data, std::size_t len, const unsigned char * iv, const unsigned char * tag);
+    
+    // Free contexts
+    ~AESGCM();
+    
+protected:
+    // Contexts are keyed once, only the iv changes per message
+    EVP_CIPHER_CTX * _encrypt = NULL;
+    EVP_CIPHER_CTX * _decrypt = NULL;
+    
+private:
+    AESGCM(const AESGCM &) = delete;
+    AESGCM & operator=(const AESGCM &) = delete;
+};
+
+
+// Incremental SHA-1 or SHA-256 hash with a reusable context
+class Hasher {
+public:
+    enum Algorithm { Sha1, Sha256 };
+    
+    static const std::size_t maxSize = 32;  // Largest digest size
+    
+    // Set up a context for the given algorithm
+    Hasher(Algorithm algorithm = Sha256);
+    
+    // Add data to the running hash
+    void update(const void * data, std::size_t len);
+    void update(const std::string & str);
+    
+    // Write the digest to out and start over, returns the digest size
+    std::size_t final(unsigned char * out);
+    
+    // Returns the digest and starts over
+    std::string final();
+    
+    // Drop any data added since the last final
+    void reset();
+    
+    // Digest size in bytes
+    std::size_t size() const;
+    
+    // Hash count independent buffers, writing count * size() bytes to out
+    // Uses the cpu's SHA instructions directly when it has them
+    void hashBatch(const unsigned char * const * data, const std::size_t * lens, std::size_t count, unsigned char * out);
+    
+    // Hash count buffers of len bytes laid out back to back
+    void hashBatch(const unsigned char * data, std::size_t len, std::size_t count, unsigned char * out);
+    
+    // Free context
+    ~Hasher();
+    
+protected:
+    // Digest implementation for an algorithm
+    static const EVP_MD * digest(Algorithm algorithm);
+    
+    Algorithm _algorithm;
+    const EVP_MD * _md;
+    EVP_MD_CTX * _ctx = NULL;
+    
+private:
+    Hasher(const Hasher &) = delete;
+    Hasher & operator=(const Hasher &) = delete;
 };
 
 
+// Derive length bytes of key material from a shared secret with HKDF-SHA256
+std::string hkdf(const std::string & secret, const std::string & salt, const std::string & info, std::size_t length);
+
+// Encode binary data as lowercase hex
+std::string hexEncode(const std::string & str);
+
+// Write 2*len hex digits for data to out
+void hexEncode(const unsigned char * data, std::size_t len, char * out);
+
+// Decode hex string to binary data, throws std::invalid_argument on bad input
+std::string hexDecode(const std::string & str);
+
+// Decode len hex digits to len/2 bytes at out, throws std::invalid_argument on bad input
+void hexDecode(const char * str, std::size_t len, unsigned char * out);
+
+// Name of the hex kernel used on this cpu ("avx2", "ssse3" or "scalar")
+const char * hexKernel();
+
+// Exact base64 length for len bytes of data, including padding
+constexpr std::size_t base64EncodedSize(std::size_t len){
+    return (len + 2) / 3 * 4;
+}
+
+// Most bytes that len characters of base64 can decode to
+constexpr std::size_t base64DecodedMaxSize(std::size_t len){
+    return len / 4 * 3 + (len % 4 == 3 ? 2 : len % 4 == 2 ? 1 : 0);
+}
+
 // Encode data in base 64
 std::string base64Encode(const std::string & str);
 
-// Decode base64 string to binary data
+// Write base64EncodedSize(len) characters for data to out
+void base64Encode(const unsigned char * data, std::size_t len, char * out);
+
+// Decode base64 string to binary data, skipping whitespace and padding
 std::string base64Decode(const std::string & str);
 
+// Decode len characters of base64 to out, which must hold base64DecodedMaxSize(len) bytes
+// Returns the number of bytes written
+std::size_t base64Decode(const char * str, std::size_t len, unsigned char * out);
+
+// Name of the base64 kernel used on this cpu ("avx2", "ssse3" or "scalar")
+const char * base64Kernel();
+
 // Compute sha1 hash of string
-std::string sha1(const std::string & str);
\ No newline at end of file
+std::string sha1(const std::string & str);
+
+// Write the 20 byte sha1 hash of data to out
+void sha1(const void * data, std::size_t len, unsigned char * out);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * hex_message.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Native codec for the "len,iv,ciphertext" hex message format sent by
+ * network_section.js, AES-256-CBC with every field hex encoded.
+*/
+
+#include "hex_message.h"
+
+/*
+ * struct HexMessage
+ * Fields of one "len,iv,ciphertext" message
+ */
+
+// Split a frame without copying
+bool HexMessage::parse(const char * frame, std::size_t len, HexMessage & message){
+    // Length is at most 16 hex digits, any case
+    std::size_t i = 0, length = 0;
+    for(; i < len && i < 16 && frame[i] != ','; i++){
+        char c = frame[i];
+        int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                    (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if(digit < 0) return false;
+        length = (length << 4) | digit;
+    }
+    
+    // Sixteen digits must be followed by the comma, checked below
+    if(i == 0 || len < i + 1 + HexMessageCodec::ivDigits + 1 ||
+       frame[i] != ',' || frame[i + 1 + HexMessageCodec::ivDigits] != ','){
+        return false;
+    }
+    message.length = length;
+    message.iv = frame + i + 1;
+    message.ciphertext = message.iv + HexMessageCodec::ivDigits + 1;
+    message.ciphertextSize = len - (message.ciphertext - frame);
+    return true;
+}
+
+/*
+ * class HexMessageCodec
+ * AES-256-CBC codec for hex messages
+ */
+
+// Set up encrypt and decrypt contexts
+HexMessageCodec::HexMessageCodec(const std::string & key){
+    if(key.size() != keySize){
+        throw std::invalid_argument("AES-256-CBC needs a 32 byte key.");
+    }
+    const unsigned char * k = (const unsigned char *)key.data();
+    _encrypt = EVP_CIPHER_CTX_new();
+    _decrypt = EVP_CIPHER_CTX_new();
+    if(_encrypt == NULL || _decrypt == NULL ||
+       1 != EVP_EncryptInit_ex(_encrypt, EVP_aes_256_cbc(), NULL, k, NULL) ||
+       1 != EVP_DecryptInit_ex(_decrypt, EVP_aes_256_cbc(), NULL, k, NULL) ||
+       1 != EVP_CIPHER_CTX_set_padding(_decrypt, 0)){
+        EVP_CIPHER_CTX_free(_encrypt);
+        EVP_CIPHER_CTX_free(_decrypt);
+        throw std::runtime_error("Could not set up AES-256-CBC context.");
+    }
+}
+
+// Decrypt a frame into plaintext
+bool HexMessageCodec::decrypt(const char * frame, std::size_t len, std::string & plaintext){
+    HexMessage message;
+    if(!HexMessage::parse(frame, len, message) || message.ciphertextSize == 0 ||
+       message.ciphertextSize % ivDigits != 0){
+        return false;
+    }
+
+    // The sent length trims the padding, so it must land in the last block
+    std::size_t size = message.ciphertextSize / 2;
+    if(message.length > size || message.length + blockSize < size){
+        return false;
+    }
+
+    // Hex decode straight into the output and decrypt it in place
+    unsigned char iv[blockSize];
+    plaintext.resize(size);
+    unsigned char * data = (unsigned char *)&plaintext[0];
+    try{
+        hexDecode(message.iv, ivDigits, iv);
+        hexDecode(message.ciphertext, message.ciphertextSize, data);
+    }
+    catch(std::invalid_argument & e){
+        return false;
+    }
+    int outlen;
+    if(1 != EVP_DecryptInit_ex(_decrypt, NULL, NULL, NULL, iv) ||
+       1 != EVP_DecryptUpdate(_decrypt, data, &outlen, data, size)){
+        return false;
+    }
+    plaintext.resize(message.length);
+    return true;
+}
+
+// Decrypt a frame into plaintext
+bool HexMessageCodec::decrypt(const std::string & frame, std::string & plaintext){
+    return decrypt(frame.data(), frame.size(), plaintext);
+}
+
+// Encrypt len bytes under a fresh random iv and write the frame
+bool HexMessageCodec::encrypt(const char * data, std::size_t len, std::string & frame){
+    unsigned char iv[blockSize];
+    if(1 != RAND_bytes(iv, blockSize)){
+        return false;
+    }
+
+    // PKCS#7 padding always adds between 1 and 16 bytes
+    std::size_t size = (len / blockSize + 1) * blockSize;
+    _buffer.resize(size);
+    int outlen, finallen;
+    if(1 != EVP_EncryptInit_ex(_encrypt, NULL, NULL, NULL, iv) ||
+       1 != EVP_EncryptUpdate(_encrypt, _buffer.data(), &outlen, (const unsigned char *)data, len) ||
+       1 != EVP_EncryptFinal_ex(_encrypt, _buffer.data() + outlen, &finallen) ||
+       (std::size_t)(outlen + finallen) != size){
+        return false;
+    }
+
+    // Length in hex without leading zeros, as javascript's toString(16) writes it
+    char length[16];
+    std::size_t digits = 0, rest = len;
+    do{
+        length[15 - digits] = "0123456789abcdef"[rest & 0xf];
+        digits++;
+        rest >>= 4;
+    } while(rest != 0);
+
+    frame.resize(digits + 1 + ivDigits + 1 + 2*size);
+    char * out = &frame[0];
+    std::copy(length + 16 - digits, length + 16, out);
+    out += digits;
+    *out++ = ',';
+    hexEncode(iv, blockSize, out);
+    out += ivDigits;
+    *out++ = ',';
+    hexEncode(_buffer.data(), size, out);
+    return true;
+}
+
+// Encrypt plaintext under a fresh random iv
+std::string HexMessageCodec::encrypt(const std::string & plaintext){
+    std::string frame;
+    if(!encrypt(plaintext.data(), plaintext.size(), frame)){
+        throw std::runtime_error("AES-256-CBC encryption failed.");
+    }
+    return frame;
+}
+
+// Free contexts
+HexMessageCodec::~HexMessageCodec(){
+    EVP_CIPHER_CTX_free(_encrypt);
+    EVP_CIPHER_CTX_free(_decrypt);
+}
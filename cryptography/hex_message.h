@@ -0,0 +1,68 @@
+/*
+ * hex_message.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Native codec for the "len,iv,ciphertext" hex message format sent by
+ * network_section.js, AES-256-CBC with every field hex encoded.
+*/
+
+#ifndef __HEX_MESSAGE_H
+#define __HEX_MESSAGE_H
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <string>
+#include <vector>
+#include "crypto.h"
+
+// Fields of one "len,iv,ciphertext" message, pointing into the frame it was parsed from
+struct HexMessage {
+    std::size_t length = 0;             // Plaintext length in bytes
+    const char * iv = NULL;             // 32 hex digits
+    const char * ciphertext = NULL;     // Hex ciphertext
+    std::size_t ciphertextSize = 0;     // Hex digits of ciphertext
+
+    // Split a frame without copying, returns false if it is malformed
+    static bool parse(const char * frame, std::size_t len, HexMessage & message);
+};
+
+// AES-256-CBC codec for hex messages, keyed once and reused for every frame
+class HexMessageCodec {
+public:
+    static const std::size_t keySize = 32;
+    static const std::size_t blockSize = 16;
+    static const std::size_t ivDigits = 2*blockSize;
+
+    // Set up encrypt and decrypt contexts for the given 32 byte key
+    HexMessageCodec(const std::string & key);
+
+    // Decrypt a frame into plaintext, returns false if it is malformed or does not decrypt
+    bool decrypt(const char * frame, std::size_t len, std::string & plaintext);
+
+    // Decrypt a frame into plaintext, returns false if it is malformed or does not decrypt
+    bool decrypt(const std::string & frame, std::string & plaintext);
+
+    // Encrypt len bytes under a fresh random iv and write the frame, returns false on failure
+    bool encrypt(const char * data, std::size_t len, std::string & frame);
+
+    // Encrypt plaintext under a fresh random iv, returns the frame
+    std::string encrypt(const std::string & plaintext);
+
+    // Free contexts
+    ~HexMessageCodec();
+
+protected:
+    // Contexts are keyed once, only the iv changes per message
+    EVP_CIPHER_CTX * _encrypt = NULL;
+    EVP_CIPHER_CTX * _decrypt = NULL;
+
+    std::vector<unsigned char> _buffer;     // Ciphertext scratch reused by encrypt
+
+private:
+    HexMessageCodec(const HexMessageCodec &) = delete;
+    HexMessageCodec & operator=(const HexMessageCodec &) = delete;
+};
+
+#endif
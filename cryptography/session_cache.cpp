@@ -0,0 +1,133 @@
+/*
+ * session_cache.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Server side cache of resumption secrets indexed by opaque tickets, so a
+ * returning client can derive fresh session keys without a new ECDH exchange.
+*/
+
+#include "session_cache.h"
+#include <stdexcept>
+
+/*
+ * class SessionCache
+ * Sharded map from single use tickets to resumption secrets, bounded by count and age
+ */
+
+// Keep at most maxSessions secrets for ttl milliseconds, split over shards locks
+SessionCache::SessionCache(std::size_t maxSessions, int ttl, unsigned int shards):
+  _shardLimit(shards ? (maxSessions + shards - 1) / shards : 0), _ttl(ttl){
+    if(shards == 0){
+        throw std::invalid_argument("Session cache needs at least one shard.");
+    }
+    for(unsigned int i=0; i<shards; i++){
+        _shards.emplace_back(new Shard());
+    }
+}
+
+// Store a resumption secret, returns the random ticket for it
+std::string SessionCache::issue(const std::string & secret){
+    std::string ticket(ticketSize, '\0');
+    if(1 != RAND_bytes((unsigned char *)&ticket[0], ticketSize)){
+        throw std::runtime_error("Could not generate session ticket.");
+    }
+    
+    Clock::time_point now = Clock::now();
+    Shard & shard = shardFor(ticket);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    // A repeated ticket replaces the old session rather than sharing its queue entry
+    auto old = shard.sessions.find(ticket);
+    if(old != shard.sessions.end()){
+        erase(shard, old);
+    }
+    
+    Session & session = shard.sessions[ticket];
+    session.secret = secret;
+    session.expires = now + _ttl;
+    session.position = shard.order.insert(shard.order.end(), ticket);
+    prune(shard, now);
+    return ticket;
+}
+
+// Take the secret for a ticket, which is then forgotten
+bool SessionCache::redeem(const std::string & ticket, std::string & secret){
+    if(ticket.size() != ticketSize){
+        return false;
+    }
+    
+    Clock::time_point now = Clock::now();
+    Shard & shard = shardFor(ticket);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    
+    auto it = shard.sessions.find(ticket);
+    if(it == shard.sessions.end()){
+        return false;
+    }
+    bool live = it -> second.expires > now;
+    if(live){
+        secret = it -> second.secret;
+    }
+    erase(shard, it);
+    return live;
+}
+
+// Number of live tickets
+std::size_t SessionCache::size(){
+    std::size_t total = 0;
+    Clock::time_point now = Clock::now();
+    for(auto & shard : _shards){
+        std::lock_guard<std::mutex> lock(shard -> mutex);
+        prune(*shard, now);
+        total += shard -> sessions.size();
+    }
+    return total;
+}
+
+// Forget every ticket
+void SessionCache::clear(){
+    for(auto & shard : _shards){
+        std::lock_guard<std::mutex> lock(shard -> mutex);
+        while(!shard -> sessions.empty()){
+            erase(*shard, shard -> sessions.begin());
+        }
+    }
+}
+
+// Wipe stored secrets
+SessionCache::~SessionCache(){
+    clear();
+}
+
+// Shard holding a ticket, tickets are random so any bytes spread evenly
+SessionCache::Shard & SessionCache::shardFor(const std::string & ticket){
+    unsigned int hash = 0;
+    for(std::size_t i=0; i<4 && i<ticket.size(); i++){
+        hash = (hash << 8) | (unsigned char)ticket[i];
+    }
+    return *_shards[hash % _shards.size()];
+}
+
+// Drop expired sessions from the front of the queue, then the oldest
+// sessions while the shard is over its limit
+// Every session has the same lifetime, so queue order is expiry order
+void SessionCache::prune(Shard & shard, Clock::time_point now){
+    while(!shard.order.empty()){
+        auto it = shard.sessions.find(shard.order.front());
+        if(it -> second.expires > now && shard.sessions.size() <= _shardLimit){
+            break;
+        }
+        erase(shard, it);
+    }
+}
+
+// Wipe and erase one session and its queue entry
+void SessionCache::erase(Shard & shard, std::unordered_map<std::string, Session>::iterator it){
+    shard.order.erase(it -> second.position);
+    if(!it -> second.secret.empty()){
+        OPENSSL_cleanse(&it -> second.secret[0], it -> second.secret.size());
+    }
+    shard.sessions.erase(it);
+}
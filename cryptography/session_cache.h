@@ -0,0 +1,81 @@
+/*
+ * session_cache.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Server side cache of resumption secrets indexed by opaque tickets, so a
+ * returning client can derive fresh session keys without a new ECDH exchange.
+*/
+
+#ifndef __SESSION_CACHE_H
+#define __SESSION_CACHE_H
+
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+// Sharded map from single use tickets to resumption secrets, bounded by count and age
+class SessionCache {
+public:
+    static const std::size_t ticketSize = 16;
+    
+    // Keep at most maxSessions secrets for ttl milliseconds, split over shards locks
+    SessionCache(std::size_t maxSessions = 65536, int ttl = 3600000, unsigned int shards = 16);
+    
+    // Store a resumption secret, returns the random ticket for it
+    std::string issue(const std::string & secret);
+    
+    // Take the secret for a ticket, which is then forgotten
+    // Returns false if the ticket is unknown or expired
+    bool redeem(const std::string & ticket, std::string & secret);
+    
+    // Number of live tickets
+    std::size_t size();
+    
+    // Forget every ticket
+    void clear();
+    
+    // Wipe stored secrets
+    ~SessionCache();
+    
+protected:
+    typedef std::chrono::steady_clock Clock;
+    
+    // Stored secret, when it stops being valid and its place in the queue
+    struct Session {
+        std::string secret;
+        Clock::time_point expires;
+        std::list<std::string>::iterator position;
+    };
+    
+    // One lock's worth of sessions, oldest first in the queue
+    // The queue holds exactly the live tickets, erase removes both
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Session> sessions;
+        std::list<std::string> order;
+    };
+    
+    // Shard holding a ticket
+    Shard & shardFor(const std::string & ticket);
+    
+    // Drop expired sessions from the front of the queue, then the oldest
+    // sessions while the shard is over its limit
+    void prune(Shard & shard, Clock::time_point now);
+    
+    // Wipe and erase one session and its queue entry
+    static void erase(Shard & shard, std::unordered_map<std::string, Session>::iterator it);
+    
+    std::size_t _shardLimit;    // Max sessions per shard
+    std::chrono::milliseconds _ttl;     // Session lifetime
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+#endif
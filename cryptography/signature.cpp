@@ -0,0 +1,186 @@
+/*
+ * signature.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Ed25519 signing and a batch verifier that checks signatures queued from
+ * many connections on a few worker threads.
+*/
+
+#include "signature.h"
+#include <stdexcept>
+#include <algorithm>
+
+/*
+ * class SignatureKey
+ * Peer's Ed25519 public key, shared by every message it signs
+ */
+
+// Load a raw 32 byte public key
+SignatureKey::SignatureKey(const unsigned char * key, std::size_t len){
+    if(len != keySize || NULL == (_key = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, NULL, key, len))){
+        throw std::invalid_argument("Not an Ed25519 public key.");
+    }
+}
+
+// Check signature over len bytes of data, ctx is reset and reused
+bool SignatureKey::verify(EVP_MD_CTX * ctx, const unsigned char * data, std::size_t len, const unsigned char * signature) const{
+    bool ok = 1 == EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, _key) &&
+        1 == EVP_DigestVerify(ctx, signature, Ed25519Signer::signatureSize, data, len);
+    EVP_MD_CTX_reset(ctx);
+    return ok;
+}
+
+// Free key
+SignatureKey::~SignatureKey(){
+    EVP_PKEY_free(_key);
+}
+
+
+/*
+ * class Ed25519Signer
+ * Ed25519 key pair for signing messages
+ */
+
+// Generate a new key pair
+Ed25519Signer::Ed25519Signer(){
+    EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, NULL);
+    bool ok = ctx != NULL && 1 == EVP_PKEY_keygen_init(ctx) && 1 == EVP_PKEY_keygen(ctx, &_key);
+    EVP_PKEY_CTX_free(ctx);
+    if(!ok || NULL == (_ctx = EVP_MD_CTX_new())){
+        EVP_PKEY_free(_key);
+        throw std::runtime_error("Could not generate Ed25519 key.");
+    }
+}
+
+// Load a key pair from a 32 byte private key
+Ed25519Signer::Ed25519Signer(const std::string & privateKey){
+    _key = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL, (const unsigned char *)privateKey.data(), privateKey.size());
+    if(_key == NULL){
+        throw std::invalid_argument("Not an Ed25519 private key.");
+    }
+    if(NULL == (_ctx = EVP_MD_CTX_new())){
+        EVP_PKEY_free(_key);
+        throw std::runtime_error("Could not set up signing context.");
+    }
+}
+
+// Raw 32 byte public key
+std::string Ed25519Signer::getPublicKey() const{
+    std::string key(SignatureKey::keySize, '\0');
+    std::size_t len = key.size();
+    if(1 != EVP_PKEY_get_raw_public_key(_key, (unsigned char *)&key[0], &len)){
+        return std::string("");
+    }
+    return key;
+}
+
+// Write the 64 byte signature over len bytes of data to signature
+bool Ed25519Signer::sign(const unsigned char * data, std::size_t len, unsigned char * signature){
+    std::size_t sigLen = signatureSize;
+    bool ok = 1 == EVP_DigestSignInit(_ctx, NULL, NULL, NULL, _key) &&
+        1 == EVP_DigestSign(_ctx, signature, &sigLen, data, len);
+    EVP_MD_CTX_reset(_ctx);
+    return ok && sigLen == signatureSize;
+}
+
+// Returns the signature over message
+std::string Ed25519Signer::sign(const std::string & message){
+    std::string signature(signatureSize, '\0');
+    if(!sign((const unsigned char *)message.data(), message.size(), (unsigned char *)&signature[0])){
+        throw std::runtime_error("Ed25519 signing failed.");
+    }
+    return signature;
+}
+
+// Free key and context
+Ed25519Signer::~Ed25519Signer(){
+    EVP_MD_CTX_free(_ctx);
+    EVP_PKEY_free(_key);
+}
+
+
+/*
+ * class BatchVerifier
+ * Queue of pending signature checks, drained in batches by worker threads
+ */
+
+// Start threads that each take up to maxBatch checks at a time
+BatchVerifier::BatchVerifier(unsigned int threads, std::size_t maxBatch):
+  _maxBatch(std::max<std::size_t>(1, maxBatch)), _stop(false), _verified(0), _forged(0){
+    for(unsigned int i=0; i<std::max(1u, threads); i++){
+        _threads.emplace_back(&BatchVerifier::work, this);
+    }
+}
+
+// Queue a check of signature over message
+void BatchVerifier::submit(const std::shared_ptr<SignatureKey> & key, std::string message, const unsigned char * signature, Callback done){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.emplace_back();
+        Job & job = _jobs.back();
+        job.key = key;
+        job.message = std::move(message);
+        std::copy(signature, signature + Ed25519Signer::signatureSize, job.signature);
+        job.done = std::move(done);
+    }
+    _ready.notify_one();
+}
+
+// Number of checks waiting for a worker
+std::size_t BatchVerifier::pending(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _jobs.size();
+}
+
+// Checks completed
+unsigned long long BatchVerifier::verified() const{
+    return _verified;
+}
+
+// Checks that failed
+unsigned long long BatchVerifier::forged() const{
+    return _forged;
+}
+
+// Finish queued checks, then stop and join the workers
+BatchVerifier::~BatchVerifier(){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _ready.notify_all();
+    for(auto & thread : _threads){
+        thread.join();
+    }
+}
+
+// Worker thread body, takes a batch under one lock and checks it with a reused context
+void BatchVerifier::work(){
+    EVP_MD_CTX * ctx = EVP_MD_CTX_new();
+    std::vector<Job> batch;
+    batch.reserve(_maxBatch);
+    
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ready.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+            if(_jobs.empty()) break;
+            
+            std::size_t count = std::min(_maxBatch, _jobs.size());
+            std::move(_jobs.begin(), _jobs.begin() + count, std::back_inserter(batch));
+            _jobs.erase(_jobs.begin(), _jobs.begin() + count);
+        }
+        
+        for(Job & job : batch){
+            bool ok = ctx != NULL && job.key -> verify(ctx, (const unsigned char *)job.message.data(), job.message.size(), job.signature);
+            _verified++;
+            if(!ok) _forged++;
+            job.done(ok, job.message);
+        }
+        batch.clear();
+    }
+    
+    EVP_MD_CTX_free(ctx);
+}
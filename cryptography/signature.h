@@ -0,0 +1,122 @@
+/*
+ * signature.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Ed25519 signing and a batch verifier that checks signatures queued from
+ * many connections on a few worker threads.
+*/
+
+#ifndef __SIGNATURE_H
+#define __SIGNATURE_H
+
+#include <openssl/evp.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+// Peer's Ed25519 public key, shared by every message it signs
+class SignatureKey {
+public:
+    static const std::size_t keySize = 32;
+    
+    // Load a raw 32 byte public key, throws std::invalid_argument if it is not one
+    SignatureKey(const unsigned char * key, std::size_t len);
+    
+    // Check signature over len bytes of data, ctx is reset and reused
+    bool verify(EVP_MD_CTX * ctx, const unsigned char * data, std::size_t len, const unsigned char * signature) const;
+    
+    // Free key
+    ~SignatureKey();
+    
+protected:
+    EVP_PKEY * _key = NULL;
+    
+private:
+    SignatureKey(const SignatureKey &) = delete;
+    SignatureKey & operator=(const SignatureKey &) = delete;
+};
+
+// Ed25519 key pair for signing messages
+class Ed25519Signer {
+public:
+    static const std::size_t signatureSize = 64;
+    
+    // Generate a new key pair
+    Ed25519Signer();
+    
+    // Load a key pair from a 32 byte private key
+    Ed25519Signer(const std::string & privateKey);
+    
+    // Raw 32 byte public key
+    std::string getPublicKey() const;
+    
+    // Write the 64 byte signature over len bytes of data to signature
+    bool sign(const unsigned char * data, std::size_t len, unsigned char * signature);
+    
+    // Returns the signature over message
+    std::string sign(const std::string & message);
+    
+    // Free key and context
+    ~Ed25519Signer();
+    
+protected:
+    EVP_PKEY * _key = NULL;
+    EVP_MD_CTX * _ctx = NULL;
+    
+private:
+    Ed25519Signer(const Ed25519Signer &) = delete;
+    Ed25519Signer & operator=(const Ed25519Signer &) = delete;
+};
+
+// Queue of pending signature checks, drained in batches by worker threads
+class BatchVerifier {
+public:
+    // Called with the result and the message handed back
+    typedef std::function<void(bool, std::string &)> Callback;
+    
+    // Start threads that each take up to maxBatch checks at a time
+    BatchVerifier(unsigned int threads = 2, std::size_t maxBatch = 64);
+    
+    // Queue a check of signature over message, done runs on a worker thread
+    void submit(const std::shared_ptr<SignatureKey> & key, std::string message, const unsigned char * signature, Callback done);
+    
+    // Number of checks waiting for a worker
+    std::size_t pending();
+    
+    // Checks completed and how many of them failed
+    unsigned long long verified() const;
+    unsigned long long forged() const;
+    
+    // Finish queued checks, then stop and join the workers
+    ~BatchVerifier();
+    
+protected:
+    // One queued check
+    struct Job {
+        std::shared_ptr<SignatureKey> key;
+        std::string message;
+        unsigned char signature[Ed25519Signer::signatureSize];
+        Callback done;
+    };
+    
+    // Worker thread body
+    void work();
+    
+    std::size_t _maxBatch;  // Most checks a worker takes at once
+    std::deque<Job> _jobs;  // Waiting checks
+    std::vector<std::thread> _threads;  // Workers
+    std::mutex _mutex;      // Guards _jobs and _stop
+    std::condition_variable _ready;     // Signalled when checks are queued
+    bool _stop;
+    std::atomic<unsigned long long> _verified, _forged;
+};
+
+#endif
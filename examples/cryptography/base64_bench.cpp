@@ -0,0 +1,64 @@
+/*
+ * base64_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Measures base64 encode and decode throughput in GB/s of binary data
+ * for a range of payload sizes, and checks every round trip.
+ *
+ * Usage: base64_bench [megabytes per size]
+ */
+ 
+#include "../../cryptography/crypto.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+
+int main(int argc, char ** argv){
+    double megabytes = (argc > 1) ? std::atof(argv[1]) : 256;
+    std::mt19937 rng(42);
+    
+    cout << "kernel: " << base64Kernel() << "\n";
+    cout << "bytes\tencode GB/s\tdecode GB/s\n";
+    
+    std::size_t sizes[] = { 16, 64, 256, 1024, 16384, 1 << 20 };
+    for(std::size_t size : sizes){
+        std::string data(size, '\0');
+        for(auto & c : data){
+            c = (char)rng();
+        }
+        
+        std::size_t rounds = (std::size_t)(megabytes * (1 << 20) / size) + 1;
+        std::size_t check = 0;
+        
+        std::string encoded;
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i=0; i<rounds; i++){
+            encoded = base64Encode(data);
+            check += encoded[i % encoded.size()];
+        }
+        std::chrono::duration<double> encodeTime = std::chrono::steady_clock::now() - start;
+        
+        std::string decoded;
+        start = std::chrono::steady_clock::now();
+        for(std::size_t i=0; i<rounds; i++){
+            decoded = base64Decode(encoded);
+            check += decoded[i % decoded.size()];
+        }
+        std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - start;
+        
+        if(decoded != data){
+            cout << "round trip failed at " << size << " bytes\n";
+            return 1;
+        }
+        
+        double gigabytes = (double)size * rounds / 1e9;
+        cout << size << "\t" << gigabytes / encodeTime.count() << "\t\t" << gigabytes / decodeTime.count()
+             << "\t\t(" << (check & 1) << ")\n";
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * ecdh_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Times full key exchanges (two key pairs, two shared secrets) and
+ * reports exchanges per second per thread.
+ *
+ * Usage: ecdh_bench [exchanges per thread] [threads] [secp256k1|x25519]
+ */
+ 
+#include "../../cryptography/crypto.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+using std::cout;
+
+int main(int argc, char ** argv){
+    int exchanges = (argc > 1) ? std::atoi(argv[1]) : 2000;
+    int threads = (argc > 2) ? std::atoi(argv[2]) : 1;
+    bool x25519 = (argc > 3) && std::strcmp(argv[3], "x25519") == 0;
+    
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    
+    auto start = std::chrono::steady_clock::now();
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&](){
+            for(int i=0; i<exchanges; i++){
+                std::unique_ptr<KeyExchange> a, b;
+                if(x25519){
+                    a.reset(new X25519());
+                    b.reset(new X25519());
+                }
+                else{
+                    a.reset(new ECDH());
+                    b.reset(new ECDH());
+                }
+                a -> recieveKey(b -> getPublicKey());
+                b -> recieveKey(a -> getPublicKey());
+                if(a -> getSecret().size() != 32 || a -> getSecret() != b -> getSecret()){
+                    failures++;
+                }
+            }
+        });
+    }
+    for(auto & worker : workers){
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    
+    double total = (double)exchanges * threads;
+    cout << (x25519 ? "x25519: " : "secp256k1: ") << total << " exchanges on " << threads << " threads in " << elapsed.count() << "s\n";
+    cout << total / elapsed.count() << " exchanges/s, " << total / elapsed.count() / threads << " per thread\n";
+    if(failures > 0){
+        cout << failures << " exchanges disagreed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * hash_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Measures SHA-1 and SHA-256 throughput from 16 byte to 1MB inputs,
+ * comparing the one shot sha1 function with the reusable Hasher and its
+ * batch API.
+ *
+ * Usage: hash_bench [megabytes per size]
+ */
+ 
+#include "../../cryptography/crypto.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+
+// Time fn over total bytes of input split into count hashes, returns MB/s
+template <typename F>
+double throughput(std::size_t bytes, F fn){
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return bytes / elapsed.count() / 1e6;
+}
+
+int main(int argc, char ** argv){
+    double megabytes = (argc > 1) ? std::atof(argv[1]) : 256;
+    std::mt19937 rng(7);
+    
+    Hasher sha1Hasher(Hasher::Sha1), sha256Hasher(Hasher::Sha256);
+    
+    // Sanity check against the one shot function
+    std::string sample = "The quick brown fox jumps over the lazy dog";
+    sha1Hasher.update(sample.substr(0, 10));
+    sha1Hasher.update(sample.substr(10));
+    if(sha1Hasher.final() != sha1(sample)){
+        cout << "incremental sha1 does not match\n";
+        return 1;
+    }
+    sha256Hasher.update(sample);
+    cout << "sha256: " << hexEncode(sha256Hasher.final()) << "\n";
+    
+    cout << "bytes\tsha1()\t\tsha1 Hasher\tsha1 batch\tsha256 Hasher\tsha256 batch\t(MB/s)\n";
+    
+    for(std::size_t size = 16; size <= (1 << 20); size *= 4){
+        std::size_t count = (std::size_t)(megabytes * (1 << 20) / size) + 1;
+        std::size_t batch = std::min<std::size_t>(count, std::max<std::size_t>(1, (1 << 22) / size));
+        std::size_t rounds = (count + batch - 1) / batch;
+        count = rounds * batch;
+        std::size_t bytes = count * size;
+        
+        std::vector<unsigned char> data(batch * size);
+        for(auto & c : data){
+            c = (unsigned char)rng();
+        }
+        std::vector<unsigned char> digests(batch * Hasher::maxSize);
+        unsigned long long check = 0;
+        
+        // One shot sha1 on strings
+        std::string input((char *)data.data(), size);
+        double oneShot = throughput(bytes, [&](){
+            for(std::size_t i=0; i<count; i++){
+                input[0] = (char)i;
+                check += (unsigned char)sha1(input)[0];
+            }
+        });
+        
+        // Reused context, one update and final per input
+        auto incremental = [&](Hasher & hasher){
+            return throughput(bytes, [&](){
+                for(std::size_t r=0; r<rounds; r++){
+                    for(std::size_t i=0; i<batch; i++){
+                        hasher.update(data.data() + i * size, size);
+                        hasher.final(digests.data());
+                        check += digests[0];
+                    }
+                }
+            });
+        };
+        
+        // Batch API over contiguous buffers
+        auto batched = [&](Hasher & hasher){
+            return throughput(bytes, [&](){
+                for(std::size_t r=0; r<rounds; r++){
+                    hasher.hashBatch(data.data(), size, batch, digests.data());
+                    check += digests[0];
+                }
+            });
+        };
+        
+        double sha1Incremental = incremental(sha1Hasher), sha1Batch = batched(sha1Hasher);
+        double sha256Incremental = incremental(sha256Hasher), sha256Batch = batched(sha256Hasher);
+        
+        cout << size << "\t" << oneShot << "\t\t" << sha1Incremental << "\t\t" << sha1Batch << "\t\t"
+             << sha256Incremental << "\t\t" << sha256Batch << "\t\t(" << (check & 1) << ")\n";
+    }
+    return 0;
+}
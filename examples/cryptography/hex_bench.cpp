@@ -0,0 +1,98 @@
+/*
+ * hex_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Measures hex encode and decode throughput in GB/s of binary data, then
+ * the rate of full "len,iv,ciphertext" message decrypts, checking every
+ * round trip.
+ *
+ * Usage: hex_bench [megabytes per size]
+ */
+ 
+#include "../../cryptography/crypto.h"
+#include "../../cryptography/hex_message.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+
+int main(int argc, char ** argv){
+    double megabytes = (argc > 1) ? std::atof(argv[1]) : 256;
+    std::mt19937 rng(42);
+    
+    cout << "kernel: " << hexKernel() << "\n";
+    cout << "bytes\tencode GB/s\tdecode GB/s\n";
+    
+    std::size_t sizes[] = { 16, 64, 256, 1024, 16384, 1 << 20 };
+    for(std::size_t size : sizes){
+        std::string data(size, '\0');
+        for(auto & c : data){
+            c = (char)rng();
+        }
+        
+        std::size_t rounds = (std::size_t)(megabytes * (1 << 20) / size) + 1;
+        std::size_t check = 0;
+        
+        std::string encoded(2*size, '0');
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i=0; i<rounds; i++){
+            hexEncode((const unsigned char *)data.data(), size, &encoded[0]);
+            check += encoded[i % encoded.size()];
+        }
+        std::chrono::duration<double> encodeTime = std::chrono::steady_clock::now() - start;
+        
+        std::string decoded(size, '\0');
+        start = std::chrono::steady_clock::now();
+        for(std::size_t i=0; i<rounds; i++){
+            hexDecode(encoded.data(), encoded.size(), (unsigned char *)&decoded[0]);
+            check += decoded[i % decoded.size()];
+        }
+        std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - start;
+        
+        if(decoded != data){
+            cout << "round trip failed at " << size << " bytes\n";
+            return 1;
+        }
+        
+        double gigabytes = (double)size * rounds / 1e9;
+        cout << size << "\t" << gigabytes / encodeTime.count() << "\t\t" << gigabytes / decodeTime.count()
+             << "\t\t(" << (check & 1) << ")\n";
+    }
+    
+    std::string key(HexMessageCodec::keySize, '\0');
+    for(auto & c : key){
+        c = (char)rng();
+    }
+    HexMessageCodec codec(key);
+    
+    cout << "\nmessage bytes\tdecrypts/s\tplaintext MB/s\n";
+    std::size_t messages[] = { 32, 256, 4096, 65536 };
+    for(std::size_t size : messages){
+        std::string data(size, '\0');
+        for(auto & c : data){
+            c = (char)rng();
+        }
+        std::string frame = codec.encrypt(data), plaintext;
+        
+        std::size_t rounds = (std::size_t)(megabytes * (1 << 20) / frame.size()) + 1;
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i=0; i<rounds; i++){
+            if(!codec.decrypt(frame, plaintext)){
+                cout << "decrypt failed at " << size << " bytes\n";
+                return 1;
+            }
+        }
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        
+        if(plaintext != data){
+            cout << "message round trip failed at " << size << " bytes\n";
+            return 1;
+        }
+        cout << size << "\t\t" << rounds / time.count() << "\t\t" << (double)size * rounds / 1e6 / time.count() << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * verify_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Compares Ed25519 signature checks done inline with a fresh context per
+ * message against the BatchVerifier worker pool.
+ *
+ * Usage: verify_bench [messages] [verifier threads] [batch size]
+ */
+ 
+#include "../../cryptography/crypto.h"
+#include "../../cryptography/signature.h"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+
+int main(int argc, char ** argv){
+    int messages = (argc > 1) ? std::atoi(argv[1]) : 20000;
+    unsigned int threads = (argc > 2) ? std::atoi(argv[2]) : 2;
+    std::size_t batch = (argc > 3) ? std::atoi(argv[3]) : 64;
+    
+    // A handful of signers, as if from different connections
+    std::vector<std::unique_ptr<Ed25519Signer>> signers;
+    std::vector<std::shared_ptr<SignatureKey>> keys;
+    for(int i=0; i<16; i++){
+        signers.emplace_back(new Ed25519Signer());
+        std::string key = signers.back() -> getPublicKey();
+        keys.push_back(std::make_shared<SignatureKey>((const unsigned char *)key.data(), key.size()));
+    }
+    
+    std::vector<std::string> bodies, signatures;
+    for(int i=0; i<messages; i++){
+        bodies.push_back("message " + std::to_string(i) + " with some payload attached to it");
+        signatures.push_back(signers[i % signers.size()] -> sign(bodies.back()));
+    }
+    
+    // Inline, one context per message
+    int good = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<messages; i++){
+        EVP_MD_CTX * ctx = EVP_MD_CTX_new();
+        good += keys[i % keys.size()] -> verify(ctx, (const unsigned char *)bodies[i].data(), bodies[i].size(),
+                                                 (const unsigned char *)signatures[i].data());
+        EVP_MD_CTX_free(ctx);
+    }
+    std::chrono::duration<double> inlineTime = std::chrono::steady_clock::now() - start;
+    cout << "inline: " << good << " good, " << messages / inlineTime.count() << " checks/s\n";
+    
+    // Queued to the batch verifier
+    std::atomic<int> batchGood(0), done(0);
+    start = std::chrono::steady_clock::now();
+    {
+        BatchVerifier verifier(threads, batch);
+        for(int i=0; i<messages; i++){
+            verifier.submit(keys[i % keys.size()], bodies[i], (const unsigned char *)signatures[i].data(),
+                            [&](bool ok, std::string &){ batchGood += ok; done++; });
+        }
+    }
+    std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - start;
+    cout << "batch: " << batchGood << " good, " << messages / batchTime.count() << " checks/s on "
+         << threads << " threads\n";
+    
+    return (good == messages && batchGood == messages) ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+/*
+ * accept_bench.cpp
+ * Author: Aven Bross
+ * Date: 9/21/2015
+ * 
+ * Opens a storm of connections against a loopback server to time the
+ * listen backlog and batched accept loop.
+ *
+ * Usage: accept_bench [connections] [backlog] [wave]
+ */
+ 
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include "../../../networking/osl/socket.h"
+
+using std::cout;
+
+int main(int argc, char ** argv){
+    int connections = (argc > 1) ? std::atoi(argv[1]) : 50000;
+    int backlog = (argc > 2) ? std::atoi(argv[2]) : -1;
+    int wave = (argc > 3) ? std::atoi(argv[3]) : 1000;
+    
+    // Listening socket with the requested backlog
+    skt_listen_options_t listenOptions;
+    skt_listen_options_init(&listenOptions);
+    listenOptions.backlog = backlog;
+    skt_ip_t ip = { 127, 0, 0, 1 };
+    unsigned int port = 0;
+    SOCKET server = skt_server_opts(&port, &ip, &listenOptions);
+    skt_set_blocking(server, 0);
+    
+    // Server thread drains the accept queue in batches and hangs up
+    std::atomic<int> accepted(0);
+    std::atomic<bool> done(false);
+    std::thread acceptor([&](){
+        SOCKET sockets[64];
+        while(!done){
+            if(skt_select1(server, 100) != 1) continue;
+            int count;
+            do{
+                count = skt_accept_batch(server, sockets, NULL, NULL, 64);
+                for(int i=0; i<count; i++){
+                    skt_close(sockets[i]);
+                }
+                accepted += count;
+            } while(count == 64);
+        }
+    });
+    
+    // Client opens connections in parallel waves
+    std::vector<SOCKET> sockets(wave);
+    int connected = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int opened = 0; opened < connections; opened += wave){
+        int count = std::min(wave, connections - opened);
+        connected += skt_connect_parallel(ip, port, count, sockets.data(), 5000);
+        for(int i=0; i<count; i++){
+            if(sockets[i] != INVALID_SOCKET) skt_close(sockets[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    // Let the acceptor catch up with the last wave
+    while(accepted < connected && std::chrono::steady_clock::now() - start < std::chrono::seconds(60)){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    done = true;
+    acceptor.join();
+    skt_close(server);
+    
+    cout << "backlog: " << ((backlog > 0) ? backlog : SOMAXCONN) << "\twave: " << wave << "\n";
+    cout << "connected: " << connected << "/" << connections << "\taccepted: " << accepted << "\n";
+    cout << "seconds: " << seconds << "\tconnections/sec: " << connected/seconds << "\n";
+    return 0;
+}
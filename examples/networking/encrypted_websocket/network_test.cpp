@@ -6,7 +6,7 @@
  * Testing AES functionality
  */
  
-#include "../../../networking/websocket_server.h"
+#include "../../../networking/encrypted_websocket_server.h"
 #include <iostream>
 #include <cstring>
 #include <cstdio>
@@ -16,7 +16,10 @@ using std::cout;
 using std::cin;
 
 int main(){
-    WebSocketServer s(9999);
+    EncryptedWebSocketServer s(9999);
+    
+    // Serve the javascript client from this directory on the same port
+    s.serveStatic(".");
     s.start();
     
     while(1){
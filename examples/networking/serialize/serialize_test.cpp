@@ -0,0 +1,82 @@
+/*
+ * serialize_test.cpp
+ * Author: Aven Bross
+ * Date: 10/5/2015
+ * 
+ * Testing binary serialization and timing record encoding
+ */
+ 
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "../../../networking/serialize.h"
+
+using std::cout;
+
+// Fixed layout record like we send over the wire
+struct Tick {
+    std::uint64_t time;
+    std::uint32_t id;
+    std::int32_t quantity;
+    double price;
+};
+
+typedef Schema<Tick,
+    SCHEMA_FIELD(Tick, time),
+    SCHEMA_FIELD(Tick, id),
+    SCHEMA_FIELD(Tick, quantity),
+    SCHEMA_FIELD(Tick, price)> TickSchema;
+
+static_assert(TickSchema::size == 24, "Tick should pack into 24 bytes");
+
+int main(){
+    // Fixed byte order types
+    Big64 big = 0x0102030405060708ull;
+    Little32 little = 0x01020304u;
+    cout << "Big64 first byte: " << (int)((byte *)&big)[0] << "\n";
+    cout << "Little32 first byte: " << (int)((byte *)&little)[0] << "\n";
+    
+    // Cursor round trip
+    byte buffer[64];
+    ByteWriter writer(buffer, sizeof(buffer));
+    writer.put((std::uint16_t)0xBEEF).put<Endian::little>(3.5).put((std::int64_t)-2);
+    ByteReader reader(buffer, writer.size());
+    std::uint16_t a = reader.get<std::uint16_t>();
+    double b = reader.get<double, Endian::little>();
+    std::int64_t c = reader.get<std::int64_t>();
+    cout << "round trip: " << std::hex << a << std::dec << " " << b << " " << c << " ok: " << reader.ok() << "\n";
+    
+    // Bulk swap against scalar
+    std::vector<std::uint32_t> words(1001);
+    for(std::size_t i=0; i<words.size(); i++) words[i] = i * 2654435761u;
+    std::vector<std::uint32_t> swapped(words.size());
+    storeArray<Endian::big>(swapped.data(), words.data(), words.size());
+    bool same = true;
+    for(std::size_t i=0; i<words.size(); i++){
+        same = same && loadValue<Endian::big, std::uint32_t>(&swapped[i]) == words[i];
+    }
+    cout << "bulk swap matches: " << same << "\n";
+    
+    // Encode a batch of records straight into a send buffer
+    const std::size_t records = 1000000;
+    std::vector<Tick> ticks(records);
+    for(std::size_t i=0; i<records; i++){
+        ticks[i] = {i * 1000, (std::uint32_t)i, (std::int32_t)(i % 100) - 50, 100.0 + i * 0.01};
+    }
+    std::vector<byte> wire(records * TickSchema::size);
+    auto start = std::chrono::steady_clock::now();
+    TickSchema::encodeArray(ticks.data(), records, wire.data());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::vector<Tick> decoded(records);
+    TickSchema::decodeArray(decoded.data(), records, wire.data());
+    same = true;
+    for(std::size_t i=0; i<records; i++){
+        same = same && decoded[i].time == ticks[i].time && decoded[i].id == ticks[i].id &&
+               decoded[i].quantity == ticks[i].quantity && decoded[i].price == ticks[i].price;
+    }
+    cout << "records match: " << same << "\n";
+    cout << "records/sec: " << records / seconds << "\n";
+    
+    return 0;
+}
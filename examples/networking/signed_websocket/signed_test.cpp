@@ -0,0 +1,137 @@
+/*
+ * signed_test.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Runs a signed websocket server on loopback and drives it with several
+ * clients sending signed messages, then checks that a forged message
+ * closes its connection.
+ *
+ * Usage: signed_test [clients] [messages per client] [verifier threads]
+ */
+ 
+#include "../../../networking/signed_websocket_server.h"
+#include "../../../networking/osl/socket.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+using std::cout;
+
+// Send one masked client frame
+void sendFrame(SOCKET socket, unsigned char opcode, const std::string & payload){
+    std::string frame;
+    frame.push_back((char)(0x80 | opcode));
+    if(payload.size() < 126){
+        frame.push_back((char)(0x80 | payload.size()));
+    }
+    else{
+        frame.push_back((char)(0x80 | 126));
+        frame.push_back((char)(payload.size() >> 8));
+        frame.push_back((char)(payload.size() & 0xff));
+    }
+    frame.append(4, '\0');  // Zero mask leaves the payload as is
+    frame += payload;
+    skt_sendN(socket, frame.data(), frame.size());
+}
+
+// Read one unmasked server frame, empty if the connection closed
+std::string readFrame(SOCKET socket){
+    unsigned char header[2];
+    if(skt_recvN(socket, header, 2) != 0) return std::string("");
+    std::size_t length = header[1] & 0x7f;
+    if(length == 126){
+        unsigned char extended[2];
+        if(skt_recvN(socket, extended, 2) != 0) return std::string("");
+        length = (extended[0] << 8) | extended[1];
+    }
+    std::string payload(length, '\0');
+    if(length > 0 && skt_recvN(socket, &payload[0], length) != 0) return std::string("");
+    return payload;
+}
+
+// Connect and complete the websocket handshake
+SOCKET openSocket(unsigned int port){
+    skt_ip_t ip = { 127, 0, 0, 1 };
+    SOCKET socket = skt_connect(ip, port, 2);
+    std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    skt_sendN(socket, request.data(), request.size());
+    
+    // Response ends with a blank line
+    std::string response;
+    char c;
+    while(response.size() < 4 || response.compare(response.size() - 2, 2, "\n\n") != 0){
+        if(skt_recvN(socket, &c, 1) != 0) break;
+        response.push_back(c);
+    }
+    return socket;
+}
+
+int main(int argc, char ** argv){
+    int clients = (argc > 1) ? std::atoi(argv[1]) : 8;
+    int messages = (argc > 2) ? std::atoi(argv[2]) : 2000;
+    unsigned int threads = (argc > 3) ? std::atoi(argv[3]) : 2;
+    unsigned int port = 9997;
+    
+    SignedWebSocketServer server(port);
+    server.setVerifier(threads, 64);
+    
+    // Echoes are small, don't let Nagle hold them for the client's delayed ack
+    skt_options_t options;
+    skt_options_init(&options);
+    options.nodelay = 1;
+    server.setSocketOptions(options);
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    
+    // Each client signs and sends, echoes come back once verified
+    std::atomic<int> echoed(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for(int c=0; c<clients; c++){
+        workers.emplace_back([&](){
+            Ed25519Signer signer;
+            SOCKET socket = openSocket(port);
+            sendFrame(socket, 0x1, hexEncode(signer.getPublicKey()));
+            
+            // Send everything first so checks from all clients queue up together
+            for(int i=0; i<messages; i++){
+                std::string message = "message " + std::to_string(i);
+                sendFrame(socket, 0x2, message + signer.sign(message));
+            }
+            for(int i=0; i<messages; i++){
+                if(readFrame(socket) != "message " + std::to_string(i)) break;
+                echoed++;
+            }
+            skt_close(socket);
+        });
+    }
+    for(auto & worker : workers){
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    
+    cout << echoed << " of " << clients * messages << " signed messages verified in order in "
+         << elapsed.count() << "s, " << echoed / elapsed.count() << " messages/s on "
+         << threads << " verifier threads\n";
+    
+    // A message with a bad signature should close the connection
+    Ed25519Signer signer;
+    SOCKET socket = openSocket(port);
+    sendFrame(socket, 0x1, hexEncode(signer.getPublicKey()));
+    std::string forged = "forged message";
+    std::string signature = signer.sign(forged);
+    signature[0] ^= 1;
+    sendFrame(socket, 0x2, forged + signature);
+    bool closed = readFrame(socket).empty();
+    skt_close(socket);
+    cout << "forged message " << (closed ? "closed the connection" : "was accepted") << "\n";
+    
+    cout << server.verifier().verified() << " checks, " << server.verifier().forged() << " forged\n";
+    server.stop();
+    return (closed && echoed == clients * messages) ? 0 : 1;
+}
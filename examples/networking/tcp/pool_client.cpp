@@ -0,0 +1,34 @@
+/*
+ * pool_client.cpp
+ * Author: Aven Bross
+ * Date: 9/14/2015
+ * 
+ * Testing the client connection pool
+ */
+ 
+#include <iostream>
+#include "../../../networking/connection_pool.h"
+
+using std::cout;
+using std::cin;
+
+int main(){
+    skt_ip_t ip = { 127, 0, 0, 1 };
+    unsigned int port = 9999;
+    
+    // Connect a few sockets up front, in parallel
+    ConnectionPool pool(500);
+    cout << "warmed " << pool.warm(ip, port, 4) << " connections\n";
+    
+    std::string msg;
+    while(cin >> msg){
+        SOCKET socket = pool.acquire(ip, port);
+        if(socket == INVALID_SOCKET){
+            cout << "could not connect\n";
+            continue;
+        }
+        bool ok = skt_sendN(socket, msg.c_str(), msg.size()+1) == 0;
+        pool.release(ip, port, socket, ok);
+    }
+    return 0;
+}
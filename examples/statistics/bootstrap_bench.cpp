@@ -0,0 +1,93 @@
+/*
+ * bootstrap_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Measures bootstrap intervals of the mean and median of lognormal data
+ * against copying each resample, from 1 to N threads, and checks every
+ * thread count draws exactly the same replicates.
+ *
+ * Usage: bootstrap_bench [thousands of values] [replicates] [max threads]
+ */
+
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/bootstrap.h"
+
+using std::cout;
+
+// Bootstrap the way the old scripts did, copying every resample
+BootstrapResult copyBootstrap(const std::vector<double> & values, std::size_t replicates, bool median){
+    std::mt19937_64 rng(0);
+    std::uniform_int_distribution<std::size_t> pick(0, values.size() - 1);
+    std::vector<double> resample(values.size());
+    BootstrapResult result;
+    for(std::size_t b=0; b<replicates; b++){
+        for(auto & value : resample){
+            value = values[pick(rng)];
+        }
+        if(median){
+            std::nth_element(resample.begin(), resample.begin() + resample.size() / 2, resample.end());
+            result.replicates.push_back(resample[resample.size() / 2]);
+        }
+        else{
+            double sum = 0;
+            for(double value : resample) sum += value;
+            result.replicates.push_back(sum / resample.size());
+        }
+    }
+    return result;
+}
+
+// Time one way of bootstrapping, print its interval and return its replicates
+template<typename Function>
+std::vector<double> run(const char * name, Function function, double & baseTime){
+    auto start = std::chrono::steady_clock::now();
+    BootstrapResult result = function();
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    if(baseTime == 0) baseTime = time.count();
+    auto interval = result.interval(0.95);
+    cout << name << "\t" << time.count() << "\t" << baseTime / time.count() << "\t["
+         << interval.first << ", " << interval.second << "]\n";
+    return result.replicates;
+}
+
+int main(int argc, char ** argv){
+    std::size_t size = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 100) * 1e3);
+    std::size_t replicates = (argc > 2) ? std::atoi(argv[2]) : 2000;
+    unsigned int maxThreads = (argc > 3) ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    if(maxThreads == 0) maxThreads = 1;
+
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> dist(0, 1);
+    std::vector<double> values(size);
+    for(auto & value : values){
+        value = dist(rng);
+    }
+
+    cout << "values: " << size << ", replicates: " << replicates << "\n";
+    for(int median=0; median<2; median++){
+        cout << "\n" << (median ? "median" : "mean") << "\nmethod\tseconds\tspeedup\t95% interval\n";
+        double baseTime = 0;
+        run("copying", [&]{ return copyBootstrap(values, replicates, median); }, baseTime);
+
+        std::vector<double> first;
+        bool same = true;
+        for(unsigned int threads=1; threads<=maxThreads; threads*=2){
+            std::string name = "weights/" + std::to_string(threads);
+            std::vector<double> replicated = run(name.c_str(), [&]{
+                return median ? bootstrapQuantile(values.begin(), values.end(), 0.5, replicates, 7, threads)
+                              : bootstrapMean(values.begin(), values.end(), replicates, 7, threads);
+            }, baseTime);
+            if(first.empty()) first = replicated;
+            same = same && replicated == first;
+            if(threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+        }
+        cout << "same replicates on every thread count: " << (same ? "yes" : "no") << "\n";
+    }
+    return 0;
+}
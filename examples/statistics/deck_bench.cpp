@@ -0,0 +1,168 @@
+/*
+ * deck_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Plays ride the bus on one thread with three decks: a vector that erases
+ * drawn cards and rescans past draws, the fixed array CardDeck, and
+ * CardDeckLanes playing 16 games at once. Prints games per second and the
+ * average drinks, which should agree to within the noise.
+ *
+ * Usage: deck_bench [thousands of games]
+ */
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/stats.h"
+#include "../../statistics/sampling.h"
+
+using std::cout;
+
+// Deck as ride_the_bus used to build it, a vector with cards erased as drawn
+class VectorDeck {
+public:
+    VectorDeck(){
+        for(int i=0; i<13; i++){
+            for(int j=0; j<4; j++){
+                cards.push_back(i);
+            }
+        }
+    }
+
+    int draw(CounterRandom & random){
+        int draw = random.below(cards.size());
+        int card = cards[draw];
+        cards.erase(cards.begin() + draw);
+        return card;
+    }
+
+private:
+    std::vector<int> cards;
+};
+
+// Play one game the old way, rebuilding the deck and rescanning past draws
+int vectorGame(CounterRandom & random){
+    int drinks = 0;
+    while(true){
+        VectorDeck deck;
+        std::vector<int> drawn;
+        int card = deck.draw(random);
+        bool win = true;
+        for(int t=0; t<6 && win; t++){
+            int above = (12 - card) * 4, below = card * 4;
+            for(int old : drawn){
+                if(old > card) above--;
+                else if(old < card) below--;
+            }
+            drawn.push_back(card);
+            int pcard = card;
+            card = deck.draw(random);
+            win = (above > below) ? card >= pcard : card <= pcard;
+        }
+        if(win) return drinks;
+        drinks++;
+    }
+}
+
+// Play one game on a fixed array deck with rank counts
+int deckGame(CounterRandom & random){
+    CardDeck deck;
+    int drinks = 0;
+    while(true){
+        deck.reset();
+        int card = deck.draw(random);
+        bool win = true;
+        for(int t=0; t<6 && win; t++){
+            int above = deck.above(card), below = deck.below(card);
+            int pcard = card;
+            card = deck.draw(random);
+            win = (above > below) ? card >= pcard : card <= pcard;
+        }
+        if(win) return drinks;
+        drinks++;
+    }
+}
+
+// Play games games 16 at a time, each lane plays its share then idles
+void laneGames(std::size_t games, CounterRandom & random, OneVarAccumulator<int> & records){
+    const std::size_t lanes = CardDeckLanes::lanes;
+    CardDeckLanes deck;
+    std::uint8_t card[lanes] = {}, next[lanes], above[lanes], below[lanes], step[lanes] = {}, reset[lanes];
+    int drinks[lanes] = {};
+    std::size_t quota[lanes], playing = 0;
+    for(std::size_t lane=0; lane<lanes; lane++){
+        quota[lane] = games / lanes + (lane < games % lanes);
+        playing += quota[lane] > 0;
+    }
+
+    while(playing > 0){
+        deck.around(card, above, below);
+        deck.draw(random, next);
+        for(std::size_t lane=0; lane<lanes; lane++){
+            reset[lane] = 0;
+            if(step[lane] == 0){
+                // First card of an attempt
+                card[lane] = next[lane];
+                step[lane] = 1;
+                continue;
+            }
+            bool win = (above[lane] > below[lane]) ? next[lane] >= card[lane] : next[lane] <= card[lane];
+            if(!win){
+                drinks[lane]++;
+                step[lane] = 0;
+                reset[lane] = 1;
+            }
+            else if(step[lane] == 6){
+                if(quota[lane] > 0){
+                    records.add(drinks[lane]);
+                    playing -= --quota[lane] == 0;
+                }
+                drinks[lane] = 0;
+                step[lane] = 0;
+                reset[lane] = 1;
+            }
+            else{
+                card[lane] = next[lane];
+                step[lane]++;
+            }
+        }
+        deck.reset(reset);
+    }
+}
+
+// Time one way of playing and print games per second and average drinks
+template<typename Function>
+void run(const char * name, std::size_t games, Function function, double & baseTime){
+    OneVarAccumulator<int> records;
+    auto start = std::chrono::steady_clock::now();
+    function(records);
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    if(baseTime == 0) baseTime = time.count();
+    OneVarResult result = records.result();
+    cout << name << "\t" << games / 1e6 / time.count() << "\t\t" << baseTime / time.count() << "\t"
+         << result.mean << " +- " << result.sd / std::sqrt((double)result.count) << "\n";
+}
+
+int main(int argc, char ** argv){
+    std::size_t games = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 1000) * 1e3);
+
+    cout << "games: " << games << "\n";
+    cout << "deck\tM games/s\tspeedup\taverage drinks\n";
+    double baseTime = 0;
+    run("vector", games, [&](OneVarAccumulator<int> & records){
+        CounterRandom random(1, 0);
+        for(std::size_t i=0; i<games; i++) records.add(vectorGame(random));
+    }, baseTime);
+    run("array", games, [&](OneVarAccumulator<int> & records){
+        CounterRandom random(2, 0);
+        for(std::size_t i=0; i<games; i++) records.add(deckGame(random));
+    }, baseTime);
+    run("lanes", games, [&](OneVarAccumulator<int> & records){
+        CounterRandom random(3, 0);
+        laneGames(games, random, records);
+    }, baseTime);
+    return 0;
+}
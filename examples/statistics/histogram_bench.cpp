@@ -0,0 +1,62 @@
+/*
+ * histogram_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Compares std::map against the dense backend on small integer counts and
+ * against the HDR backend on wide lognormal latencies.
+ *
+ * Usage: histogram_bench [millions of values]
+ */
+ 
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/stats.h"
+
+using std::cout;
+
+// Seconds to count every value into a fresh histogram, returns the number of bins through bins
+template<typename Histogram, typename T>
+double timeHistogram(Histogram histogram, const std::vector<T> & values, std::size_t & bins){
+    auto start = std::chrono::steady_clock::now();
+    addToHistogram(histogram, values.begin(), values.end());
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    bins = 0;
+    forEachBin(histogram, [&](const T &, std::size_t){ bins++; });
+    return time.count();
+}
+
+int main(int argc, char ** argv){
+    std::size_t size = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 16) * 1e6);
+    std::mt19937_64 rng(42);
+    
+    std::geometric_distribution<int> geometric(0.2);
+    std::vector<int> counts(size);
+    for(auto & value : counts){
+        value = geometric(rng);
+    }
+    
+    std::lognormal_distribution<double> lognormal(-7, 1.5);
+    std::vector<double> latencies(size);
+    for(auto & value : latencies){
+        value = lognormal(rng);
+    }
+    
+    cout << "values: " << size << "\n";
+    cout << "data\t\tbackend\tM values/s\tbins\n";
+    
+    std::size_t bins;
+    double time = timeHistogram(std::map<int,std::size_t>(), counts, bins);
+    cout << "small ints\tmap\t" << size / 1e6 / time << "\t\t" << bins << "\n";
+    time = timeHistogram(DenseHistogram<int>(), counts, bins);
+    cout << "small ints\tdense\t" << size / 1e6 / time << "\t\t" << bins << "\n";
+    time = timeHistogram(std::map<double,std::size_t>(), latencies, bins);
+    cout << "latencies\tmap\t" << size / 1e6 / time << "\t\t" << bins << "\n";
+    time = timeHistogram(HDRHistogram<double>(7, 1e-9), latencies, bins);
+    cout << "latencies\thdr\t" << size / 1e6 / time << "\t\t" << bins << "\n";
+    return 0;
+}
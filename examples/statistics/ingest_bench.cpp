@@ -0,0 +1,115 @@
+/*
+ * ingest_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Writes a dump of random latencies as raw doubles and as id,latency
+ * text, then times loading each into a vector first against feeding the
+ * accumulators straight from the file: mapped binary, the streaming column
+ * parser and the parallel column reduction.
+ *
+ * Usage: ingest_bench [millions of values] [max threads]
+ */
+
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../../statistics/ingest.h"
+
+using std::cout;
+
+const char * binaryPath = "ingest_bench.bin";
+const char * textPath = "ingest_bench.csv";
+
+// Time one way of reading a file, printing MB/s and the mean it found
+template<typename Function>
+void run(const std::string & name, std::size_t bytes, Function function){
+    auto start = std::chrono::steady_clock::now();
+    OneVarResult result = function();
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    cout << name << "\t" << time.count() << "\t" << bytes / 1e6 / time.count() << "\t"
+         << result.count << "\t" << result.mean << "\n";
+}
+
+int main(int argc, char ** argv){
+    std::size_t size = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 20) * 1e6);
+    unsigned int maxThreads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    if(maxThreads == 0) maxThreads = 1;
+
+    // Latencies in microseconds with three decimals, lognormal like real ones
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> dist(5, 1);
+    std::vector<double> values(size);
+    {
+        std::ofstream text(textPath);
+        text << "id,latency\n";
+        char line[64];
+        for(std::size_t i=0; i<size; i++){
+            int length = std::snprintf(line, sizeof(line), "%zu,%.3f\n", i, dist(rng));
+            text.write(line, length);
+            values[i] = std::atof(std::strchr(line, ',') + 1);
+        }
+        std::ofstream binary(binaryPath, std::ios::binary);
+        binary.write((const char *)values.data(), size * sizeof(double));
+    }
+    values.clear();
+    values.shrink_to_fit();
+
+    std::size_t binaryBytes = size * sizeof(double);
+    std::size_t textBytes = MappedFile(textPath).size();
+    cout << "values: " << size << ", binary: " << binaryBytes / 1e6 << " MB, text: " << textBytes / 1e6 << " MB\n";
+    cout << "reader\t\tseconds\tMB/s\tcount\tmean\n";
+
+    run("binary vector", binaryBytes, [&]{
+        std::ifstream in(binaryPath, std::ios::binary);
+        std::vector<double> loaded(size);
+        in.read((char *)loaded.data(), binaryBytes);
+        return parallelOneVarStats(loaded.begin(), loaded.end(), maxThreads);
+    });
+    run("binary mapped", binaryBytes, [&]{
+        return mappedOneVarStats<double>(binaryPath, maxThreads);
+    });
+
+    run("text vector", textBytes, [&]{
+        std::ifstream in(textPath);
+        std::vector<double> loaded;
+        std::string line;
+        std::getline(in, line);
+        while(std::getline(in, line)){
+            loaded.push_back(std::stod(line.substr(line.find(',') + 1)));
+        }
+        return parallelOneVarStats(loaded.begin(), loaded.end(), maxThreads);
+    });
+    run("text stream", textBytes, [&]{
+        ColumnParser parser(1);
+        OneVarAccumulator<double> stats;
+        std::vector<double> batch;
+        int fd = open(textPath, O_RDONLY);
+        parser.read(fd, [&](double value){
+            batch.push_back(value);
+            if(batch.size() == 4096){
+                stats.add(batch.data(), batch.size());
+                batch.clear();
+            }
+        });
+        close(fd);
+        stats.add(batch.data(), batch.size());
+        return stats.result();
+    });
+    for(unsigned int threads=1; threads<=maxThreads; threads*=2){
+        run("text mapped/" + std::to_string(threads), textBytes, [&]{
+            return parallelColumnStats(textPath, 1, ',', threads);
+        });
+        if(threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+
+    std::remove(binaryPath);
+    std::remove(textPath);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * multivar_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Measures MultiVarStats on a random column-major table against a naive
+ * two pass covariance, checks the two agree, then fits the first column
+ * against the rest and prints how well the planted coefficients come back.
+ *
+ * Usage: multivar_bench [thousands of rows] [columns] [max threads]
+ */
+
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/multivar.h"
+
+using std::cout;
+
+// Covariance of the first rows rows by centering a copy and summing pairs in long double
+std::vector<double> naiveCovariance(const std::vector<double> & data, std::size_t rows, std::size_t columns, std::size_t stride){
+    std::vector<double> centered(rows * columns);
+    for(std::size_t j=0; j<columns; j++){
+        long double sum = 0;
+        for(std::size_t r=0; r<rows; r++) sum += data[j * stride + r];
+        double mean = sum / rows;
+        for(std::size_t r=0; r<rows; r++) centered[j * rows + r] = data[j * stride + r] - mean;
+    }
+    std::vector<double> result(columns * columns);
+    for(std::size_t i=0; i<columns; i++){
+        for(std::size_t j=i; j<columns; j++){
+            long double sum = 0;
+            for(std::size_t r=0; r<rows; r++) sum += (long double)centered[i * rows + r] * centered[j * rows + r];
+            result[i * columns + j] = result[j * columns + i] = sum / rows;
+        }
+    }
+    return result;
+}
+
+// Largest difference between two matrices relative to the largest entry
+double difference(const std::vector<double> & a, const std::vector<double> & b){
+    double worst = 0, scale = 0;
+    for(std::size_t i=0; i<a.size(); i++){
+        worst = std::max(worst, std::abs(a[i] - b[i]));
+        scale = std::max(scale, std::abs(b[i]));
+    }
+    return scale > 0 ? worst / scale : worst;
+}
+
+int main(int argc, char ** argv){
+    std::size_t rows = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 1000) * 1e3);
+    std::size_t columns = (argc > 2) ? std::atoi(argv[2]) : 200;
+    unsigned int maxThreads = (argc > 3) ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    if(maxThreads == 0) maxThreads = 1;
+    if(columns < 2) columns = 2;
+
+    // Column 0 is a planted linear function of the others plus noise, all
+    // far from zero so a naive sum of products would lose most of its digits
+    std::mt19937_64 rng(42);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<double> beta(columns);
+    for(std::size_t j=1; j<columns; j++) beta[j] = dist(rng);
+    std::vector<double> data(rows * columns);
+    for(std::size_t r=0; r<rows; r++){
+        double shared = dist(rng), y = 3;
+        for(std::size_t j=1; j<columns; j++){
+            double x = 1e4 + j + dist(rng) + 0.5 * shared;
+            data[j * rows + r] = x;
+            y += beta[j] * x;
+        }
+        data[r] = y + dist(rng);
+    }
+
+    cout << "rows: " << rows << ", columns: " << columns << "\n";
+
+    // Check against the naive version on a prefix small enough for it
+    std::size_t checkRows = std::min<std::size_t>(rows, 20000);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> reference = naiveCovariance(data, checkRows, columns, rows);
+    std::chrono::duration<double> naiveTime = std::chrono::steady_clock::now() - start;
+    MultiVarStats check(columns);
+    check.add(data.data(), checkRows, rows);
+    cout << "naive two pass: " << checkRows / 1e3 / naiveTime.count() << " K rows/s, difference "
+         << difference(check.covariance(), reference) << "\n\n";
+
+    cout << "threads\tseconds\tK rows/s\tspeedup\tdifference\n";
+    std::vector<double> base;
+    MultiVarStats stats(columns);
+    double baseTime = 0;
+    for(unsigned int threads=1; threads<=maxThreads; threads*=2){
+        start = std::chrono::steady_clock::now();
+        MultiVarStats result = parallelMultiVarStats(data.data(), rows, columns, rows, threads);
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+        if(threads == 1){
+            base = result.covariance();
+            baseTime = time.count();
+            stats = result;
+        }
+        cout << threads << "\t" << time.count() << "\t" << rows / 1e3 / time.count() << "\t\t"
+             << baseTime / time.count() << "\t" << difference(result.covariance(), base) << "\n";
+        if(threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+
+    start = std::chrono::steady_clock::now();
+    Regression fit = stats.regress(0);
+    std::chrono::duration<double> fitTime = std::chrono::steady_clock::now() - start;
+    double worst = 0;
+    for(std::size_t j=1; j<columns; j++){
+        worst = std::max(worst, std::abs(fit.coefficients[j - 1] - beta[j]) / fit.standardErrors[j - 1]);
+    }
+    std::vector<double> correlation = stats.correlation();
+    cout << "\nregression of column 0 on " << columns - 1 << " columns in " << fitTime.count() << " s\n";
+    cout << "r2: " << fit.r2 << "\tresidual variance: " << fit.residualVariance << " (planted 1)\n";
+    cout << "worst coefficient error: " << worst << " standard errors\n";
+    cout << "correlation of columns 1 and 2: " << correlation[columns + 2] << " (planted " << 0.25 / 1.25 << ")\n";
+    return 0;
+}
@@ -5,123 +5,84 @@
  * 
  * Simulating "Riding the bus" to attempt to find the average
  * number of drinks the player will have to take.
+ *
+ * Usage: ride_the_bus [rounds] [threads] [seed]
  */
  
-#include <cmath>
-#include <random>
+#include <chrono>
 #include <iostream>
-#include <vector>
+#include <cstdlib>
 
-#include "../../statistics/stats.h"
+#include "../../statistics/montecarlo.h"
+#include "../../statistics/sampling.h"
 
-using std::vector;
 using std::cout;
 
-/*
- * Deck class:
- * Uses mersenne twister to allow good random card draws.
- * Cards are drawn without replacement.
- */
-class Deck {
-public:
-    // Constructor fills deck with 4 of each card (52 card deck)
-    Deck(){
-        for(int i=0; i<13; i++){
-            for(int j=0; j<4; j++){
-                cards.push_back(i);
-            }
-        }
-    }
-    
-    // Draw a random card from the deck
-    int draw(){
-        // cout<<"Got to func\n";
-        std::random_device rd;	//Create random device
-        // cout<<"Made rd\n";
-        std::mt19937 el(rd());	//Use 32 bit mersenne twister
-        // cout<<"Made el\n";
-        std::uniform_int_distribution<int> cdist(0,cards.size()-1);
-        // cout<<"Made dist\n";
-        
-        int draw = cdist(el);
-        // cout<<draw<<"\n";
-        int card = cards[draw];
-        cards.erase(cards.begin()+draw);
-        
-        return card;
-    }
-
-private:
-	vector<int> cards;
-};
-
-// How many rounds are we playing?
+// Default number of rounds to play
 const int rounds = 100000;
 
-int main(){
-    // Records drinks taken
-    vector<int> records;
+// Play one round, returning the drinks taken
+int playRound(CounterRandom & random){
+    bool win = false;
+    int drinks = 0;
     
-    // Play several rounds of the game
-    for(int i=0; i<rounds; i++){
-        bool win = false;
-        int drinks = 0;
+    // One fixed deck, shuffled back together before every attempt
+    CardDeck deck;
+    
+    // Drink until you win
+    while(!win){
+        deck.reset();
+        
+        int card = deck.draw(random);
+        
+        win=true;
         
-        // Drink until you win
-        while(!win){
-            // cout << "Making Decks\n";
-            Deck deck;
-            vector<int> drawn;
+        // Must guess right 6 times to win
+        for(int t=0; t<6; t++){
             
-            // cout << "Drawing first card\n";
-            int card = deck.draw();
+            // Count cards above and below left in the deck
+            int above = deck.above(card);
+            int below = deck.below(card);
             
-            win=true;
+            int pcard = card;
             
-            // Must guess right 6 times to win
-            for(int t=0; t<6; t++){
-                
-                // Count cards above and below
-                int above = (12-card)*4;
-                int below = card*4;
-                
-                // Taking account past draws
-                for(auto old_card : drawn){
-                    if(old_card > card)
-                        above--;
-                    else if(old_card < card)
-                        below--;
-                }
-                
-                // Saving current card
-                drawn.push_back(card);
-                int pcard = card;
-                
-                // Draw new card
-                card = deck.draw();
-                
-                // Checking guess
-                if(above>below){
-                    // We guess above, are we wrong?
-                    if(card<pcard){
-                        drinks += 1;
-                        win = false;
-                        break;
-                    }
+            // Draw new card
+            card = deck.draw(random);
+            
+            // Checking guess
+            if(above>below){
+                // We guess above, are we wrong?
+                if(card<pcard){
+                    drinks += 1;
+                    win = false;
+                    break;
                 }
-                else{
-                    // We guess below, are we wrong?
-                    if(card>pcard){
-                        drinks += 1;
-                        win = false;
-                        break;
-                    }
+            }
+            else{
+                // We guess below, are we wrong?
+                if(card>pcard){
+                    drinks += 1;
+                    win = false;
+                    break;
                 }
             }
         }
-        
-        records.push_back(drinks);
     }
     
-    oneVarStats(records);
+    return drinks;
+}
+
+int main(int argc, char ** argv){
+    std::size_t count = (argc > 1) ? std::atol(argv[1]) : rounds;
+    unsigned int threads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    std::uint64_t seed = (argc > 3) ? std::strtoull(argv[3], NULL, 10) : 0;
+    
+    // Play every round across the thread pool
+    auto start = std::chrono::steady_clock::now();
+    auto tally = monteCarlo(count, playRound, seed, threads);
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    
+    printStats(tally.result());
+    printHistogram(tally.histogram());
+    cout << "\nRounds/sec: " << count / time.count() << "\n";
 }
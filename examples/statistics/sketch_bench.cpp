@@ -0,0 +1,78 @@
+/*
+ * sketch_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Accuracy against memory and insert rate for the t-digest and KLL quantile
+ * sketches on lognormal latencies. Each sketch is built as four partials
+ * that go through serialize() and deserialize() before being merged.
+ *
+ * Usage: sketch_bench [millions of values]
+ */
+ 
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/sketch.h"
+
+using std::cout;
+
+const double quantiles[] = { 0.5, 0.99, 0.999 };
+
+// Fraction of sorted values below estimate, minus q
+double rankError(const std::vector<double> & sorted, double q, double estimate){
+    double rank = (double)(std::lower_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin()) / sorted.size();
+    return std::abs(rank - q);
+}
+
+// Build a sketch from four serialized partials and report its accuracy and speed
+template<typename Sketch>
+void measure(const char * name, double parameter, const std::vector<double> & values, const std::vector<double> & sorted){
+    std::vector<Sketch> partials(4, Sketch(parameter));
+    std::size_t quarter = values.size() / 4;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t p=0; p<4; p++){
+        auto first = values.begin() + p * quarter;
+        partials[p].add(first, (p == 3) ? values.end() : first + quarter);
+    }
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    
+    Sketch sketch = Sketch::deserialize(partials[0].serialize());
+    for(std::size_t p=1; p<4; p++){
+        sketch.merge(Sketch::deserialize(partials[p].serialize()));
+    }
+    
+    cout << name << "\t" << parameter << "\t" << sketch.bytes() << "\t" << values.size() / 1e6 / time.count() << "\t";
+    for(double q : quantiles){
+        double exact = sorted[(std::size_t)(q * sorted.size())];
+        double estimate = sketch.quantile(q);
+        cout << "\t" << rankError(sorted, q, estimate) << " / " << std::abs(estimate - exact) / exact;
+    }
+    cout << "\n";
+}
+
+int main(int argc, char ** argv){
+    std::size_t size = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 4) * 1e6);
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> lognormal(-7, 1.5);
+    std::vector<double> values(size);
+    for(auto & value : values){
+        value = lognormal(rng);
+    }
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    
+    cout.precision(3);
+    cout << "values: " << size << ", errors are rank / relative value\n";
+    cout << "sketch\tparam\tbytes\tM adds/s\tp50\t\t\tp99\t\t\tp99.9\n";
+    for(double compression : { 50, 100, 200, 500 }){
+        measure<TDigest>("tdigest", compression, values, sorted);
+    }
+    for(double k : { 100, 200, 400, 800 }){
+        measure<KLLSketch>("kll", k, values, sorted);
+    }
+    return 0;
+}
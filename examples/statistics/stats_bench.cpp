@@ -0,0 +1,68 @@
+/*
+ * stats_bench.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Measures parallelOneVarStats from 1 to N threads on random data and
+ * checks every result against the single thread one.
+ *
+ * Usage: stats_bench [millions of values] [max threads]
+ */
+ 
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "../../statistics/stats.h"
+
+using std::cout;
+
+// Largest relative difference between two summaries
+double difference(const OneVarResult & a, const OneVarResult & b){
+    double fields[][2] = { { a.mean, b.mean }, { a.variance, b.variance },
+                           { a.skewness, b.skewness }, { a.kurtosis, b.kurtosis } };
+    double worst = 0;
+    for(auto & field : fields){
+        double scale = std::max(std::abs(field[0]), std::abs(field[1]));
+        if(scale > 0) worst = std::max(worst, std::abs(field[0] - field[1]) / scale);
+    }
+    return worst;
+}
+
+int main(int argc, char ** argv){
+    std::size_t size = (std::size_t)(((argc > 1) ? std::atof(argv[1]) : 32) * 1e6);
+    unsigned int maxThreads = (argc > 2) ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    if(maxThreads == 0) maxThreads = 1;
+    
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<double> dist(0, 1);
+    std::vector<double> values(size);
+    for(auto & value : values){
+        value = 1000 + dist(rng);
+    }
+    
+    cout << "values: " << size << ", kernel: " << reductionKernel() << "\n";
+    cout << "threads\tseconds\tM values/s\tspeedup\tdifference\n";
+    
+    OneVarResult base;
+    double baseTime = 0;
+    for(unsigned int threads=1; threads<=maxThreads; threads*=2){
+        auto start = std::chrono::steady_clock::now();
+        OneVarResult result = parallelOneVarStats(values.begin(), values.end(), threads);
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        
+        if(threads == 1){
+            base = result;
+            baseTime = time.count();
+        }
+        cout << threads << "\t" << time.count() << "\t" << size / 1e6 / time.count() << "\t\t"
+             << baseTime / time.count() << "\t" << difference(base, result) << "\n";
+        if(threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    
+    cout << "\n";
+    printStats(base);
+    return 0;
+}
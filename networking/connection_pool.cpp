@@ -0,0 +1,114 @@
+/*
+ * connection_pool.cpp
+ * Author: Aven Bross
+ * Date: 9/14/2015
+ *
+ * Description:
+ * Client side pool of keepalive TCP connections to upstream servers.
+*/
+
+#include "connection_pool.h"
+
+/*
+ * class ConnectionPool
+ * Pool of connected client sockets, kept alive per (ip, port)
+ */
+
+// Constructor takes connect timeout and idle limits
+ConnectionPool::ConnectionPool(int connectTimeout, std::size_t maxIdle, int idleTimeout):
+  _connectTimeout(connectTimeout), _maxIdle(maxIdle), _idleTimeout(idleTimeout) {}
+
+// Borrow a connected socket, reusing the most recently returned idle socket if possible
+SOCKET ConnectionPool::acquire(skt_ip_t ip, unsigned int port){
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> idleLock(_mutex);
+    auto found = _idle.find(key(ip, port));
+    if(found != _idle.end()){
+        std::vector<IdleSocket> & sockets = found -> second;
+        while(sockets.size() > 0){
+            IdleSocket candidate = sockets.back();
+            sockets.pop_back();
+            
+            // Skip sockets that sat too long or that the server has closed
+            if(now - candidate.since < _idleTimeout && skt_idle_ok(candidate.socket)){
+                return candidate.socket;
+            }
+            skt_close(candidate.socket);
+        }
+    }
+    idleLock.unlock();
+    
+    // Nothing idle, make a new connection
+    SOCKET socket;
+    if(skt_connect_parallel(ip, port, 1, &socket, _connectTimeout) != 1){
+        return INVALID_SOCKET;
+    }
+    setup(socket);
+    return socket;
+}
+
+// Hand a socket back to the pool
+void ConnectionPool::release(skt_ip_t ip, unsigned int port, SOCKET socket, bool reusable){
+    if(socket == INVALID_SOCKET) return;
+    if(reusable){
+        std::lock_guard<std::mutex> idleLock(_mutex);
+        std::vector<IdleSocket> & sockets = _idle[key(ip, port)];
+        if(sockets.size() < _maxIdle){
+            sockets.push_back({socket, std::chrono::steady_clock::now()});
+            return;
+        }
+    }
+    skt_close(socket);
+}
+
+// Open count connections in parallel and keep them idle
+std::size_t ConnectionPool::warm(skt_ip_t ip, unsigned int port, std::size_t count){
+    std::vector<SOCKET> sockets(count, INVALID_SOCKET);
+    int opened = skt_connect_parallel(ip, port, count, sockets.data(), _connectTimeout);
+    for(SOCKET socket : sockets){
+        if(socket != INVALID_SOCKET){
+            setup(socket);
+            release(ip, port, socket);
+        }
+    }
+    return opened;
+}
+
+// Number of idle sockets held for the given server
+std::size_t ConnectionPool::idle(skt_ip_t ip, unsigned int port){
+    std::lock_guard<std::mutex> idleLock(_mutex);
+    auto found = _idle.find(key(ip, port));
+    return (found == _idle.end()) ? 0 : found -> second.size();
+}
+
+// Close every idle socket
+void ConnectionPool::clear(){
+    std::lock_guard<std::mutex> idleLock(_mutex);
+    for(auto & server : _idle){
+        for(IdleSocket & idle : server.second){
+            skt_close(idle.socket);
+        }
+    }
+    _idle.clear();
+}
+
+// Destructor closes idle sockets
+ConnectionPool::~ConnectionPool(){
+    clear();
+}
+
+// Pack ip and port into one key
+unsigned long long ConnectionPool::key(skt_ip_t ip, unsigned int port){
+    unsigned long long packed = 0;
+    for(unsigned char byte : ip.data){
+        packed = (packed << 8) | byte;
+    }
+    return (packed << 16) | (port & 0xFFFF);
+}
+
+// Prepare a freshly connected socket for pooling
+void ConnectionPool::setup(SOCKET socket){
+    // Have the kernel probe idle connections so dead peers get noticed
+    int on = 1;
+    setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, (const char *)&on, sizeof(on));
+}
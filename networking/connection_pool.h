@@ -0,0 +1,67 @@
+/*
+ * connection_pool.h
+ * Author: Aven Bross
+ * Date: 9/14/2015
+ *
+ * Description:
+ * Client side pool of keepalive TCP connections to upstream servers.
+*/
+
+#ifndef __CONNECTION_POOL_H
+#define __CONNECTION_POOL_H
+
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include "osl/socket.h"
+
+// Pool of connected client sockets, kept alive per (ip, port)
+class ConnectionPool {
+public:
+    // Constructor takes connect timeout and idle limits, all times in milliseconds
+    ConnectionPool(int connectTimeout = 1000, std::size_t maxIdle = 16, int idleTimeout = 60000);
+
+    // Borrow a connected socket to the given server, reusing an idle one if possible
+    // Returns INVALID_SOCKET if no connection could be made in time
+    SOCKET acquire(skt_ip_t ip, unsigned int port);
+
+    // Hand a socket back to the pool, pass reusable = false if the exchange broke
+    void release(skt_ip_t ip, unsigned int port, SOCKET socket, bool reusable = true);
+
+    // Open count connections to the given server in parallel and keep them idle
+    // Returns the number of connections actually opened
+    std::size_t warm(skt_ip_t ip, unsigned int port, std::size_t count);
+
+    // Number of idle sockets held for the given server
+    std::size_t idle(skt_ip_t ip, unsigned int port);
+
+    // Close every idle socket
+    void clear();
+
+    // Closes idle sockets
+    ~ConnectionPool();
+
+protected:
+    // Idle socket and the time it was returned to the pool
+    struct IdleSocket {
+        SOCKET socket;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    // Pack ip and port into one key
+    static unsigned long long key(skt_ip_t ip, unsigned int port);
+
+    // Prepare a freshly connected socket for pooling
+    void setup(SOCKET socket);
+
+    int _connectTimeout;    // Milliseconds to wait for a new connection
+    std::size_t _maxIdle;   // Max idle sockets kept per server
+    std::chrono::milliseconds _idleTimeout;   // Idle sockets older than this are closed
+
+    // Idle sockets by server, most recently used at the back
+    std::unordered_map<unsigned long long, std::vector<IdleSocket>> _idle;
+    std::mutex _mutex;  // Idle list mutex
+};
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * encrypted_websocket_server.cpp
+ * Author: Aven Bross
+ * Date: 10/12/2015
+ * 
+ * Description:
+ * Websocket server whose messages are encrypted with AES-256-GCM, keyed
+ * from an ECDH exchange with each client.
+*/
+
+#include "encrypted_websocket_server.h"
+
+/*
+ * class EncryptedWebSocketServer : WebSocketServer
+ * Subclass of WebSocketServer that makes encrypted connections
+ */
+
+// Replace the key pool, keeping depth key pairs ready using the given number of threads
+void EncryptedWebSocketServer::setKeyPool(std::size_t depth, unsigned int threads){
+    _keyPool.reset(new ECDHKeyPool(depth, threads));
+}
+
+// Pool of pregenerated key pairs for new connections
+ECDHKeyPool & EncryptedWebSocketServer::keyPool(){
+    return *_keyPool;
+}
+
+// Replace the session cache, keeping at most maxSessions tickets for ttl milliseconds
+void EncryptedWebSocketServer::setSessionCache(std::size_t maxSessions, int ttl){
+    _sessions.reset(new SessionCache(maxSessions, ttl));
+}
+
+// Resumption tickets handed to clients
+SessionCache & EncryptedWebSocketServer::sessionCache(){
+    return *_sessions;
+}
+
+// Make a new encrypted connection for the server
+std::shared_ptr<TCPConnection> EncryptedWebSocketServer::makeConnection(int socket, const sockaddr & clientAddress){
+    return std::make_shared<EncryptedWebSocketConnection>(socket, this, clientAddress);
+}
+
+
+/*
+ * class EncryptedWebSocketConnection : WebSocketConnection
+ * Connection class representing an encrypted WebSocket connection
+ */
+
+// HKDF info string, binds the derived keys to this protocol
+const std::string EncryptedWebSocketConnection::_keyInfo = "avenlib websocket aes-256-gcm";
+const std::string EncryptedWebSocketConnection::_resumeInfo = "avenlib websocket resumption";
+
+// Constructor
+EncryptedWebSocketConnection::EncryptedWebSocketConnection(int socket, Server * server, const sockaddr & toAddress):
+  WebSocketConnection(socket, server, toAddress), _sendCounter(0), _recieveCounter(0) {}
+
+// Encrypt and send message
+bool EncryptedWebSocketConnection::sendMessage(const std::string & message, bool binary){
+    std::lock_guard<std::mutex> sendLock(_sendMutex);
+    if(_sendCipher == nullptr){
+        return false;
+    }
+    
+    // Lay out header, plaintext, iv and tag in one buffer, then encrypt in place
+    std::size_t length = message.size() + AESGCM::ivSize + AESGCM::tagSize;
+    bool oneFrame = length <= USHRT_MAX;
+    std::string frame;
+    frame.reserve(4 + length);
+    if(oneFrame){
+        appendFrameHeader(frame, true, 0x2, length);
+    }
+    std::size_t start = frame.size();
+    frame.append(message);
+    frame.resize(start + length);
+    
+    unsigned char * data = (unsigned char *)&frame[start];
+    unsigned char * iv = data + message.size();
+    makeIV(iv, ++_sendCounter);
+    if(!_sendCipher -> encrypt(data, message.size(), iv, iv + AESGCM::ivSize)){
+        return false;
+    }
+    
+    // Large messages go out fragmented
+    return oneFrame ? sendTCP(frame) : WebSocketConnection::sendMessage(frame, true);
+}
+
+// Check if keys have been exchanged
+bool EncryptedWebSocketConnection::isSecure(){
+    return _recieveCipher != nullptr;
+}
+
+// Handle key exchange, then decrypt each message in place
+void EncryptedWebSocketConnection::recieveMessage(std::string & message, bool binary){
+    if(!isSecure()){
+        // Unusable tickets are answered with an error so the client can do a full exchange
+        if(message.compare(0, 2, "2,") == 0){
+            if(!resumeSession(message) && !WebSocketConnection::sendMessage("0", false)){
+                fail();
+            }
+        }
+        else if(!exchangeKeys(message)){
+            fail();
+        }
+        return;
+    }
+    
+    if(message.size() < AESGCM::ivSize + AESGCM::tagSize){
+        fail();
+        return;
+    }
+    
+    std::size_t length = message.size() - AESGCM::ivSize - AESGCM::tagSize;
+    unsigned char * data = (unsigned char *)&message[0];
+    unsigned char * iv = data + length;
+    
+    // Refuse replayed or reordered messages
+    unsigned long long counter = readIV(iv);
+    if(counter <= _recieveCounter || !_recieveCipher -> decrypt(data, length, iv, iv + AESGCM::ivSize)){
+        fail();
+        return;
+    }
+    _recieveCounter = counter;
+    
+    // Plaintext is at the front, just drop iv and tag
+    message.resize(length);
+    WebSocketConnection::recieveMessage(message, binary);
+}
+
+// Handle client key share and send ours
+bool EncryptedWebSocketConnection::exchangeKeys(const std::string & message){
+    // Expect "type,x,y" for secp256k1 or "type,k" for X25519, 64 hex digits per field
+    std::size_t first = message.find(',');
+    std::size_t fields = (first == std::string::npos) ? 0 : (message.size() - first) / 65;
+    if((fields != 1 && fields != 2) || message.size() != first + 65 * fields){
+        return false;
+    }
+    
+    unsigned char peerKey[KeyExchange::maxPublicKeySize];
+    try{
+        for(std::size_t i=0; i<fields; i++){
+            if(message[first + 65 * i] != ','){
+                return false;
+            }
+            hexDecode(message.data() + first + 65 * i + 1, 64, peerKey + 32 * i);
+        }
+    }
+    catch(const std::invalid_argument &){
+        return false;
+    }
+    
+    // The client picks the curve by key length, secp256k1 key pairs come pregenerated from the server pool
+    EncryptedWebSocketServer * server = dynamic_cast<EncryptedWebSocketServer *>(_server);
+    if(fields == 1){
+        _exchange.reset(new X25519());
+    }
+    else{
+        _exchange = server ? server -> keyPool().acquire() : std::unique_ptr<ECDH>(new ECDH());
+    }
+    _exchange -> recieveKey(peerKey, 32 * fields);
+    unsigned char secret[KeyExchange::secretSize];
+    std::size_t secretLength = _exchange -> getSecret(secret, sizeof(secret));
+    unsigned char publicKey[KeyExchange::maxPublicKeySize];
+    if(secretLength == 0 || !_exchange -> getPublicKey(publicKey)){
+        return false;
+    }
+    
+    // One key per direction
+    std::string sharedSecret((char *)secret, secretLength);
+    OPENSSL_cleanse(secret, sizeof(secret));
+    std::string keys = hkdf(sharedSecret, "", _keyInfo, 2 * AESGCM::keySize);
+    std::string ticket = issueTicket(hkdf(sharedSecret, "", _resumeInfo, AESGCM::keySize));
+    
+    // Reply "1,x,y,ticket" or "1,k,ticket" in hex
+    std::string reply(1 + 65 * fields, ',');
+    reply[0] = '1';
+    for(std::size_t i=0; i<fields; i++){
+        hexEncode(publicKey + 32 * i, 32, &reply[2 + 65 * i]);
+    }
+    if(!ticket.empty()){
+        reply += "," + ticket;
+    }
+    if(!WebSocketConnection::sendMessage(reply, false)){
+        return false;
+    }
+    
+    startCiphers(keys);
+    return true;
+}
+
+// Handle client resumption ticket, returns false if it cannot be used
+bool EncryptedWebSocketConnection::resumeSession(const std::string & message){
+    EncryptedWebSocketServer * server = dynamic_cast<EncryptedWebSocketServer *>(_server);
+    
+    // Expect "2,ticket,nonce" with a 16 byte ticket and nonce
+    const std::size_t hexSize = 2 * SessionCache::ticketSize;
+    if(server == nullptr || message.size() != 2 + hexSize + 1 + hexSize || message[2 + hexSize] != ','){
+        return false;
+    }
+    
+    std::string ticket(SessionCache::ticketSize, '\0'), nonces(2 * SessionCache::ticketSize, '\0');
+    try{
+        hexDecode(message.data() + 2, hexSize, (unsigned char *)&ticket[0]);
+        hexDecode(message.data() + 3 + hexSize, hexSize, (unsigned char *)&nonces[0]);
+    }
+    catch(const std::invalid_argument &){
+        return false;
+    }
+    
+    std::string resumption;
+    if(!server -> sessionCache().redeem(ticket, resumption)){
+        return false;
+    }
+    
+    // Fresh nonce from each side keeps resumed keys unique
+    if(1 != RAND_bytes((unsigned char *)&nonces[SessionCache::ticketSize], SessionCache::ticketSize)){
+        return false;
+    }
+    std::string keys = hkdf(resumption, nonces, _keyInfo, 2 * AESGCM::keySize);
+    std::string next = issueTicket(hkdf(resumption, nonces, _resumeInfo, AESGCM::keySize));
+    OPENSSL_cleanse(&resumption[0], resumption.size());
+    
+    // Reply "2,nonce,ticket" in hex
+    std::string reply = "2," + hexEncode(nonces.substr(SessionCache::ticketSize)) + "," + next;
+    if(!WebSocketConnection::sendMessage(reply, false)){
+        return false;
+    }
+    
+    startCiphers(keys);
+    return true;
+}
+
+// Store the resumption secret with the server, returns its ticket in hex
+std::string EncryptedWebSocketConnection::issueTicket(const std::string & resumption){
+    EncryptedWebSocketServer * server = dynamic_cast<EncryptedWebSocketServer *>(_server);
+    if(server == nullptr){
+        return std::string("");
+    }
+    return hexEncode(server -> sessionCache().issue(resumption));
+}
+
+// Start ciphers from 64 bytes of key material, client to server key first
+void EncryptedWebSocketConnection::startCiphers(const std::string & keys){
+    std::lock_guard<std::mutex> sendLock(_sendMutex);
+    _sendCipher.reset(new AESGCM(keys.substr(AESGCM::keySize, AESGCM::keySize)));
+    _recieveCipher.reset(new AESGCM(keys.substr(0, AESGCM::keySize)));
+}
+
+// Build iv from a message counter: 4 zero bytes then the counter big-endian
+void EncryptedWebSocketConnection::makeIV(unsigned char * iv, unsigned long long counter){
+    for(int i=0; i<4; i++){
+        iv[i] = 0;
+    }
+    for(int i=11; i>=4; i--){
+        iv[i] = (unsigned char)counter;
+        counter >>= 8;
+    }
+}
+
+// Read message counter from iv, 0 if malformed
+unsigned long long EncryptedWebSocketConnection::readIV(const unsigned char * iv){
+    if(iv[0] | iv[1] | iv[2] | iv[3]){
+        return 0;
+    }
+    unsigned long long counter = 0;
+    for(int i=4; i<12; i++){
+        counter = (counter << 8) | iv[i];
+    }
+    return counter;
+}
@@ -0,0 +1,102 @@
+/*
+ * encrypted_websocket_server.h
+ * Author: Aven Bross
+ * Date: 10/12/2015
+ * 
+ * Description:
+ * Websocket server whose messages are encrypted with AES-256-GCM, keyed
+ * from an ECDH exchange with each client.
+*/
+
+#ifndef __ENCRYPTED_WEBSOCKET_SERVER_H
+#define __ENCRYPTED_WEBSOCKET_SERVER_H
+
+#include "websocket_server.h"
+#include "../cryptography/session_cache.h"
+
+// Subclass of WebSocketServer that makes encrypted connections
+class EncryptedWebSocketServer : public WebSocketServer{
+public:
+    using WebSocketServer::WebSocketServer;
+    
+    // Replace the key pool, keeping depth key pairs ready using the given number of threads
+    void setKeyPool(std::size_t depth, unsigned int threads = 1);
+    
+    // Pool of pregenerated key pairs for new connections
+    ECDHKeyPool & keyPool();
+    
+    // Replace the session cache, keeping at most maxSessions tickets for ttl milliseconds
+    void setSessionCache(std::size_t maxSessions, int ttl);
+    
+    // Resumption tickets handed to clients
+    SessionCache & sessionCache();
+    
+protected:
+    // Make a new encrypted connection for the server
+    virtual std::shared_ptr<TCPConnection> makeConnection(int socket, const sockaddr & clientAddress);
+    
+    std::unique_ptr<ECDHKeyPool> _keyPool{new ECDHKeyPool()};  // Key pairs for new connections
+    std::unique_ptr<SessionCache> _sessions{new SessionCache()};    // Resumption tickets
+};
+
+/*
+ * Connection class representing an encrypted WebSocket connection
+ *
+ * The client opens with a text message "0,<x>,<y>" holding its secp256k1
+ * public key as hex coordinates, and the server answers "1,<x>,<y>,<ticket>"
+ * with its own. Clients that send a single 32 byte key "0,<k>" get an X25519
+ * exchange instead, answered with "1,<k>,<ticket>". Both sides run HKDF-SHA256 over the shared secret to get one
+ * AES-256 key per direction, plus a resumption secret stored under ticket.
+ *
+ * A returning client may instead open with "2,<ticket>,<nonce>" and the
+ * server answers "2,<nonce>,<new ticket>", both sides deriving the keys from
+ * the resumption secret and the two nonces. Tickets work once; an unknown
+ * one gets "0" back and the client falls back to a full exchange. From then on every message is a binary frame
+ * laid out as ciphertext, 12 byte iv, 16 byte tag, where the iv is a
+ * per direction message counter that must always increase.
+ */
+class EncryptedWebSocketConnection : public WebSocketConnection {
+public:
+    EncryptedWebSocketConnection(int socket, Server * server, const sockaddr & toAddress);
+    
+    using WebSocketConnection::sendMessage;
+    
+    // Encrypt and send message, fails until keys have been exchanged
+    virtual bool sendMessage(const std::string & message, bool binary);
+    
+    // Check if keys have been exchanged
+    bool isSecure();
+    
+protected:
+    // Handle key exchange, then decrypt each message in place
+    virtual void recieveMessage(std::string & message, bool binary);
+    
+    // Handle client key share and send ours
+    bool exchangeKeys(const std::string & message);
+    
+    // Handle client resumption ticket, returns false if it cannot be used
+    bool resumeSession(const std::string & message);
+    
+    // Store the resumption secret with the server, returns its ticket in hex
+    std::string issueTicket(const std::string & resumption);
+    
+    // Start ciphers from 64 bytes of key material, client to server key first
+    void startCiphers(const std::string & keys);
+    
+    // Build iv from a message counter
+    static void makeIV(unsigned char * iv, unsigned long long counter);
+    
+    // Read message counter from iv, 0 if malformed
+    static unsigned long long readIV(const unsigned char * iv);
+    
+    std::unique_ptr<KeyExchange> _exchange;     // Key exchange state
+    std::unique_ptr<AESGCM> _sendCipher;    // Server to client cipher
+    std::unique_ptr<AESGCM> _recieveCipher; // Client to server cipher
+    unsigned long long _sendCounter;    // Last iv counter sent
+    unsigned long long _recieveCounter; // Last iv counter recieved
+    std::mutex _sendMutex;  // Guards send cipher and counter
+    static const std::string _keyInfo;  // HKDF info string for session keys
+    static const std::string _resumeInfo;   // HKDF info string for resumption secrets
+};
+
+#endif
@@ -26,6 +26,13 @@ Written by Orion Sky Lawlor, olawlor@acm.org 1999-2006 (Public Domain)
 #include <signal.h>
 #include <time.h>
 #include <ctype.h>
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#  include <poll.h>
+#  include <netinet/tcp.h>
+#endif
+#if defined(__linux__)
+#  include <sys/sendfile.h>
+#endif
 
 /* socklen_t is needed by getsockname */
 #if defined(socklen_t) || defined(__APPLE__) || defined(_AIX) || defined(HAVE_SOCKLEN_T) || defined(__socklen_t_defined)
@@ -114,6 +121,51 @@ void skt_close(SOCKET fd)
 #endif
 
 
+/************** Platform helpers for non-blocking connect ***************/
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#  define SKT_EINPROGRESS WSAEWOULDBLOCK
+#  define SKT_ECONNREFUSED WSAECONNREFUSED
+#  define SKT_ETIMEDOUT WSAETIMEDOUT
+#  define SKT_EINTR WSAEINTR
+static int skt_errno(void) {return WSAGetLastError();}
+static void skt_set_errno(int err) {WSASetLastError(err);}
+static void skt_sleep_ms(long msec) {Sleep(msec);}
+static long skt_clock_ms(void) {return (long)GetTickCount();}
+void skt_set_blocking(SOCKET fd, int blocking)
+{
+	u_long nonblocking=!blocking;
+	ioctlsocket(fd, FIONBIO, &nonblocking);
+}
+#else
+#  define SKT_EINPROGRESS EINPROGRESS
+#  define SKT_ECONNREFUSED ECONNREFUSED
+#  define SKT_ETIMEDOUT ETIMEDOUT
+#  define SKT_EINTR EINTR
+static int skt_errno(void) {return errno;}
+static void skt_set_errno(int err) {errno=err;}
+static void skt_sleep_ms(long msec) {usleep(1000*msec);}
+static long skt_clock_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+void skt_set_blocking(SOCKET fd, int blocking)
+{
+	int flags=fcntl(fd, F_GETFL, 0);
+	if (blocking) flags&=~O_NONBLOCK;
+	else flags|=O_NONBLOCK;
+	fcntl(fd, F_SETFL, flags);
+}
+#endif
+
+/* Errors worth retrying a connect after: the server is probably
+   restarting, or we were interrupted. */
+static int skt_connect_transient(int err)
+{
+	return err==SKT_ECONNREFUSED || err==SKT_EINTR;
+}
+
 /*Called when a socket or select routine returns
 an error-- determines how to respond.
 Return 1 if the last call was interrupted
@@ -366,12 +418,30 @@ SOCKET skt_server(unsigned int *port)
 }
 
 SOCKET skt_server_ip(unsigned int *port, skt_ip_t *ip)
+{
+  return skt_server_opts(port,ip,NULL);
+}
+
+void skt_listen_options_init(skt_listen_options_t *opts)
+{
+  opts->backlog=-1;
+  opts->defer_accept=-1;
+  opts->fastopen=-1;
+}
+
+SOCKET skt_server_opts(unsigned int *port, skt_ip_t *ip, const skt_listen_options_t *opts)
 {
   SOCKET             ret;
   socklen_t          len;
   int on = 1; /* for setsockopt */
   int connPort=(port==NULL)?0:*port;
   struct sockaddr_in addr=skt_build_addr((ip==NULL)?_skt_invalid_ip:*ip,connPort);
+  skt_listen_options_t defaults;
+  
+  if (opts==NULL) {
+    skt_listen_options_init(&defaults);
+    opts=&defaults;
+  }
   
 retry:
   ret = socket(PF_INET, SOCK_STREAM, 0);
@@ -385,7 +455,19 @@ retry:
   
   if (bind(ret, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) 
 	  return skt_abort(93484,"Error binding server socket.  Is another process listening on that port already?");
-  if (listen(ret,5) == SOCKET_ERROR) 
+#ifdef TCP_DEFER_ACCEPT
+  if (opts->defer_accept>0 &&
+      setsockopt(ret, IPPROTO_TCP, TCP_DEFER_ACCEPT, (const char *)&opts->defer_accept, sizeof(int)) == SOCKET_ERROR)
+	  return skt_abort(93487,"Error on TCP_DEFER_ACCEPT sockopt.");
+#endif
+#ifdef TCP_FASTOPEN
+  if (opts->fastopen>0 &&
+      setsockopt(ret, IPPROTO_TCP, TCP_FASTOPEN, (const char *)&opts->fastopen, sizeof(int)) == SOCKET_ERROR)
+	  return skt_abort(93488,"Error on TCP_FASTOPEN sockopt.");
+#endif
+  /* A short backlog overflows under a reconnect storm, and each 
+     dropped SYN costs the client a second or more of backoff. */
+  if (listen(ret,(opts->backlog>0)?opts->backlog:SOMAXCONN) == SOCKET_ERROR) 
 	  return skt_abort(93485,"Error listening on server socket.");
   len = sizeof(addr);
   if (getsockname(ret, (struct sockaddr *)&addr, &len) == SOCKET_ERROR) 
@@ -414,41 +496,387 @@ retry:
   return ret;
 }
 
+int skt_accept_batch(SOCKET src_fd, SOCKET *skts, skt_ip_t *pips, unsigned int *ports, int nMax)
+{
+  int n=0, err;
+  while (n<nMax)
+  {
+    socklen_t len;
+    struct sockaddr_in addr={0};
+    SOCKET ret;
+    len = sizeof(addr);
+#if defined(__linux__) && defined(SOCK_CLOEXEC)
+    ret = accept4(src_fd, (struct sockaddr *)&addr, &len, SOCK_CLOEXEC);
+#else
+    ret = accept(src_fd, (struct sockaddr *)&addr, &len);
+#endif
+    if (ret == SOCKET_ERROR) {
+      err=skt_errno();
+      /* Client gave up while queued, or a signal: keep draining */
+      if (err==SKT_EINTR || err==ECONNABORTED) continue;
+      /* Queue is empty: hand back what we have */
+      if (err==EAGAIN || err==EWOULDBLOCK || n>0) break;
+      /* Out of descriptors with nothing accepted: the connection stays 
+         queued, so tell the caller instead of looking like an empty queue */
+      if (err==EMFILE || err==ENFILE) return SOCKET_ERROR;
+      return skt_abort(93523,"Error in accept.");
+    }
+#if !defined(__linux__)
+    /* BSD sockets inherit O_NONBLOCK from the listener */
+    skt_set_blocking(ret,1);
+#endif
+    skts[n]=ret;
+    if (ports!=NULL) ports[n]=ntohs(addr.sin_port);
+    if (pips!=NULL) memcpy(&pips[n],&addr.sin_addr,sizeof(pips[n]));
+    n++;
+  }
+  return n;
+}
+
 SOCKET skt_connect(skt_ip_t ip, int port, int timeout)
+{
+  return skt_connect_ms(ip,port,1000*timeout);
+}
+
+/* Begin a non-blocking connect to this address.
+   Returns the new (non-blocking) socket, or SOCKET_ERROR if the 
+   connect failed outright, leaving the error in skt_errno().
+   *done is set to 1 if the connect has already completed. */
+static SOCKET skt_connect_begin(const struct sockaddr_in *addr,int *done)
+{
+  SOCKET ret;
+  int err;
+  *done=0;
+  ret = socket(AF_INET, SOCK_STREAM, 0);
+  if (ret==SOCKET_ERROR) return SOCKET_ERROR;
+  skt_set_blocking(ret,0);
+  if (connect(ret, (struct sockaddr *)addr, sizeof(*addr)) != SOCKET_ERROR) {
+    skt_set_blocking(ret,1);
+    *done=1;
+    return ret;
+  }
+  err=skt_errno();
+  if (err==SKT_EINPROGRESS) return ret;
+  skt_close(ret);
+  skt_set_errno(err);
+  return SOCKET_ERROR;
+}
+
+/* Finish a connect once the socket has become writable.
+   Returns 0 and restores blocking mode on success,
+   else returns the socket error code. */
+static int skt_connect_finish(SOCKET fd)
+{
+  int err=0;
+  socklen_t len=sizeof(err);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len) == SOCKET_ERROR)
+    return skt_errno();
+  if (err==0) skt_set_blocking(fd,1);
+  return err;
+}
+
+/* Wait up to msec for a connecting socket to become writable.
+   Returns 1 if writable, 0 on timeout, -1 on error. */
+static int skt_wait_writable(SOCKET fd, long msec)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  fd_set wfds, efds;
+  struct timeval tmo;
+  FD_ZERO(&wfds);
+  FD_SET(fd, &wfds);
+  FD_ZERO(&efds);
+  FD_SET(fd, &efds);
+  tmo.tv_sec=msec/1000;
+  tmo.tv_usec=(msec%1000)*1000;
+  return select(1+fd, NULL, &wfds, &efds, &tmo);
+#else
+  /* poll, not select: fd may be past FD_SETSIZE in a busy process */
+  struct pollfd pfd;
+  pfd.fd=fd;
+  pfd.events=POLLOUT;
+  pfd.revents=0;
+  return poll(&pfd, 1, (int)msec);
+#endif
+}
+
+/* Backoff after a refused connect: short, doubling, and capped,
+   so we notice a restarted server almost immediately. */
+#define skt_connect_backoff_min 2
+#define skt_connect_backoff_max 100
+
+SOCKET skt_connect_ms(skt_ip_t ip, int port, int msec)
 {
   struct sockaddr_in addr=skt_build_addr(ip,port);
-  int                ok, begin;
-  SOCKET             ret;
+  long deadline=skt_clock_ms()+msec;
+  long left;
+  int backoff=skt_connect_backoff_min;
+  int done, err, nready;
+  SOCKET ret;
   
-  begin = time(0);
-  while (time(0)-begin < timeout) 
+  while ((left=deadline-skt_clock_ms()) > 0)
   {
-    ret = socket(AF_INET, SOCK_STREAM, 0);
-    if (ret==SOCKET_ERROR) 
-    {
-	  if (skt_should_retry()) continue;  
-      else return skt_abort(93512,"Error creating socket");
-    }
-    ok = connect(ret, (struct sockaddr *)&(addr), sizeof(addr));
-    if (ok != SOCKET_ERROR) 
-	  return ret;/*Good connect*/
-	else { /*Bad connect*/
-	  skt_close(ret);
-	  if (skt_should_retry()) continue;
-	  else return skt_abort(93515,"Error connecting to socket\n");
+    ret = skt_connect_begin(&addr,&done);
+    if (ret==SOCKET_ERROR) err=skt_errno();
+    else if (done) return ret;/*Good connect*/
+    else {
+      nready = skt_wait_writable(ret,left);
+      if (nready>0 && 0==(err=skt_connect_finish(ret)))
+        return ret;/*Good connect*/
+      if (nready==0) err=SKT_ETIMEDOUT;
+      else if (nready<0) err=skt_errno();
+      skt_close(ret);
     }
+    /*Bad connect*/
+    if (err==SKT_ETIMEDOUT) break;
+    if (!skt_connect_transient(err))
+      return skt_abort(93515,"Error connecting to socket\n");
+    if (idleFunc!=NULL) idleFunc();
+    else skt_sleep_ms(backoff<left?backoff:left);
+    if (backoff<skt_connect_backoff_max) backoff*=2;
   }
   /*Timeout*/
   return skt_abort(93517,"Timeout in socket connect\n");
 }
 
+#if defined(_WIN32) && !defined(__CYGWIN__)
+static int skt_quiet_abort(int code,const char *msg) {return -1;}
+
+/* No poll() in winsock 1: just connect one at a time. */
+int skt_connect_parallel(skt_ip_t ip, int port, int n, SOCKET *skts, int msec)
+{
+  long deadline=skt_clock_ms()+msec;
+  skt_abortFn old=skt_set_abort(skt_quiet_abort);
+  int i, nConnected=0;
+  for (i=0;i<n;i++) {
+    long left=deadline-skt_clock_ms();
+    skts[i]=INVALID_SOCKET;
+    if (left<=0) continue;
+    skts[i]=skt_connect_ms(ip,port,left);
+    if (skts[i]==(SOCKET)SOCKET_ERROR) skts[i]=INVALID_SOCKET;
+    else nConnected++;
+  }
+  skt_set_abort(old);
+  return nConnected;
+}
+#else
+int skt_connect_parallel(skt_ip_t ip, int port, int n, SOCKET *skts, int msec)
+{
+  struct sockaddr_in addr=skt_build_addr(ip,port);
+  long deadline=skt_clock_ms()+msec;
+  long left, wait, retryAt=0;
+  int backoff=skt_connect_backoff_min;
+  int i, done, err, nPending, nConnected=0, nIdle=n;
+  struct pollfd *fds;
+  int *slot;
+  char *state; /* per slot: 0 no socket, 1 connecting, 2 connected */
+  
+  if (n<=0) return 0;
+  fds=(struct pollfd *)malloc(n*sizeof(struct pollfd));
+  slot=(int *)malloc(n*sizeof(int));
+  state=(char *)calloc(n,1);
+  for (i=0;i<n;i++) skts[i]=INVALID_SOCKET;
+  
+  while (nConnected<n && (left=deadline-skt_clock_ms()) > 0)
+  {
+    /* Start a connect on every empty slot, once any backoff is over */
+    if (nIdle>0 && skt_clock_ms()>=retryAt) {
+      for (i=0;i<n;i++) if (state[i]==0) {
+        SOCKET s=skt_connect_begin(&addr,&done);
+        if (s==SOCKET_ERROR) {
+          if (!skt_connect_transient(skt_errno())) goto finished;
+          break; /* try the rest after a backoff */
+        }
+        skts[i]=s;
+        nIdle--;
+        if (done) {state[i]=2; nConnected++;}
+        else state[i]=1;
+      }
+      if (nIdle>0) {
+        retryAt=skt_clock_ms()+backoff;
+        if (backoff<skt_connect_backoff_max) backoff*=2;
+      }
+    }
+    
+    /* Wait on every connect still in progress at once */
+    nPending=0;
+    for (i=0;i<n;i++) if (state[i]==1) {
+      fds[nPending].fd=skts[i];
+      fds[nPending].events=POLLOUT;
+      fds[nPending].revents=0;
+      slot[nPending++]=i;
+    }
+    if (nIdle>0 && (wait=retryAt-skt_clock_ms())<left) left=(wait>0)?wait:0;
+    if (nPending==0) {
+      skt_sleep_ms(left);
+      continue;
+    }
+    if (poll(fds,nPending,(int)left)<0) {
+      if (errno==EINTR) continue;
+      goto finished;
+    }
+    
+    for (i=0;i<nPending;i++) if (fds[i].revents) {
+      int k=slot[i];
+      err=skt_connect_finish(skts[k]);
+      if (err==0) {
+        state[k]=2;
+        nConnected++;
+        continue;
+      }
+      skt_close(skts[k]);
+      skts[k]=INVALID_SOCKET;
+      state[k]=0;
+      if (!skt_connect_transient(err)) goto finished;
+      if (nIdle++==0) {
+        retryAt=skt_clock_ms()+backoff;
+        if (backoff<skt_connect_backoff_max) backoff*=2;
+      }
+    }
+  }
+finished:
+  /* Anything still connecting has run out of time */
+  for (i=0;i<n;i++) if (state[i]==1) {
+    skt_close(skts[i]);
+    skts[i]=INVALID_SOCKET;
+  }
+  free(fds);
+  free(slot);
+  free(state);
+  return nConnected;
+}
+#endif
+
+int skt_idle_ok(SOCKET fd)
+{
+  /* An idle connection has nothing to read.  If it is readable,
+     either the peer hung up or it sent stray data--neither is
+     safe to hand to a new request. */
+#if defined(_WIN32) && !defined(__CYGWIN__)
+  fd_set rfds;
+  struct timeval tmo={0,0};
+  FD_ZERO(&rfds);
+  FD_SET(fd, &rfds);
+  return select(1+fd, &rfds, NULL, NULL, &tmo)==0;
+#else
+  struct pollfd pfd;
+  pfd.fd=fd;
+  pfd.events=POLLIN;
+  pfd.revents=0;
+  return poll(&pfd, 1, 0)==0;
+#endif
+}
+
 void skt_setSockBuf(SOCKET skt, int bufsize)
 {
   int len = sizeof(int);
   if (setsockopt(skt, SOL_SOCKET , SO_SNDBUF , (char *)&bufsize, len) == SOCKET_ERROR)
-	skt_abort(93496,"Error on SNDBUF sockopt for datagram socket.");
+	skt_abort(93496,"Error on SNDBUF sockopt.");
   if (setsockopt(skt, SOL_SOCKET , SO_RCVBUF , (char *)&bufsize, len) == SOCKET_ERROR)
-	skt_abort(93496,"Error on RCVBUF sockopt for datagram socket.");
+	skt_abort(93497,"Error on RCVBUF sockopt.");
+}
+
+/* TCP_CORK is Linux; BSD and Mac OS X call it TCP_NOPUSH */
+#if !defined(TCP_CORK) && defined(TCP_NOPUSH)
+#  define TCP_CORK TCP_NOPUSH
+#endif
+
+/* Table of the options in skt_options_t, in field order. 
+   Options this platform doesn't have get a level of -1. */
+typedef struct {
+  int level, name;
+  const char *msg;
+} skt_option_desc;
+
+#define skt_option_entry(level,name) {level,name,"Error on " #name " sockopt."}
+#define skt_option_missing(name) {-1,0,#name}
+static const skt_option_desc skt_option_table[]={
+  skt_option_entry(IPPROTO_TCP,TCP_NODELAY),
+#ifdef TCP_CORK
+  skt_option_entry(IPPROTO_TCP,TCP_CORK),
+#else
+  skt_option_missing(TCP_CORK),
+#endif
+#ifdef TCP_QUICKACK
+  skt_option_entry(IPPROTO_TCP,TCP_QUICKACK),
+#else
+  skt_option_missing(TCP_QUICKACK),
+#endif
+  skt_option_entry(SOL_SOCKET,SO_KEEPALIVE),
+#ifdef TCP_KEEPIDLE
+  skt_option_entry(IPPROTO_TCP,TCP_KEEPIDLE),
+#else
+  skt_option_missing(TCP_KEEPIDLE),
+#endif
+#ifdef TCP_KEEPINTVL
+  skt_option_entry(IPPROTO_TCP,TCP_KEEPINTVL),
+#else
+  skt_option_missing(TCP_KEEPINTVL),
+#endif
+#ifdef TCP_KEEPCNT
+  skt_option_entry(IPPROTO_TCP,TCP_KEEPCNT),
+#else
+  skt_option_missing(TCP_KEEPCNT),
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+  skt_option_entry(IPPROTO_TCP,TCP_NOTSENT_LOWAT),
+#else
+  skt_option_missing(TCP_NOTSENT_LOWAT),
+#endif
+  skt_option_entry(SOL_SOCKET,SO_SNDBUF),
+  skt_option_entry(SOL_SOCKET,SO_RCVBUF)
+};
+#define skt_option_count (int)(sizeof(skt_option_table)/sizeof(skt_option_table[0]))
+/* Fails to compile if the table and skt_options_t fall out of step */
+typedef char skt_option_table_check[sizeof(skt_options_t)==skt_option_count*sizeof(int)?1:-1];
+
+void skt_options_init(skt_options_t *opts)
+{
+  int *field=(int *)opts, i;
+  for (i=0;i<skt_option_count;i++) field[i]=-1;
+}
+
+int skt_set_options(SOCKET skt, const skt_options_t *opts)
+{
+  const int *field=(const int *)opts;
+  int i;
+  for (i=0;i<skt_option_count;i++) {
+    const skt_option_desc *o=&skt_option_table[i];
+    if (field[i]==-1 || o->level==-1) continue;
+    if (setsockopt(skt, o->level, o->name, (const char *)&field[i], sizeof(int)) == SOCKET_ERROR)
+      return skt_abort(93530+i,o->msg);
+  }
+  return 0;
+}
+
+int skt_get_options(SOCKET skt, skt_options_t *opts)
+{
+  int *field=(int *)opts;
+  int i;
+  for (i=0;i<skt_option_count;i++) {
+    const skt_option_desc *o=&skt_option_table[i];
+    socklen_t len=sizeof(int);
+    field[i]=-1;
+    if (o->level==-1) continue;
+    if (getsockopt(skt, o->level, o->name, (char *)&field[i], &len) == SOCKET_ERROR)
+      return skt_abort(93550+i,o->msg);
+  }
+  return 0;
+}
+
+void skt_set_nodelay(SOCKET skt, int nodelay)
+{
+  skt_options_t opts;
+  skt_options_init(&opts);
+  opts.nodelay=nodelay;
+  skt_set_options(skt,&opts);
+}
+
+void skt_set_cork(SOCKET skt, int cork)
+{
+  skt_options_t opts;
+  skt_options_init(&opts);
+  opts.cork=cork;
+  skt_set_options(skt,&opts);
 }
 
 int skt_recvN(SOCKET hSocket, void *buff, int nBytes)
@@ -505,6 +933,45 @@ int skt_sendN(SOCKET hSocket, const void *buff, int nBytes)
   return 0;
 }
 
+#if defined(__linux__)
+int skt_sendfile(SOCKET hSocket, int fd, long offset, long nBytes)
+{
+  off_t pos=offset;
+  ssize_t nWritten;
+  long nLeft=nBytes;
+  while (0 < nLeft)
+  {
+    skt_ignore_SIGPIPE=1;
+    nWritten = sendfile(hSocket,fd,&pos,nLeft);
+    skt_ignore_SIGPIPE=0;
+    if (nWritten<=0)
+    {
+      if (nWritten==0) return skt_abort(93740,"File ended before sendfile.");
+      if (skt_should_retry()) continue;/*Try again*/
+      else return skt_abort(93741,"Error on socket sendfile!");
+    }
+    nLeft -= nWritten;
+  }
+  return 0;
+}
+#else
+int skt_sendfile(SOCKET hSocket, int fd, long offset, long nBytes)
+{
+  char buf[16*1024];
+  long nLeft=nBytes;
+  if (lseek(fd,offset,SEEK_SET)<0) 
+    return skt_abort(93742,"Error seeking file for sendfile!");
+  while (0 < nLeft)
+  {
+    int ret, nRead=read(fd,buf,(nLeft<(long)sizeof(buf))?nLeft:sizeof(buf));
+    if (nRead<=0) return skt_abort(93740,"File ended before sendfile.");
+    if (0!=(ret=skt_sendN(hSocket,buf,nRead))) return ret;
+    nLeft -= nRead;
+  }
+  return 0;
+}
+#endif
+
 /*Cheezy vector send: 
   really should use writev on machines where it's available. 
 */
@@ -146,6 +146,27 @@ SERVER_SOCKET skt_server(unsigned int *port);
 */
 SERVER_SOCKET skt_server_ip(unsigned int *port,skt_ip_t *ip);
 
+/** Options for a listening server socket.  Any field set to -1
+  gets the default.
+*/
+typedef struct {
+	int backlog;      /* listen() queue length; default SOMAXCONN */
+	int defer_accept; /* TCP_DEFER_ACCEPT: only wake accept once the client
+	                     has sent data, waiting up to this many seconds; 
+	                     default off.  Only for protocols where the client 
+	                     speaks first (e.g., HTTP). */
+	int fastopen;     /* TCP_FASTOPEN: queue length for data-in-SYN 
+	                     connections; default off */
+} skt_listen_options_t;
+
+/** Set every field of these listen options to -1 (defaults). */
+void skt_listen_options_init(skt_listen_options_t *opts);
+
+/** Like skt_server_ip, but with these listen options (NULL for defaults).
+  Options the platform doesn't support are skipped.
+*/
+SERVER_SOCKET skt_server_opts(unsigned int *port,skt_ip_t *ip,const skt_listen_options_t *opts);
+
 /** Accept an incoming TCP connection request from a server socket.
 	@param server_skt A server socket created by skt_server.
 	@param client_ip Will be filled out with the incoming IP address.
@@ -154,12 +175,44 @@ SERVER_SOCKET skt_server_ip(unsigned int *port,skt_ip_t *ip);
 */
 SOCKET skt_accept(SERVER_SOCKET server_skt, skt_ip_t *client_ip, unsigned int *client_port);
 
+/** Accept every connection waiting on a non-blocking server socket,
+  up to nMax, without ever blocking.  Uses accept4 where available.
+  The accepted sockets are in normal blocking mode.
+	@param server_skt A server socket put in non-blocking mode with skt_set_blocking.
+	@param skts Filled out with the new sockets.
+	@param client_ips If not NULL, filled out with the incoming IP addresses.
+	@param client_ports If not NULL, filled out with the incoming port numbers.
+	@param return The number of sockets accepted; 0 if none were waiting.
+	  SOCKET_ERROR if out of file descriptors before any were accepted, with
+	  errno (WSAGetLastError() on Windows) set to EMFILE or ENFILE; the clients
+	  stay queued, so back off before retrying.
+*/
+int skt_accept_batch(SERVER_SOCKET server_skt, SOCKET *skts, skt_ip_t *client_ips, 
+	unsigned int *client_ports, int nMax);
+
 /** Create a TCP client socket, talking with this server.
   Initiates a TCP connection to this server IP address and port.
   Returns a new socket to communicate with that server.
 */
 SOCKET skt_connect(skt_ip_t server_ip, int server_port, int timeout);
 
+/** Like skt_connect, but the timeout is given in milliseconds.
+  The connect is non-blocking and waits for completion with poll,
+  so a refused connection (e.g., a restarting server) is retried
+  after a few milliseconds of backoff rather than a whole second.
+  The returned socket is back in normal blocking mode.
+*/
+SOCKET skt_connect_ms(skt_ip_t server_ip, int server_port, int msec);
+
+/** Open nSockets TCP connections to this server in parallel.
+  All the connects are started at once and waited on together,
+  so the handshakes overlap.  Fills out skts[0..nSockets-1] with
+  connected (blocking) sockets, or INVALID_SOCKET for any that could
+  not connect within msec milliseconds.  Never calls the abort routine.
+	@param return The number of sockets successfully connected.
+*/
+int skt_connect_parallel(skt_ip_t server_ip, int server_port, int nSockets, SOCKET *skts, int msec);
+
 /** Close this socket, finishing all communication. 
    Sockets are automatically closed at program exit. */
 void skt_close(SOCKET skt);
@@ -191,6 +244,15 @@ int skt_recvN(SOCKET skt, void *pBuff,int nBytes);
 int skt_sendV(SOCKET skt,int nBuffers,const void **buffers,int *lengths);
 
 
+/** Send nBytes of this open file, starting at offset, to this socket.
+  On Linux this uses sendfile, so the file data goes straight from
+  the page cache to the socket without being copied through user space.
+  Elsewhere it falls back to read and send.  Returns 0 on success;
+  else calls abort routine.
+*/
+int skt_sendfile(SOCKET skt,int fd,long offset,long nBytes);
+
+
 /**************** Utility Routines *******************/
 
 /**
@@ -200,6 +262,68 @@ int skt_sendV(SOCKET skt,int nBuffers,const void **buffers,int *lengths);
 */
 void skt_setSockBuf(SOCKET skt, int bufsize);
 
+/**
+   Per-socket TCP tuning options.  Any field set to -1 is left 
+   alone by skt_set_options, and skt_get_options reports -1 for
+   anything the platform doesn't support.  Leave sndbuf and rcvbuf 
+   at -1 to keep the kernel's buffer autotuning--setting either one 
+   pins that buffer at a fixed size.
+*/
+typedef struct {
+	int nodelay;       /* TCP_NODELAY: 1 disables Nagle's algorithm */
+	int cork;          /* TCP_CORK: 1 holds back partial frames until uncorked */
+	int quickack;      /* TCP_QUICKACK: 1 sends ACKs immediately (not sticky) */
+	int keepalive;     /* SO_KEEPALIVE: 1 probes idle connections */
+	int keepidle;      /* TCP_KEEPIDLE: seconds idle before the first probe */
+	int keepintvl;     /* TCP_KEEPINTVL: seconds between probes */
+	int keepcnt;       /* TCP_KEEPCNT: unanswered probes before dropping */
+	int notsent_lowat; /* TCP_NOTSENT_LOWAT: unsent bytes allowed before writable */
+	int sndbuf;        /* SO_SNDBUF: kernel send buffer bytes */
+	int rcvbuf;        /* SO_RCVBUF: kernel receive buffer bytes */
+} skt_options_t;
+
+/**
+   Set every field of these options to -1 (leave unchanged).
+*/
+void skt_options_init(skt_options_t *opts);
+
+/**
+   Apply every field of these options that isn't -1 to this socket.
+   Options the platform doesn't support are skipped.  
+   Returns 0 on success; else calls abort routine.
+*/
+int skt_set_options(SOCKET skt, const skt_options_t *opts);
+
+/**
+   Read back the effective value of every option on this socket
+   (via getsockopt).  Note the kernel may report a different buffer
+   size than was asked for.  Returns 0 on success; else calls abort routine.
+*/
+int skt_get_options(SOCKET skt, skt_options_t *opts);
+
+/**
+   Shorthand to turn Nagle's algorithm off (1) or back on (0).
+*/
+void skt_set_nodelay(SOCKET skt, int nodelay);
+
+/**
+   Shorthand to cork (1) or uncork (0) this socket.  While corked, 
+   small writes are collected into full packets; uncorking flushes.
+*/
+void skt_set_cork(SOCKET skt, int cork);
+
+/**
+   Put this socket in blocking (1) or non-blocking (0) mode.
+*/
+void skt_set_blocking(SOCKET skt, int blocking);
+
+/**
+   Check an idle connected socket before reusing it.
+      @param return 1 if the peer has not closed the connection
+      and there is no unread data waiting, else 0.
+*/
+int skt_idle_ok(SOCKET skt);
+
 /**
  Initialization routine.  This should be called automatically
  by everything that needs it.  But calling it multiple times 
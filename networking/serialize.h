@@ -0,0 +1,392 @@
+/*
+ * serialize.h
+ * Author: Aven Bross
+ * Date: 10/5/2015
+ *
+ * Description:
+ * Header only binary serialization in either byte order. Extends the
+ * Big16 and Big32 types from osl/socket.h with 64 bit and little endian
+ * counterparts, bulk byte swapping of arrays, cursors that read and write
+ * directly in caller owned send/recieve buffers, and compile time record
+ * schemas for fixed layout structs.
+*/
+
+#ifndef __SERIALIZE_H
+#define __SERIALIZE_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include "osl/socket.h"
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Byte order of serialized data
+enum class Endian { big, little };
+
+// Byte order of this machine
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const Endian hostEndian = Endian::big;
+#else
+const Endian hostEndian = Endian::little;
+#endif
+
+
+/*
+ * Scalar byte swapping
+ */
+
+inline std::uint8_t byteSwap(std::uint8_t v){ return v; }
+
+inline std::uint16_t byteSwap(std::uint16_t v){
+#if defined(__GNUC__)
+    return __builtin_bswap16(v);
+#else
+    return (std::uint16_t)((v << 8) | (v >> 8));
+#endif
+}
+
+inline std::uint32_t byteSwap(std::uint32_t v){
+#if defined(__GNUC__)
+    return __builtin_bswap32(v);
+#else
+    return (v << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+#endif
+}
+
+inline std::uint64_t byteSwap(std::uint64_t v){
+#if defined(__GNUC__)
+    return __builtin_bswap64(v);
+#else
+    return ((std::uint64_t)byteSwap((std::uint32_t)v) << 32) | byteSwap((std::uint32_t)(v >> 32));
+#endif
+}
+
+// Unsigned integer type with the same size as T
+template<std::size_t N> struct SameSizeUInt;
+template<> struct SameSizeUInt<1> { typedef std::uint8_t type; };
+template<> struct SameSizeUInt<2> { typedef std::uint16_t type; };
+template<> struct SameSizeUInt<4> { typedef std::uint32_t type; };
+template<> struct SameSizeUInt<8> { typedef std::uint64_t type; };
+
+// Store an integer or float at out in the given byte order, out need not be aligned
+template<Endian E, typename T>
+inline void storeValue(void * out, T value){
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "storeValue needs a number");
+    typedef typename SameSizeUInt<sizeof(T)>::type U;
+    U bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    if(E != hostEndian) bits = byteSwap(bits);
+    std::memcpy(out, &bits, sizeof(T));
+}
+
+// Load an integer or float stored at in with the given byte order
+template<Endian E, typename T>
+inline T loadValue(const void * in){
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "loadValue needs a number");
+    typedef typename SameSizeUInt<sizeof(T)>::type U;
+    U bits;
+    std::memcpy(&bits, in, sizeof(T));
+    if(E != hostEndian) bits = byteSwap(bits);
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+
+/*
+ * Fixed byte order integer types
+ */
+
+/*
+Integer stored in memory in a fixed byte order, regardless of the
+machine. Like Big16 and Big32, can be laid out directly in network
+structs and converts to and from a native integer.
+*/
+template<typename T, Endian E>
+class EndianInt {
+    byte d[sizeof(T)];
+public:
+    EndianInt() {}
+    EndianInt(T i) { set(i); }
+    operator T () const { return loadValue<E, T>(d); }
+    T operator=(T i) { set(i); return i; }
+    void set(T i) { storeValue<E>(d, i); }
+};
+
+// Big-endian (network byte order) 64-bit integer
+typedef EndianInt<std::uint64_t, Endian::big> Big64;
+
+// Little-endian integers
+typedef EndianInt<std::uint16_t, Endian::little> Little16;
+typedef EndianInt<std::uint32_t, Endian::little> Little32;
+typedef EndianInt<std::uint64_t, Endian::little> Little64;
+
+
+/*
+ * Bulk byte swapping
+ */
+
+// Reverse the bytes of each of n width-byte words from src into dest
+// dest may equal src to swap in place
+template<std::size_t Width>
+inline void swapWords(void * dest, const void * src, std::size_t n){
+    static_assert(Width == 2 || Width == 4 || Width == 8, "swapWords needs 2, 4 or 8 byte words");
+    typedef typename SameSizeUInt<Width>::type U;
+    byte * out = (byte *)dest;
+    const byte * in = (const byte *)src;
+    std::size_t i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    // Shuffle control reversing each word within a 16 byte lane
+    alignas(16) byte control[16];
+    for(std::size_t b=0; b<16; b++){
+        control[b] = (byte)((b / Width) * Width + (Width - 1 - b % Width));
+    }
+    __m128i mask128 = _mm_load_si128((const __m128i *)control);
+#if defined(__AVX2__)
+    __m256i mask256 = _mm256_broadcastsi128_si256(mask128);
+    for(; (i + 32/Width) <= n; i += 32/Width){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i*Width));
+        _mm256_storeu_si256((__m256i *)(out + i*Width), _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+    for(; (i + 16/Width) <= n; i += 16/Width){
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i*Width));
+        _mm_storeu_si128((__m128i *)(out + i*Width), _mm_shuffle_epi8(v, mask128));
+    }
+#endif
+
+    for(; i<n; i++){
+        U word;
+        std::memcpy(&word, in + i*Width, Width);
+        word = byteSwap(word);
+        std::memcpy(out + i*Width, &word, Width);
+    }
+}
+
+// Store n values from src at out in the given byte order
+template<Endian E, typename T>
+inline void storeArray(void * out, const T * src, std::size_t n){
+    if(E == hostEndian || sizeof(T) == 1) std::memcpy(out, src, n*sizeof(T));
+    else swapWords<sizeof(T)>(out, src, n);
+}
+
+// Load n values stored at in with the given byte order into dest
+template<Endian E, typename T>
+inline void loadArray(T * dest, const void * in, std::size_t n){
+    if(E == hostEndian || sizeof(T) == 1) std::memcpy(dest, in, n*sizeof(T));
+    else swapWords<sizeof(T)>(dest, in, n);
+}
+
+
+/*
+ * Buffer cursors
+ */
+
+// Writes values straight into a caller owned buffer, such as a send buffer
+// Running past the end sets an overflow flag instead of writing
+class ByteWriter {
+public:
+    ByteWriter(void * data, std::size_t capacity): _data((byte *)data), _capacity(capacity),
+      _size(0), _overflow(false) {}
+
+    // Append a number in the given byte order
+    template<Endian E = Endian::big, typename T>
+    ByteWriter & put(T value){
+        if(byte * out = reserve(sizeof(T))) storeValue<E>(out, value);
+        return *this;
+    }
+
+    // Append an array of numbers in the given byte order
+    template<Endian E = Endian::big, typename T>
+    ByteWriter & putArray(const T * values, std::size_t n){
+        if(byte * out = reserve(n*sizeof(T))) storeArray<E>(out, values, n);
+        return *this;
+    }
+
+    // Append raw bytes
+    ByteWriter & putBytes(const void * bytes, std::size_t n){
+        if(byte * out = reserve(n)) std::memcpy(out, bytes, n);
+        return *this;
+    }
+
+    // Claim n bytes to fill in place, returns NULL (and flags overflow) if they don't fit
+    byte * reserve(std::size_t n){
+        if(_overflow || n > _capacity - _size){
+            _overflow = true;
+            return NULL;
+        }
+        byte * out = _data + _size;
+        _size += n;
+        return out;
+    }
+
+    // Bytes written so far
+    std::size_t size() const { return _size; }
+
+    // True if everything written fit in the buffer
+    bool ok() const { return !_overflow; }
+
+private:
+    byte * _data;
+    std::size_t _capacity;
+    std::size_t _size;
+    bool _overflow;
+};
+
+// Reads values straight out of a caller owned buffer, such as a recieve buffer
+// Running past the end sets an underflow flag and reads zeros
+class ByteReader {
+public:
+    ByteReader(const void * data, std::size_t size): _data((const byte *)data), _size(size),
+      _pos(0), _underflow(false) {}
+
+    // Read a number stored in the given byte order
+    template<typename T, Endian E = Endian::big>
+    T get(){
+        const byte * in = consume(sizeof(T));
+        return in ? loadValue<E, T>(in) : T();
+    }
+
+    // Read an array of numbers stored in the given byte order
+    template<Endian E = Endian::big, typename T>
+    ByteReader & getArray(T * values, std::size_t n){
+        if(const byte * in = consume(n*sizeof(T))) loadArray<E>(values, in, n);
+        return *this;
+    }
+
+    // Read raw bytes
+    ByteReader & getBytes(void * bytes, std::size_t n){
+        if(const byte * in = consume(n)) std::memcpy(bytes, in, n);
+        return *this;
+    }
+
+    // Claim the next n bytes to read in place, returns NULL (and flags underflow) if too few are left
+    const byte * consume(std::size_t n){
+        if(_underflow || n > _size - _pos){
+            _underflow = true;
+            return NULL;
+        }
+        const byte * in = _data + _pos;
+        _pos += n;
+        return in;
+    }
+
+    // Bytes not yet read
+    std::size_t remaining() const { return _size - _pos; }
+
+    // True if every read was satisfied
+    bool ok() const { return !_underflow; }
+
+private:
+    const byte * _data;
+    std::size_t _size;
+    std::size_t _pos;
+    bool _underflow;
+};
+
+
+/*
+ * Record schemas
+ */
+
+// One numeric member of a struct C, serialized in byte order E
+template<typename C, typename M, M C::*Member, Endian E = Endian::big>
+struct Field {
+    static constexpr std::size_t size = sizeof(M);
+    static void store(byte * out, const C & record){ storeValue<E>(out, record.*Member); }
+    static void load(const byte * in, C & record){ record.*Member = loadValue<E, M>(in); }
+};
+
+// Recursively lays fields out back to back
+template<typename C, typename... Fields>
+struct FieldList;
+
+template<typename C>
+struct FieldList<C> {
+    static constexpr std::size_t size = 0;
+    static void store(byte *, const C &){}
+    static void load(const byte *, C &){}
+};
+
+template<typename C, typename F, typename... Rest>
+struct FieldList<C, F, Rest...> {
+    static constexpr std::size_t size = F::size + FieldList<C, Rest...>::size;
+    static void store(byte * out, const C & record){
+        F::store(out, record);
+        FieldList<C, Rest...>::store(out + F::size, record);
+    }
+    static void load(const byte * in, C & record){
+        F::load(in, record);
+        FieldList<C, Rest...>::load(in + F::size, record);
+    }
+};
+
+template<typename C> constexpr std::size_t FieldList<C>::size;
+template<typename C, typename F, typename... Rest> constexpr std::size_t FieldList<C, F, Rest...>::size;
+
+/*
+Compile time description of a fixed layout record. The wire size is
+a constant and every field offset is resolved at compile time, so
+encoding compiles down to a run of (byte swapped) stores. Example:
+
+    struct Tick { std::uint32_t id; double price; };
+    typedef Schema<Tick, SCHEMA_FIELD(Tick, id), SCHEMA_FIELD(Tick, price)> TickSchema;
+    byte buf[TickSchema::size];
+    TickSchema::encode(tick, buf);
+*/
+template<typename C, typename... Fields>
+struct Schema {
+    // Serialized size of one record
+    static constexpr std::size_t size = FieldList<C, Fields...>::size;
+
+    // Encode one record into size bytes at out
+    static void encode(const C & record, void * out){
+        FieldList<C, Fields...>::store((byte *)out, record);
+    }
+
+    // Decode one record from size bytes at in
+    static void decode(C & record, const void * in){
+        FieldList<C, Fields...>::load((const byte *)in, record);
+    }
+
+    // Encode n records back to back, out must hold n*size bytes
+    static void encodeArray(const C * records, std::size_t n, void * out){
+        byte * o = (byte *)out;
+        for(std::size_t i=0; i<n; i++, o += size) encode(records[i], o);
+    }
+
+    // Decode n records stored back to back
+    static void decodeArray(C * records, std::size_t n, const void * in){
+        const byte * p = (const byte *)in;
+        for(std::size_t i=0; i<n; i++, p += size) decode(records[i], p);
+    }
+
+    // Encode a record at the writer's position
+    static bool write(ByteWriter & writer, const C & record){
+        byte * out = writer.reserve(size);
+        if(out) encode(record, out);
+        return out != NULL;
+    }
+
+    // Decode a record at the reader's position
+    static bool read(ByteReader & reader, C & record){
+        const byte * in = reader.consume(size);
+        if(in) decode(record, in);
+        return in != NULL;
+    }
+};
+
+template<typename C, typename... Fields> constexpr std::size_t Schema<C, Fields...>::size;
+
+// Big-endian (network order) field of struct C
+#define SCHEMA_FIELD(C, member) Field<C, decltype(C::member), &C::member>
+
+// Little-endian field of struct C
+#define SCHEMA_FIELD_LE(C, member) Field<C, decltype(C::member), &C::member, Endian::little>
+
+#endif
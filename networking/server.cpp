@@ -26,9 +26,17 @@ static int server_skt_abort(int code,const char *msg){
 // Constructor
 Server::Server(unsigned int port): _dead(true){
     skt_set_abort(server_skt_abort);
+    skt_options_init(&_socketOptions);
     _socket = skt_server(&port);
 }
 
+// Constructor with listen options
+Server::Server(unsigned int port, const skt_listen_options_t & listenOptions): _dead(true){
+    skt_set_abort(server_skt_abort);
+    skt_options_init(&_socketOptions);
+    _socket = skt_server_opts(&port, NULL, &listenOptions);
+}
+
 // Start server loop
 void Server::start(){
     if(_dead){
@@ -43,9 +51,6 @@ void Server::stop(){
     if(!_dead){
         _dead = true;
         _thread.join();
-        std::thread temp;
-        std::swap(_thread,temp);
-        _thread.join();
         _connections.clear();
     }
 }
@@ -63,6 +68,11 @@ bool Server::isDead(){
     return _dead;
 }
 
+// Set TCP options applied to each new connection socket
+void Server::setSocketOptions(const skt_options_t & options){
+    _socketOptions = options;
+}
+
 // Destructor
 Server::~Server() {
     stop();
@@ -74,6 +84,10 @@ Server::~Server() {
  * Sublcass of server representing a TCP server
  */
 
+// Definitions for the in-class constants, which are odr-used by reference
+const int TCPServer::_acceptBatch;
+const int TCPServer::_acceptBackoff;
+
 // Creates a new connection for the given socket and address
 std::shared_ptr<TCPConnection> TCPServer::makeConnection(int socket, const sockaddr & clientAddress){
     return std::make_shared<TCPConnection>(socket, this, clientAddress);
@@ -82,19 +96,49 @@ std::shared_ptr<TCPConnection> TCPServer::makeConnection(int socket, const socka
 // Server loop to handle incoming connections
 void TCPServer::loop(){
     std::unique_lock<std::mutex> connectionLock(_mutex, std::defer_lock);
+    SOCKET sockets[_acceptBatch];
+    skt_ip_t client_ips[_acceptBatch];      // IPs & ports of other end of connections
+    unsigned int client_ports[_acceptBatch];
+    std::vector<std::shared_ptr<TCPConnection>> accepted;
+    std::vector<std::string> addresses;
+    
+    // Never block in accept, so a wakeup can drain the whole queue
+    skt_set_blocking(_socket, 0);
+    
     while(!_dead){
-        skt_ip_t client_ip;      // IP & port of other end of connection
-        unsigned int client_port;
+        // Wait for clients, waking up now and then to check if we were stopped
+        if(skt_select1(_socket, 250) != 1) continue;
         
-        int cSocket = skt_accept(_socket, &client_ip, &client_port);
-        sockaddr_in address = skt_build_addr(client_ip, client_port);
-        sockaddr client_addr = *((sockaddr *)(&address));
+        // Accept everything waiting before touching the connection list
+        int count;
+        do{
+            count = skt_accept_batch(_socket, sockets, client_ips, client_ports, _acceptBatch);
+            if(count == SOCKET_ERROR){
+                // Out of descriptors, the listener stays readable until some close
+                std::this_thread::sleep_for(std::chrono::milliseconds(_acceptBackoff));
+                break;
+            }
+            for(int i=0; i<count; i++){
+                skt_set_options(sockets[i], &_socketOptions);
+                sockaddr_in address = skt_build_addr(client_ips[i], client_ports[i]);
+                sockaddr client_addr = *((sockaddr *)(&address));
+                accepted.push_back(makeConnection(sockets[i], client_addr));
+                addresses.push_back(to_string(client_addr));
+            }
+        } while(count == _acceptBatch);
         
+        // Register the whole batch under one lock, then start them
         connectionLock.lock();
-        std::shared_ptr<TCPConnection> newCon = makeConnection(cSocket, client_addr);
-        newCon -> start();
-        _connections[to_string(client_addr)] = newCon;
+        for(std::size_t i=0; i<accepted.size(); i++){
+            _connections[addresses[i]] = accepted[i];
+        }
         connectionLock.unlock();
+        
+        for(auto & newCon : accepted){
+            newCon -> start();
+        }
+        accepted.clear();
+        addresses.clear();
     }
 }
 
@@ -160,13 +204,16 @@ std::string to_string(const sockaddr & addr){
 
 // Constructor takes ptr to message handler
 Connection::Connection(int socket, Server * server, const sockaddr & toAddress): _server(server), 
-  _socket(socket) {
+  _socket(socket), _dead(false) {
     std::memcpy(&_toAddress, &toAddress, sizeof(sockaddr));
 }
 
 // Start the connection loop
 void Connection::start(){
-    _thread = std::thread(&Connection::loop, this);
+    // The thread keeps this connection alive until its loop returns,
+    // even after kill() has dropped it from the server
+    std::shared_ptr<Connection> self = shared_from_this();
+    _thread = std::thread([self](){ self -> loop(); });
     _thread.detach();
 }
 
@@ -176,6 +223,30 @@ void Connection::kill(){
     _server -> kill(_toAddress);
 }
 
+// Send several messages with the socket corked so they leave in full packets
+bool Connection::sendBatch(const std::vector<std::string> & messages){
+    bool sent = true;
+    skt_set_cork(_socket, 1);
+    for(const std::string & message : messages){
+        if(!(sent = sendMessage(message))) break;
+    }
+    skt_set_cork(_socket, 0);   // Uncorking flushes the last partial packet
+    return sent;
+}
+
+// Apply TCP options to this connection's socket
+bool Connection::setSocketOptions(const skt_options_t & options){
+    return skt_set_options(_socket, &options) == 0;
+}
+
+// Read back the effective TCP options on this connection's socket
+skt_options_t Connection::getSocketOptions(){
+    skt_options_t options;
+    skt_options_init(&options);
+    skt_get_options(_socket, &options);
+    return options;
+}
+
 // Called on connection creation
 void Connection::onOpen(){
     // Do nothing, overload in subclasses
@@ -13,6 +13,7 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <chrono>
 #include <memory>
 #include <cstring>
 #include <iostream>
@@ -34,6 +35,9 @@ public:
     // Constructor
     Server(unsigned int port);
     
+    // Constructor with listen backlog, TCP_DEFER_ACCEPT and TCP_FASTOPEN settings
+    Server(unsigned int port, const skt_listen_options_t & listenOptions);
+    
     // Start server
     void start();
     
@@ -46,6 +50,9 @@ public:
     // Check server status
     bool isDead();
     
+    // Set TCP options applied to each new connection socket
+    void setSocketOptions(const skt_options_t & options);
+    
     // Virtual destructor
     virtual ~Server();
     
@@ -60,6 +67,7 @@ protected:
     bool _dead; // Server state
     int _socket; // Server socket
     std::mutex _mutex;  // Connection list mutex
+    skt_options_t _socketOptions;   // Options for new connection sockets
 };
 
 // Subclass of server that handles TCP connections
@@ -74,6 +82,12 @@ protected:
     
     // Make a new connection for the server
     virtual std::shared_ptr<TCPConnection> makeConnection(int socket, const sockaddr & clientAddress);
+    
+    // Most sockets accepted per accept batch
+    static const int _acceptBatch = 64;
+    
+    // Milliseconds to wait before accepting again when out of descriptors
+    static const int _acceptBackoff = 100;
 };
 
 // Subclass of server that handles UDP connections
@@ -92,7 +106,7 @@ protected:
 
 
 // Connection class representing a connection to remote host
-class Connection {
+class Connection : public std::enable_shared_from_this<Connection> {
 public:
     // Constructor takes ptr to server
     Connection(int socket, Server * server, const sockaddr & toAddress);
@@ -100,6 +114,15 @@ public:
     // Send message to connection recipient, blocks waiting for send
     virtual bool sendMessage(const std::string & message) = 0;
     
+    // Send several messages with the socket corked so they leave in full packets
+    bool sendBatch(const std::vector<std::string> & messages);
+    
+    // Apply TCP options to this connection's socket
+    bool setSocketOptions(const skt_options_t & options);
+    
+    // Read back the effective TCP options on this connection's socket
+    skt_options_t getSocketOptions();
+    
     // Start the connection loop
     void start();
     
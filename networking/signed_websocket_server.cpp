@@ -0,0 +1,148 @@
+/*
+ * signed_websocket_server.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Websocket server that only accepts messages carrying a valid Ed25519
+ * signature from the key each client registers.
+*/
+
+#include "signed_websocket_server.h"
+
+/*
+ * class SignedWebSocketServer : WebSocketServer
+ * Subclass of WebSocketServer that makes signed connections
+ */
+
+// Replace the verifier, using the given number of threads and batch size
+void SignedWebSocketServer::setVerifier(unsigned int threads, std::size_t maxBatch){
+    _verifier.reset(new BatchVerifier(threads, maxBatch));
+}
+
+// Verifier shared by every connection
+BatchVerifier & SignedWebSocketServer::verifier(){
+    return *_verifier;
+}
+
+// Make a new signed connection for the server
+std::shared_ptr<TCPConnection> SignedWebSocketServer::makeConnection(int socket, const sockaddr & clientAddress){
+    return std::make_shared<SignedWebSocketConnection>(socket, this, clientAddress);
+}
+
+
+/*
+ * class SignedWebSocketConnection : WebSocketConnection
+ * Connection class representing a signed WebSocket connection
+ */
+
+// Constructor
+SignedWebSocketConnection::SignedWebSocketConnection(int socket, Server * server, const sockaddr & toAddress):
+  WebSocketConnection(socket, server, toAddress) {}
+
+// Register the client key, then queue each message for verification
+void SignedWebSocketConnection::recieveMessage(std::string & message, bool binary){
+    SignedWebSocketServer * server = dynamic_cast<SignedWebSocketServer *>(_server);
+    if(server == nullptr){
+        fail();
+        return;
+    }
+    
+    // First message is the hex public key
+    if(_key == nullptr){
+        unsigned char key[SignatureKey::keySize];
+        try{
+            if(message.size() != 2 * SignatureKey::keySize){
+                throw std::invalid_argument("Bad key length.");
+            }
+            hexDecode(message.data(), message.size(), key);
+            _key = std::make_shared<SignatureKey>(key, sizeof(key));
+        }
+        catch(const std::invalid_argument &){
+            fail();
+            return;
+        }
+        
+        // Like the connection loop, the delivery thread keeps us alive until it returns
+        auto self = std::static_pointer_cast<SignedWebSocketConnection>(shared_from_this());
+        std::thread([self](){ self -> deliver(); }).detach();
+        return;
+    }
+    
+    if(message.size() < Ed25519Signer::signatureSize){
+        fail();
+        return;
+    }
+    
+    // Split off the signature and hold our place in line
+    std::size_t length = message.size() - Ed25519Signer::signatureSize;
+    unsigned char signature[Ed25519Signer::signatureSize];
+    std::copy(message.begin() + length, message.end(), signature);
+    message.resize(length);
+    
+    auto pending = std::make_shared<Pending>();
+    pending -> binary = binary;
+    pending -> state = 0;
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        _pending.push_back(pending);
+    }
+    
+    // Keep the connection alive until its checks come back
+    auto self = std::static_pointer_cast<SignedWebSocketConnection>(shared_from_this());
+    server -> verifier().submit(_key, std::move(message), signature, [self, pending](bool ok, std::string & checked){
+        self -> verified(pending, ok, checked);
+    });
+}
+
+// Record a result and wake the delivery thread, called on a verifier thread
+void SignedWebSocketConnection::verified(const std::shared_ptr<Pending> & pending, bool ok, std::string & message){
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        pending -> message = std::move(message);
+        pending -> state = ok ? 1 : 2;
+    }
+    _ready.notify_one();
+}
+
+// Delivery thread loop, passes finished messages at the front to onMessage in order
+void SignedWebSocketConnection::deliver(){
+    std::unique_lock<std::mutex> lock(_pendingMutex);
+    std::vector<std::shared_ptr<Pending>> ready;
+    
+    while(!_dead){
+        _ready.wait(lock, [this](){
+            return _dead || (!_pending.empty() && _pending.front() -> state != 0);
+        });
+        
+        // Take every finished message at the front, then deliver without the lock
+        while(!_pending.empty() && _pending.front() -> state != 0){
+            ready.push_back(_pending.front());
+            _pending.pop_front();
+        }
+        lock.unlock();
+        
+        for(auto & pending : ready){
+            if(_dead) return;
+            if(pending -> state == 2){
+                fail();
+                return;
+            }
+            WebSocketConnection::recieveMessage(pending -> message, pending -> binary);
+        }
+        ready.clear();
+        lock.lock();
+    }
+}
+
+// Connection failure routine, also stops the delivery thread
+void SignedWebSocketConnection::fail(){
+    WebSocketConnection::fail();
+    
+    // Taking the lock orders this after any check of _dead in the wait
+    {
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        _pending.clear();
+    }
+    _ready.notify_all();
+}
@@ -0,0 +1,75 @@
+/*
+ * signed_websocket_server.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ * 
+ * Description:
+ * Websocket server that only accepts messages carrying a valid Ed25519
+ * signature from the key each client registers.
+*/
+
+#ifndef __SIGNED_WEBSOCKET_SERVER_H
+#define __SIGNED_WEBSOCKET_SERVER_H
+
+#include "websocket_server.h"
+#include "../cryptography/signature.h"
+
+// Subclass of WebSocketServer that makes signed connections
+class SignedWebSocketServer : public WebSocketServer{
+public:
+    using WebSocketServer::WebSocketServer;
+    
+    // Replace the verifier, using the given number of threads and batch size
+    void setVerifier(unsigned int threads, std::size_t maxBatch);
+    
+    // Verifier shared by every connection
+    BatchVerifier & verifier();
+    
+protected:
+    // Make a new signed connection for the server
+    virtual std::shared_ptr<TCPConnection> makeConnection(int socket, const sockaddr & clientAddress);
+    
+    std::unique_ptr<BatchVerifier> _verifier{new BatchVerifier()};  // Signature checks for all connections
+};
+
+/*
+ * Connection class representing a signed WebSocket connection
+ *
+ * The client's first message is its Ed25519 public key in hex. Every
+ * message after that carries a 64 byte signature over the rest of the
+ * message at its end. Checks run on the server's batch verifier and
+ * results are delivered in the order the messages arrived by a delivery
+ * thread of the connection's own, never under a lock or on the verifier;
+ * the first forged message closes the connection.
+ */
+class SignedWebSocketConnection : public WebSocketConnection {
+public:
+    SignedWebSocketConnection(int socket, Server * server, const sockaddr & toAddress);
+    
+protected:
+    // Register the client key, then queue each message for verification
+    virtual void recieveMessage(std::string & message, bool binary);
+    
+    // Message waiting on its signature check
+    struct Pending {
+        std::string message;
+        bool binary;
+        int state;  // 0 waiting, 1 verified, 2 forged
+    };
+    
+    // Record a result and wake the delivery thread, called on a verifier thread
+    void verified(const std::shared_ptr<Pending> & pending, bool ok, std::string & message);
+    
+    // Delivery thread loop, passes finished messages at the front to onMessage in order
+    void deliver();
+    
+    // Connection failure routine, also stops the delivery thread
+    virtual void fail();
+    
+    std::shared_ptr<SignatureKey> _key;     // Client public key
+    std::deque<std::shared_ptr<Pending>> _pending;  // Messages in arrival order
+    std::mutex _pendingMutex;   // Guards _pending
+    std::condition_variable _ready; // Signals a finished check or a dead connection
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * static_files.cpp
+ * Author: Aven Bross
+ * Date: 9/28/2015
+ * 
+ * Description:
+ * Cache of open file descriptors for serving static files.
+*/
+
+#include "static_files.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * struct StaticFile
+ * Open file ready to be sent
+ */
+
+// Record file info and build the entity tag
+StaticFile::StaticFile(int fd, const struct stat & info, const std::string & path): fd(fd),
+  size(info.st_size), inode(info.st_ino), modified(info.st_mtime) {
+    char tag[64];
+    std::snprintf(tag, sizeof(tag), "\"%lx-%lx-%lx\"", (unsigned long)inode,
+                  (unsigned long)size, (unsigned long)modified);
+    etag = tag;
+    contentType = StaticFileCache::contentType(path);
+}
+
+// Close the descriptor
+StaticFile::~StaticFile(){
+    close(fd);
+}
+
+
+/*
+ * class StaticFileCache
+ * Cache of open static files
+ */
+
+// Constructor takes the most files to keep open
+StaticFileCache::StaticFileCache(std::size_t maxFiles): _maxFiles(maxFiles) {}
+
+// Open the given path, reusing a cached descriptor if the file is unchanged
+std::shared_ptr<StaticFile> StaticFileCache::open(const std::string & path){
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)){
+        return nullptr;
+    }
+    
+    std::unique_lock<std::mutex> fileLock(_mutex);
+    auto found = _files.find(path);
+    if(found != _files.end()){
+        const StaticFile & cached = *(found -> second);
+        if(cached.inode == info.st_ino && cached.size == info.st_size &&
+           cached.modified == info.st_mtime){
+            return found -> second;
+        }
+        _files.erase(found);    // Stale, in-flight sends keep the old fd alive
+    }
+    fileLock.unlock();
+    
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return nullptr;
+    }
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+        close(fd);
+        return nullptr;
+    }
+    auto file = std::make_shared<StaticFile>(fd, info, path);
+    
+    fileLock.lock();
+    if(_files.size() >= _maxFiles){
+        _files.erase(_files.begin());
+    }
+    _files[path] = file;
+    return file;
+}
+
+// Guess the MIME type for a path from its extension
+std::string StaticFileCache::contentType(const std::string & path){
+    static const std::unordered_map<std::string, std::string> types = {
+        {"html", "text/html"}, {"htm", "text/html"}, {"js", "application/javascript"},
+        {"css", "text/css"}, {"json", "application/json"}, {"txt", "text/plain"},
+        {"png", "image/png"}, {"jpg", "image/jpeg"}, {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"}, {"svg", "image/svg+xml"}, {"ico", "image/x-icon"},
+        {"wasm", "application/wasm"}
+    };
+    std::size_t dot = path.rfind('.');
+    if(dot != std::string::npos && path.find('/', dot) == std::string::npos){
+        auto found = types.find(path.substr(dot+1));
+        if(found != types.end()) return found -> second;
+    }
+    return "application/octet-stream";
+}
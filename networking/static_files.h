@@ -0,0 +1,52 @@
+/*
+ * static_files.h
+ * Author: Aven Bross
+ * Date: 9/28/2015
+ * 
+ * Description:
+ * Cache of open file descriptors for serving static files.
+*/
+
+#ifndef __STATIC_FILES_H
+#define __STATIC_FILES_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Open file ready to be sent, closed when the last user lets go
+struct StaticFile {
+    StaticFile(int fd, const struct stat & info, const std::string & path);
+    ~StaticFile();
+    
+    int fd;     // Open file descriptor
+    long size;  // File size in bytes
+    ino_t inode;    // Identity of the file, to notice replacements
+    time_t modified;
+    std::string etag;   // Quoted entity tag
+    std::string contentType;    // MIME type guessed from the extension
+};
+
+// Cache of open static files, revalidated with stat on each lookup
+class StaticFileCache {
+public:
+    // Constructor takes the most files to keep open
+    StaticFileCache(std::size_t maxFiles = 256);
+    
+    // Open the given path, reusing a cached descriptor if the file is unchanged
+    // Returns nullptr if the path is not a readable regular file
+    std::shared_ptr<StaticFile> open(const std::string & path);
+    
+    // Guess the MIME type for a path from its extension
+    static std::string contentType(const std::string & path);
+    
+protected:
+    std::size_t _maxFiles;
+    std::unordered_map<std::string, std::shared_ptr<StaticFile>> _files;
+    std::mutex _mutex;  // File map mutex
+};
+
+#endif
@@ -14,6 +14,24 @@
  * Subclass of TCPServer that recieves and handles websocket connections
  */
 
+// Serve plain HTTP GET requests for files under root
+void WebSocketServer::serveStatic(const std::string & root){
+    _staticRoot = root;
+    while(_staticRoot.size() > 1 && _staticRoot.back() == '/'){
+        _staticRoot.pop_back();
+    }
+}
+
+// Root directory for static files, empty if disabled
+const std::string & WebSocketServer::staticRoot() const{
+    return _staticRoot;
+}
+
+// Cache of open static files
+StaticFileCache & WebSocketServer::fileCache(){
+    return _fileCache;
+}
+
 // Make a new connection for the server
 std::shared_ptr<TCPConnection> WebSocketServer::makeConnection(int socket, const sockaddr & clientAddress){
     return std::make_shared<WebSocketConnection>(socket, this, clientAddress);
@@ -32,6 +50,11 @@ const std::string WebSocketConnection::_magicString = "258EAFA5-E914-47DA-95CA-C
 WebSocketConnection::WebSocketConnection(int socket, Server * server, const sockaddr & toAddress):
   TCPConnection(socket, server, toAddress), _handshake(false) {}                                   
  
+// Send text message via websocket protocol
+bool WebSocketConnection::sendMessage(const std::string & message){
+    return sendMessage(message, false);
+}
+
 // Send message via websocket protocol
 bool WebSocketConnection::sendMessage(const std::string & message, bool binary){
     if(!_handshake){
@@ -115,6 +138,7 @@ void WebSocketConnection::loop(){
 	            }
 	            else{
 	                _handshake = parseHandshake(buffer);
+	                buffer.clear(); // Ready for the next request
 	            }
             }
             else{
@@ -211,13 +235,11 @@ void WebSocketConnection::loop(){
             if(fin){
                 if(opcode == 0x1 || (opcode == 0x0 && binary == false)){
                     // Text message
-                    onMessage(message);
-                    sendMessage(message);
+                    recieveMessage(message, false);
                 }
                 else if(opcode == 0x2 || (opcode == 0x0 && binary == true)){
                     // Binary message
-                    onMessage(message);
-                    sendMessage(message);
+                    recieveMessage(message, true);
                 }
                 else if(opcode == 0x8){
                     fail();
@@ -264,6 +286,12 @@ void WebSocketConnection::loop(){
     }
 }
 
+// Handle a complete message from the client
+void WebSocketConnection::recieveMessage(std::string & message, bool binary){
+    onMessage(message);
+    sendMessage(message);
+}
+
 // Parse handshake and respond if correct
 bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer){
     // Create error HTTP response
@@ -271,7 +299,8 @@ bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer
     error.append("\n\n");
     
     // Check HTTP header is correct
-    if(buffer[0].compare("GET") || buffer[1].compare("/") || buffer[2].compare("HTTP/1.1")){
+    if(buffer.size() < 3 || buffer[0].compare("GET") ||
+       (buffer[2].compare("HTTP/1.1") && buffer[2].compare("HTTP/1.0"))){
         sendTCP(error);
         return false;
     }
@@ -289,6 +318,24 @@ bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer
         }
     }
     
+    // Plain GET requests (no upgrade) are served as static files if enabled
+    if(attributes.count("Upgrade") < 1){
+        WebSocketServer * server = dynamic_cast<WebSocketServer *>(_server);
+        if(server != NULL && server -> staticRoot().size() > 0){
+            serveFile(buffer[1], attributes);
+        }
+        else{
+            sendTCP(error);
+        }
+        return false;
+    }
+    
+    // Websocket requests must be for the root and HTTP/1.1
+    if(buffer[1].compare("/") || buffer[2].compare("HTTP/1.1")){
+        sendTCP(error);
+        return false;
+    }
+    
     // Check if client sent a key
     if(attributes.count("Sec-WebSocket-Key") < 1){
         sendTCP(error);
@@ -296,7 +343,11 @@ bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer
     }
     
     // Compute server accept key from client key
-    std::string key = base64Encode(sha1(attributes["Sec-WebSocket-Key"].front() + _magicString));
+    std::string clientKey = attributes["Sec-WebSocket-Key"].front() + _magicString;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    sha1(clientKey.data(), clientKey.size(), digest);
+    char key[base64EncodedSize(SHA_DIGEST_LENGTH)];
+    base64Encode(digest, SHA_DIGEST_LENGTH, key);
     
     // Make sure client attributes are correct
     if(attributes["Sec-WebSocket-Version"].front().compare("13") ||
@@ -309,7 +360,7 @@ bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer
     // Generate server response
     std::string response("HTTP/1.1 101 Switching Protocols\nUpgrade: websocket\nConnection: Upgrade\n");
     response.append("Connection: Upgrade\nSec-WebSocket-Accept: ");
-    response.append(key);
+    response.append(key, sizeof(key));
     response.append("\n\n");
     sendTCP(response);
     
@@ -319,18 +370,114 @@ bool WebSocketConnection::parseHandshake(const std::vector<std::string> & buffer
     return true;
 }
 
-// Send a websocket frame with the given parameters
-// Must be called with payload.size() <= USHRT_MAX
-bool WebSocketConnection::sendFrame(bool fin, unsigned char opcode, const std::string & payload){
-    std::string frame = "";
+// Send a static file in response to a plain HTTP GET request
+bool WebSocketConnection::serveFile(const std::string & target,
+                                    std::map<std::string, std::vector<std::string>> & attributes){
+    WebSocketServer * server = dynamic_cast<WebSocketServer *>(_server);
+    
+    // Drop any query string, refuse anything that could climb out of the root
+    std::string path = target.substr(0, target.find('?'));
+    if(path.size() == 0 || path[0] != '/' || path.find("..") != std::string::npos){
+        return sendStatus("400 Bad Request");
+    }
+    if(path.back() == '/'){
+        path.append("index.html");
+    }
+    
+    std::shared_ptr<StaticFile> file = server -> fileCache().open(server -> staticRoot() + path);
+    if(!file){
+        return sendStatus("404 Not Found");
+    }
+    
+    // Client already has this version
+    if(attributes.count("If-None-Match") > 0){
+        for(const std::string & tag : attributes["If-None-Match"]){
+            if(!tag.compare(file -> etag) || !tag.compare(file -> etag + ",") || !tag.compare("*")){
+                return sendStatus("304 Not Modified", "ETag: " + file -> etag + "\r\n");
+            }
+        }
+    }
+    
+    // Work out which bytes were asked for
+    long first = 0, last = file -> size - 1;
+    bool partial = false;
+    if(attributes.count("Range") > 0){
+        partial = true;
+        if(!parseRange(attributes["Range"].front(), file -> size, first, last)){
+            return sendStatus("416 Range Not Satisfiable",
+                              "Content-Range: bytes */" + std::to_string(file -> size) + "\r\n");
+        }
+    }
+    long length = (file -> size > 0) ? last - first + 1 : 0;
+    
+    std::string response(partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n");
+    response.append("Content-Type: " + file -> contentType + "\r\n");
+    response.append("Content-Length: " + std::to_string(length) + "\r\n");
+    response.append("Accept-Ranges: bytes\r\nETag: " + file -> etag + "\r\n");
+    if(partial){
+        response.append("Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) +
+                        "/" + std::to_string(file -> size) + "\r\n");
+    }
+    response.append("\r\n");
+    
+    // Cork so the headers and first file bytes share packets, the body never leaves the kernel
+    skt_set_cork(_socket, 1);
+    bool sent = sendTCP(response);
+    if(sent && length > 0 && skt_sendfile(_socket, file -> fd, first, length) != 0){
+        fail();
+        sent = false;
+    }
+    skt_set_cork(_socket, 0);
+    return sent;
+}
+
+// Parse a single "bytes=first-last" range against a file size
+bool WebSocketConnection::parseRange(const std::string & range, long size, long & first, long & last){
+    if(range.compare(0, 6, "bytes=") || range.find(',') != std::string::npos){
+        return false;
+    }
+    std::size_t dash = range.find('-', 6);
+    if(dash == std::string::npos){
+        return false;
+    }
+    std::string from = range.substr(6, dash-6), to = range.substr(dash+1);
+    char * end;
+    if(from.size() == 0){
+        // Suffix range: the last n bytes
+        long n = std::strtol(to.c_str(), &end, 10);
+        if(to.size() == 0 || *end != '\0' || n <= 0) return false;
+        first = (n < size) ? size - n : 0;
+        last = size - 1;
+    }
+    else{
+        first = std::strtol(from.c_str(), &end, 10);
+        if(*end != '\0' || first < 0) return false;
+        last = size - 1;
+        if(to.size() > 0){
+            long requested = std::strtol(to.c_str(), &end, 10);
+            if(*end != '\0' || requested < first) return false;
+            if(requested < last) last = requested;
+        }
+    }
+    return first < size;
+}
+
+// Send a bodiless HTTP response with the given status and extra headers
+bool WebSocketConnection::sendStatus(const std::string & status, const std::string & headers){
+    return sendTCP("HTTP/1.1 " + status + "\r\n" + headers + "Content-Length: 0\r\n\r\n");
+}
+
+// Append a websocket frame header for a payload of the given length
+// Must be called with length <= USHRT_MAX
+void WebSocketConnection::appendFrameHeader(std::string & frame, bool fin, unsigned char opcode, std::size_t length){
     char byte;
     
     byte = fin ? (0x80) : (0x00);   // Set fin bit
     byte = byte | opcode;   // Set opcode as provided
     frame.push_back(byte);
     
-    if(payload.size() < 125){
-        byte = (char)payload.size(); //
+    if(length < 125){
+        byte = (char)length; //
         byte = byte & 0x7F; // Make sure mask bit is not set
         frame.push_back(byte);
     }
@@ -340,14 +487,21 @@ bool WebSocketConnection::sendFrame(bool fin, unsigned char opcode, const std::s
         frame.push_back(byte);
         
         // Append second byte of payload length
-        byte = (char)(payload.size() >> 8);
+        byte = (char)(length >> 8);
         frame.push_back(byte);
         
         // Append first byte of payload length
-        byte = (char)payload.size();
+        byte = (char)length;
         frame.push_back(byte);
     }
-    
+}
+
+// Send a websocket frame with the given parameters
+// Must be called with payload.size() <= USHRT_MAX
+bool WebSocketConnection::sendFrame(bool fin, unsigned char opcode, const std::string & payload){
+    std::string frame = "";
+    frame.reserve(4 + payload.size());
+    appendFrameHeader(frame, fin, opcode, payload.size());
     frame.append(payload);
     
     return sendTCP(frame);
@@ -14,7 +14,9 @@
 #include <openssl/bio.h>
 #include <openssl/evp.h>
 #include <climits>
+#include <cstdlib>
 #include "server.h"
+#include "static_files.h"
 #include "../cryptography/crypto.h"
 
 // Subclass of TCPServer that recieves and handles websocket connections
@@ -22,7 +24,19 @@ class WebSocketServer : public TCPServer{
 public:
     using TCPServer::TCPServer;
     
+    // Serve plain HTTP GET requests for files under root
+    void serveStatic(const std::string & root);
+    
+    // Root directory for static files, empty if disabled
+    const std::string & staticRoot() const;
+    
+    // Cache of open static files
+    StaticFileCache & fileCache();
+    
 protected:
+    std::string _staticRoot;    // Static file root directory
+    StaticFileCache _fileCache; // Open static files
+    
     // Make a new UDP connection for the server
     virtual std::shared_ptr<TCPConnection> makeConnection(int socket, const sockaddr & clientAddress);
 };
@@ -32,8 +46,11 @@ class WebSocketConnection : public TCPConnection {
 public:
     WebSocketConnection(int socket, Server * server, const sockaddr & toAddress);
 
+    // Send text message via websocket protocol
+    virtual bool sendMessage(const std::string & message);
+    
     // Send message via websocket protocol
-    virtual bool sendMessage(const std::string & message, bool binary = false);
+    virtual bool sendMessage(const std::string & message, bool binary);
     
 protected:
     // Handle websocket message from client
@@ -42,6 +59,21 @@ protected:
     // Parse handshake and respond if correct
     bool parseHandshake(const std::vector<std::string> & buffer);
     
+    // Send a static file in response to a plain HTTP GET request
+    bool serveFile(const std::string & target, std::map<std::string, std::vector<std::string>> & attributes);
+    
+    // Parse a single "bytes=first-last" range against a file size
+    static bool parseRange(const std::string & range, long size, long & first, long & last);
+    
+    // Send a bodiless HTTP response with the given status and extra headers
+    bool sendStatus(const std::string & status, const std::string & headers = "");
+    
+    // Handle a complete message from the client
+    virtual void recieveMessage(std::string & message, bool binary);
+    
+    // Append a websocket frame header for a payload of the given length
+    static void appendFrameHeader(std::string & frame, bool fin, unsigned char opcode, std::size_t length);
+    
     // Sends a websocket frame
     bool sendFrame(bool fin, unsigned char opcode, const std::string & payload);
     
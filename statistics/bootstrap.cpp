@@ -0,0 +1,149 @@
+/*
+ * bootstrap.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Parallel bootstrap of any statistic over a range of values. Replicates
+ * are drawn as per value weights rather than copies, each from its own
+ * counter-based random stream, so a seed gives the same intervals on any
+ * number of threads.
+*/
+
+#ifndef BOOTSTRAP_CPP
+#define BOOTSTRAP_CPP
+
+#include "bootstrap.h"
+
+/*
+ * Statistics
+ */
+
+// Percentile interval holding the middle confidence of the replicates
+inline std::pair<double, double> BootstrapResult::interval(double confidence) const {
+    if(replicates.empty()) return std::make_pair(estimate, estimate);
+    std::vector<double> sorted(replicates);
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&](double p){
+        double position = p * (sorted.size() - 1);
+        std::size_t index = (std::size_t)position;
+        if(index + 1 >= sorted.size()) return sorted.back();
+        return sorted[index] + (position - index) * (sorted[index + 1] - sorted[index]);
+    };
+    return std::make_pair(at((1 - confidence) / 2), at((1 + confidence) / 2));
+}
+
+// Weighted mean
+template<typename Iterator>
+double WeightedMean::operator()(Iterator first, Iterator last, const std::uint32_t * weights) const {
+    double sum = 0;
+    std::uint64_t total = 0;
+    for(; first != last; ++first, ++weights){
+        sum += *weights * (double)*first;
+        total += *weights;
+    }
+    return sum / total;
+}
+
+// Weighted quantile of a sorted range
+template<typename Iterator>
+double WeightedQuantile::operator()(Iterator first, Iterator last, const std::uint32_t * weights) const {
+    std::uint64_t total = 0;
+    for(std::size_t i=0, n=last-first; i<n; i++){
+        total += weights[i];
+    }
+
+    // Rank position in the sorted resample and the order statistics either side
+    double position = q * (total - 1);
+    std::uint64_t rank = (std::uint64_t)position;
+    double fraction = position - rank;
+
+    std::uint64_t seen = 0;
+    while(seen + *weights <= rank){
+        seen += *weights++;
+        ++first;
+    }
+    double low = *first;
+    if(fraction == 0 || seen + *weights > rank + 1) return low;
+    do{
+        ++weights;
+        ++first;
+    }while(*weights == 0);
+    return low + fraction * (*first - low);
+}
+
+/*
+ * Resampling
+ */
+
+// Bootstrap statistic over a random access range with replicates resamples
+// Replicate b always draws from stream b, whichever thread runs it
+template<typename Iterator, typename Statistic>
+BootstrapResult bootstrap(Iterator first, Iterator last, Statistic statistic, std::size_t replicates,
+                          std::uint64_t seed, unsigned int threads){
+    std::size_t size = last - first;
+    BootstrapResult result;
+    if(size == 0) return result;
+
+    std::vector<std::uint32_t> ones(size, 1);
+    result.estimate = statistic(first, last, ones.data());
+    result.replicates.resize(replicates);
+
+    if(threads == 0) threads = 1;
+    if(threads > replicates) threads = replicates > 0 ? replicates : 1;
+    auto work = [&](unsigned int id){
+        std::vector<std::uint32_t> weights(size);
+        std::size_t begin = replicates * id / threads, end = replicates * (id + 1) / threads;
+        for(std::size_t b=begin; b<end; b++){
+            CounterRandom random(seed, b);
+            std::fill(weights.begin(), weights.end(), 0);
+            for(std::size_t i=0; i<size; i++){
+                weights[random.below(size)]++;
+            }
+            
+            // A fresh copy per replicate, so scratch a statistic keeps is
+            // never shared between threads and never carries between replicates
+            Statistic local = statistic;
+            result.replicates[b] = local(first, last, (const std::uint32_t *)weights.data());
+        }
+    };
+    std::vector<std::thread> pool;
+    for(unsigned int id=1; id<threads; id++){
+        pool.emplace_back(work, id);
+    }
+    work(0);
+    for(auto & thread : pool){
+        thread.join();
+    }
+
+    // Summaries in replicate order so they match bit for bit across thread counts
+    for(double value : result.replicates){
+        result.mean += value;
+    }
+    if(replicates > 0) result.mean /= replicates;
+    double squares = 0;
+    for(double value : result.replicates){
+        squares += (value - result.mean) * (value - result.mean);
+    }
+    if(replicates > 1) result.standardError = std::sqrt(squares / (replicates - 1));
+    result.bias = result.mean - result.estimate;
+    return result;
+}
+
+// Bootstrap the mean of a random access range
+template<typename Iterator>
+BootstrapResult bootstrapMean(Iterator first, Iterator last, std::size_t replicates,
+                              std::uint64_t seed, unsigned int threads){
+    return bootstrap(first, last, WeightedMean(), replicates, seed, threads);
+}
+
+// Bootstrap quantile q of a range, sorting one copy of the values up front
+template<typename Iterator>
+BootstrapResult bootstrapQuantile(Iterator first, Iterator last, double q, std::size_t replicates,
+                                  std::uint64_t seed, unsigned int threads){
+    std::vector<typename std::iterator_traits<Iterator>::value_type> sorted(first, last);
+    std::sort(sorted.begin(), sorted.end());
+    return bootstrap(sorted.begin(), sorted.end(), WeightedQuantile{q}, replicates, seed, threads);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * bootstrap.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Parallel bootstrap of any statistic over a range of values. Replicates
+ * are drawn as per value weights rather than copies, each from its own
+ * counter-based random stream, so a seed gives the same intervals on any
+ * number of threads.
+*/
+
+#ifndef BOOTSTRAP_H
+#define BOOTSTRAP_H
+
+#include <vector>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#include "random.h"
+
+// Bootstrap distribution of a statistic
+struct BootstrapResult {
+    double estimate = 0;                // Statistic of the original values
+    std::vector<double> replicates;     // Statistic of each resample, in replicate order
+    double mean = 0;                    // Mean of the replicates
+    double standardError = 0;           // Standard deviation of the replicates
+    double bias = 0;                    // mean - estimate
+
+    // Percentile interval holding the middle confidence of the replicates
+    std::pair<double, double> interval(double confidence = 0.95) const;
+};
+
+// Weighted mean, the statistic behind bootstrapMean
+struct WeightedMean {
+    template<typename Iterator>
+    double operator()(Iterator first, Iterator last, const std::uint32_t * weights) const;
+};
+
+// Weighted quantile of a sorted range, the statistic behind bootstrapQuantile
+// Interpolates between order statistics of the resample like the unweighted one
+struct WeightedQuantile {
+    double q;
+
+    template<typename Iterator>
+    double operator()(Iterator first, Iterator last, const std::uint32_t * weights) const;
+};
+
+// Bootstrap statistic over a random access range with replicates resamples
+// statistic(first, last, weights) sees how many times each value was drawn
+// into the resample, every weight is 1 for the original estimate
+// Each replicate calls its own copy of statistic, so one that keeps scratch
+// state is safe and still gives the same intervals on any number of threads
+template<typename Iterator, typename Statistic>
+BootstrapResult bootstrap(Iterator first, Iterator last, Statistic statistic, std::size_t replicates = 1000,
+                          std::uint64_t seed = 0, unsigned int threads = std::thread::hardware_concurrency());
+
+// Bootstrap the mean of a random access range
+template<typename Iterator>
+BootstrapResult bootstrapMean(Iterator first, Iterator last, std::size_t replicates = 1000,
+                              std::uint64_t seed = 0, unsigned int threads = std::thread::hardware_concurrency());
+
+// Bootstrap quantile q of a range, sorting one copy of the values up front
+template<typename Iterator>
+BootstrapResult bootstrapQuantile(Iterator first, Iterator last, double q, std::size_t replicates = 1000,
+                                  std::uint64_t seed = 0, unsigned int threads = std::thread::hardware_concurrency());
+
+#include "bootstrap.cpp"
+
+#endif
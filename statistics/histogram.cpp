@@ -0,0 +1,352 @@
+/*
+ * histogram.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Histogram backends for the stats library, a dense counting array for
+ * small integer ranges and a log-linear HDR histogram for wide ranges.
+*/
+
+#ifndef HISTOGRAM_CPP
+#define HISTOGRAM_CPP
+
+#include "histogram.h"
+
+/*
+ * class DenseHistogram
+ * Exact counts of integer values in one array bin per value
+ */
+
+// Start empty
+template<typename T>
+DenseHistogram<T>::DenseHistogram(): _low(0), _bins(0){}
+
+// Count one value
+template<typename T>
+void DenseHistogram<T>::add(const T & value){
+    long long v = (long long)value;
+    if(outside(v)){
+        grow(v, v);
+    }
+    _counts[(v - _low) * lanes] += 1;
+}
+
+// Count every value in a range, finding each block's extremes first so the
+// counting loop never checks the range
+template<typename T>
+template<typename Iterator>
+void DenseHistogram<T>::add(Iterator first, Iterator last){
+    long long values[block];
+    while(first != last){
+        std::size_t n = 0;
+        for(; n < block && first != last; ++n, ++first){
+            values[n] = (long long)*first;
+        }
+
+        long long low = values[0], high = values[0];
+        for(std::size_t i=1; i<n; i++){
+            low = std::min(low, values[i]);
+            high = std::max(high, values[i]);
+        }
+        if(outside(low) || outside(high)){
+            grow(low, high);
+        }
+
+        std::size_t * counts = _counts.data();
+        std::size_t i = 0;
+        for(; i + lanes <= n; i += lanes){
+            counts[(values[i] - _low) * lanes] += 1;
+            counts[(values[i+1] - _low) * lanes + 1] += 1;
+            counts[(values[i+2] - _low) * lanes + 2] += 1;
+            counts[(values[i+3] - _low) * lanes + 3] += 1;
+        }
+        for(; i < n; i++){
+            counts[(values[i] - _low) * lanes] += 1;
+        }
+    }
+}
+
+// Add the counts of another histogram
+template<typename T>
+void DenseHistogram<T>::merge(const DenseHistogram & other){
+    if(other._bins == 0){
+        return;
+    }
+    grow(other._low, other._low + (long long)other._bins - 1);
+    std::size_t start = (other._low - _low) * lanes;
+    for(std::size_t i=0; i<other._counts.size(); i++){
+        _counts[start + i] += other._counts[i];
+    }
+}
+
+// Number of times value was counted
+template<typename T>
+std::size_t DenseHistogram<T>::count(const T & value) const{
+    long long v = (long long)value;
+    if(outside(v)){
+        return 0;
+    }
+    std::size_t sum = 0;
+    for(std::size_t lane=0; lane<lanes; lane++){
+        sum += _counts[(v - _low) * lanes + lane];
+    }
+    return sum;
+}
+
+// Number of values counted
+template<typename T>
+std::size_t DenseHistogram<T>::total() const{
+    std::size_t sum = 0;
+    for(auto count : _counts){
+        sum += count;
+    }
+    return sum;
+}
+
+// Call f(value, count) for every counted value in increasing order
+template<typename T>
+template<typename Function>
+void DenseHistogram<T>::forEach(Function f) const{
+    for(std::size_t bin=0; bin<_bins; bin++){
+        std::size_t sum = 0;
+        for(std::size_t lane=0; lane<lanes; lane++){
+            sum += _counts[bin * lanes + lane];
+        }
+        if(sum > 0){
+            f((T)(_low + (long long)bin), sum);
+        }
+    }
+}
+
+// Forget every count, keeping the range
+template<typename T>
+void DenseHistogram<T>::clear(){
+    std::fill(_counts.begin(), _counts.end(), 0);
+}
+
+// Widen the range to cover low to high, at least doubling it so growth is
+// amortized, as long as that stays within denseHistogramMaxBins
+template<typename T>
+void DenseHistogram<T>::grow(long long low, long long high){
+    if(_bins == 0){
+        _bins = span(low, high);
+        _low = low;
+        _counts.assign(_bins * lanes, 0);
+        return;
+    }
+    long long oldHigh = _low + (long long)(_bins - 1);
+    long long newLow = std::min(low, _low), newHigh = std::max(high, oldHigh);
+    if(newLow == _low && newHigh == oldHigh){
+        return;
+    }
+
+    // Pad each side that moved, never past the limit or the ends of long long
+    long long extra = (long long)std::min(_bins, (denseHistogramMaxBins - span(newLow, newHigh)) / 2);
+    if(newLow < _low && newLow >= std::numeric_limits<long long>::min() + extra){
+        newLow = std::min(newLow, _low - extra);
+    }
+    if(newHigh > oldHigh && newHigh <= std::numeric_limits<long long>::max() - extra){
+        newHigh = std::max(newHigh, oldHigh + extra);
+    }
+
+    std::size_t bins = span(newLow, newHigh);
+    std::vector<std::size_t> counts(bins * lanes, 0);
+    std::copy(_counts.begin(), _counts.end(), counts.begin() + (_low - newLow) * lanes);
+    _counts.swap(counts);
+    _low = newLow;
+    _bins = bins;
+}
+
+// Whether value is outside the current range, one unsigned compare covers both
+// ends without forming _low + _bins
+template<typename T>
+bool DenseHistogram<T>::outside(long long value) const{
+    return (unsigned long long)value - (unsigned long long)_low >= _bins;
+}
+
+// Number of bins from low to high, throws past denseHistogramMaxBins
+template<typename T>
+std::size_t DenseHistogram<T>::span(long long low, long long high){
+    unsigned long long bins = (unsigned long long)high - (unsigned long long)low + 1;
+    if(bins == 0 || bins > denseHistogramMaxBins){
+        throw std::length_error("Dense histogram range is too wide, use a map or an HDR histogram.");
+    }
+    return bins;
+}
+
+/*
+ * class HDRHistogram
+ * Log-linear histogram with fixed memory
+ */
+
+// Keep precision significant bits of value / unit
+template<typename T>
+HDRHistogram<T>::HDRHistogram(unsigned int precision, double unit): _precision(precision), _unit(unit){
+    if(precision < 1 || precision > 20 || !(unit > 0)){
+        throw std::invalid_argument("HDR histogram needs 1 to 20 bits of precision and a positive unit.");
+    }
+    // Values below 2^precision get a bucket each, every higher power of two
+    // is split into 2^(precision-1) buckets
+    _counts.assign((66 - precision) << (precision - 1), 0);
+}
+
+// Count one value
+template<typename T>
+void HDRHistogram<T>::add(const T & value){
+    _counts[index(units(value))] += 1;
+}
+
+// Count every value in a range
+template<typename T>
+template<typename Iterator>
+void HDRHistogram<T>::add(Iterator first, Iterator last){
+    for(; first != last; ++first){
+        _counts[index(units(*first))] += 1;
+    }
+}
+
+// Add the counts of a histogram with the same precision and unit
+template<typename T>
+void HDRHistogram<T>::merge(const HDRHistogram & other){
+    if(other._precision != _precision || other._unit != _unit){
+        throw std::invalid_argument("Merged HDR histograms must share precision and unit.");
+    }
+    for(std::size_t i=0; i<_counts.size(); i++){
+        _counts[i] += other._counts[i];
+    }
+}
+
+// Number of values counted in value's bucket
+template<typename T>
+std::size_t HDRHistogram<T>::count(const T & value) const{
+    return _counts[index(units(value))];
+}
+
+// Number of values counted
+template<typename T>
+std::size_t HDRHistogram<T>::total() const{
+    std::size_t sum = 0;
+    for(auto count : _counts){
+        sum += count;
+    }
+    return sum;
+}
+
+// Lowest value that shares value's bucket
+template<typename T>
+T HDRHistogram<T>::lowest(const T & value) const{
+    return (T)(bottom(index(units(value))) * _unit);
+}
+
+// Call f(lowest value, count) for every non-empty bucket in increasing order
+template<typename T>
+template<typename Function>
+void HDRHistogram<T>::forEach(Function f) const{
+    for(std::size_t i=0; i<_counts.size(); i++){
+        if(_counts[i] > 0){
+            f((T)(bottom(i) * _unit), _counts[i]);
+        }
+    }
+}
+
+// Forget every count
+template<typename T>
+void HDRHistogram<T>::clear(){
+    std::fill(_counts.begin(), _counts.end(), 0);
+}
+
+// Bucket of a value in units, the top precision bits pick the bucket within its power of two
+template<typename T>
+std::size_t HDRHistogram<T>::index(unsigned long long units) const{
+    std::size_t half = std::size_t(1) << (_precision - 1);
+    if(units < (half << 1)){
+        return units;
+    }
+    unsigned int shift = 64 - __builtin_clzll(units) - _precision;
+    return shift * half + (units >> shift);
+}
+
+// Value in units at the bottom of a bucket
+template<typename T>
+unsigned long long HDRHistogram<T>::bottom(std::size_t index) const{
+    std::size_t half = std::size_t(1) << (_precision - 1);
+    if(index < (half << 1)){
+        return index;
+    }
+    unsigned int shift = index / half - 1;
+    return (unsigned long long)(index - shift * half) << shift;
+}
+
+// Value in units, clamped to the trackable range
+template<typename T>
+unsigned long long HDRHistogram<T>::units(const T & value) const{
+    double scaled = (double)value / _unit;
+    if(!(scaled > 0)) return 0;
+    if(scaled >= 18446744073709551615.0) return ~0ULL;
+    return (unsigned long long)scaled;
+}
+
+/*
+ * Generic histogram helpers
+ * std::map keeps working as a histogram next to the backends above
+ */
+
+// Count every value in a range into a histogram
+template<typename Histogram, typename Iterator>
+void addToHistogram(Histogram & histogram, Iterator first, Iterator last){
+    histogram.add(first, last);
+}
+
+// Count one value into a histogram
+template<typename Histogram, typename Value>
+void addToHistogram(Histogram & histogram, const Value & value){
+    histogram.add(value);
+}
+
+// Count one value into a map
+template<typename T, typename Value>
+void addToHistogram(std::map<T,std::size_t> & histogram, const Value & value){
+    histogram[value] += 1;
+}
+
+// Count every value in a range into a map
+template<typename T, typename Iterator>
+void addToHistogram(std::map<T,std::size_t> & histogram, Iterator first, Iterator last){
+    for(; first != last; ++first){
+        histogram[*first] += 1;
+    }
+}
+
+// Add the counts of one histogram into another
+template<typename Histogram>
+void mergeHistogram(Histogram & into, const Histogram & from){
+    into.merge(from);
+}
+
+// Add the counts of one map into another
+template<typename T>
+void mergeHistogram(std::map<T,std::size_t> & into, const std::map<T,std::size_t> & from){
+    auto hint = into.begin();
+    for(const auto & cat : from){
+        hint = into.emplace_hint(hint, cat.first, 0);
+        hint->second += cat.second;
+    }
+}
+
+// Call f(value, count) for every bin of a histogram in increasing order
+template<typename Histogram, typename Function>
+void forEachBin(const Histogram & histogram, Function f){
+    histogram.forEach(f);
+}
+
+// Call f(value, count) for every entry of a map in increasing order
+template<typename T, typename Function>
+void forEachBin(const std::map<T,std::size_t> & histogram, Function f){
+    for(const auto & cat : histogram){
+        f(cat.first, cat.second);
+    }
+}
+
+
+#endif
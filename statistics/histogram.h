@@ -0,0 +1,163 @@
+/*
+ * histogram.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Histogram backends for the stats library, a dense counting array for
+ * small integer ranges and a log-linear HDR histogram for wide ranges.
+ * The stats functions count into an exact std::map unless given one of these.
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+#include <map>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstddef>
+
+// Widest range of values a DenseHistogram will cover
+const std::size_t denseHistogramMaxBins = 1 << 20;
+
+// Exact counts of integer values in one array bin per value
+// The range grows to cover whatever is added, so keep it to small ranges
+// Throws std::length_error if it would need more than denseHistogramMaxBins bins
+template<typename T>
+class DenseHistogram {
+public:
+    // Start empty
+    DenseHistogram();
+
+    // Count one value
+    void add(const T & value);
+
+    // Count every value in a range, a block at a time
+    template<typename Iterator>
+    void add(Iterator first, Iterator last);
+
+    // Add the counts of another histogram
+    void merge(const DenseHistogram & other);
+
+    // Number of times value was counted
+    std::size_t count(const T & value) const;
+
+    // Number of values counted
+    std::size_t total() const;
+
+    // Call f(value, count) for every counted value in increasing order
+    template<typename Function>
+    void forEach(Function f) const;
+
+    // Forget every count, keeping the range
+    void clear();
+
+protected:
+    // Each bin has lanes counters and consecutive values in a block go to
+    // different lanes, so repeated values do not wait on each other's stores
+    static const std::size_t lanes = 4;
+    static const std::size_t block = 256;
+
+    // Widen the range to cover low to high
+    void grow(long long low, long long high);
+
+    // Whether value is outside the current range, safe at the ends of long long
+    bool outside(long long value) const;
+
+    // Number of bins from low to high, throws past denseHistogramMaxBins
+    static std::size_t span(long long low, long long high);
+
+    long long _low;         // Value of the first bin
+    std::size_t _bins;      // Number of bins
+    std::vector<std::size_t> _counts;   // lanes counters per bin, bin major
+};
+
+// Log-linear histogram with fixed memory, HdrHistogram style
+// Values are measured in multiples of unit and kept to precision significant
+// bits, so each bucket is within 2^(1-precision) of the values in it
+// Negative values are counted as 0
+template<typename T>
+class HDRHistogram {
+public:
+    // Keep precision significant bits of value / unit, precision is 1 to 20
+    HDRHistogram(unsigned int precision = 7, double unit = 1);
+
+    // Count one value
+    void add(const T & value);
+
+    // Count every value in a range
+    template<typename Iterator>
+    void add(Iterator first, Iterator last);
+
+    // Add the counts of a histogram with the same precision and unit
+    void merge(const HDRHistogram & other);
+
+    // Number of values counted in value's bucket
+    std::size_t count(const T & value) const;
+
+    // Number of values counted
+    std::size_t total() const;
+
+    // Lowest value that shares value's bucket
+    T lowest(const T & value) const;
+
+    // Call f(lowest value, count) for every non-empty bucket in increasing order
+    template<typename Function>
+    void forEach(Function f) const;
+
+    // Forget every count
+    void clear();
+
+protected:
+    // Bucket of a value in units
+    std::size_t index(unsigned long long units) const;
+
+    // Value in units at the bottom of a bucket
+    unsigned long long bottom(std::size_t index) const;
+
+    // Value in units, clamped to the trackable range
+    unsigned long long units(const T & value) const;
+
+    unsigned int _precision;
+    double _unit;
+    std::vector<std::size_t> _counts;
+};
+
+// Count one value into a histogram
+template<typename Histogram, typename Value>
+void addToHistogram(Histogram & histogram, const Value & value);
+
+// Count one value into a map
+template<typename T, typename Value>
+void addToHistogram(std::map<T,std::size_t> & histogram, const Value & value);
+
+// Count every value in a range into a histogram
+template<typename Histogram, typename Iterator>
+void addToHistogram(Histogram & histogram, Iterator first, Iterator last);
+
+// Count every value in a range into a map
+template<typename T, typename Iterator>
+void addToHistogram(std::map<T,std::size_t> & histogram, Iterator first, Iterator last);
+
+// Add the counts of one histogram into another
+template<typename Histogram>
+void mergeHistogram(Histogram & into, const Histogram & from);
+
+// Add the counts of one map into another
+template<typename T>
+void mergeHistogram(std::map<T,std::size_t> & into, const std::map<T,std::size_t> & from);
+
+// Call f(value, count) for every bin of a histogram in increasing order
+template<typename Histogram, typename Function>
+void forEachBin(const Histogram & histogram, Function f);
+
+// Call f(value, count) for every entry of a map in increasing order
+template<typename T, typename Function>
+void forEachBin(const std::map<T,std::size_t> & histogram, Function f);
+
+#include "histogram.cpp"
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * ingest.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Feed the stats accumulators straight from files instead of vectors:
+ * memory mapped raw binary arrays, and a chunked parser for one column of
+ * delimited text that reads a stream in fixed size pieces or splits a
+ * mapped file across threads.
+*/
+
+#ifndef INGEST_CPP
+#define INGEST_CPP
+
+#include "ingest.h"
+
+/*
+ * class MappedFile
+ * mmap of a whole file with madvise hints
+ */
+
+// Map path, hinting the kernel it will be read front to back
+inline MappedFile::MappedFile(const std::string & path){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Could not stat " + path);
+    }
+    _size = info.st_size;
+    if(_size > 0){
+        _data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(_data == MAP_FAILED){
+            int error = errno;
+            _data = NULL;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Could not map " + path);
+        }
+        // Larger readahead and early reclaim of pages already read
+        madvise(_data, _size, MADV_SEQUENTIAL);
+    }
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+}
+
+// Unmap the file
+inline MappedFile::~MappedFile(){
+    if(_data){
+        munmap(_data, _size);
+    }
+}
+
+// First byte of the file
+inline const char * MappedFile::data() const {
+    return (const char *)_data;
+}
+
+// File size in bytes
+inline std::size_t MappedFile::size() const {
+    return _size;
+}
+
+// Hint that [offset, offset + length) will be read soon, madvise wants a page aligned start
+inline void MappedFile::willNeed(std::size_t offset, std::size_t length) const {
+    if(!_data || offset >= _size) return;
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    std::size_t start = offset / page * page;
+    length = std::min(length, _size - offset) + (offset - start);
+    madvise((char *)_data + start, length, MADV_WILLNEED);
+}
+
+/*
+ * class MappedArray
+ * Typed view of a mapped file
+ */
+
+// Map path, throws std::invalid_argument if its size is not a multiple of sizeof(T)
+template<typename T>
+MappedArray<T>::MappedArray(const std::string & path) : _file(path) {
+    if(_file.size() % sizeof(T) != 0){
+        throw std::invalid_argument("File size is not a whole number of values: " + path);
+    }
+}
+
+// First value, mappings are page aligned so any T is aligned
+template<typename T>
+const T * MappedArray<T>::begin() const {
+    return (const T *)_file.data();
+}
+
+// One past the last value
+template<typename T>
+const T * MappedArray<T>::end() const {
+    return begin() + size();
+}
+
+// Number of values
+template<typename T>
+std::size_t MappedArray<T>::size() const {
+    return _file.size() / sizeof(T);
+}
+
+// One var stats of a raw binary array file, pointers go through the vector kernels
+template<typename T>
+OneVarResult mappedOneVarStats(const std::string & path, unsigned int threads){
+    MappedArray<T> values(path);
+    return parallelOneVarStats(values.begin(), values.end(), threads);
+}
+
+/*
+ * Number parsing
+ */
+
+// Exact powers of ten, a double quotient of exact operands rounds correctly
+const double parsePowers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define INGEST_SWAR
+#endif
+
+// Powers of ten that scale a mantissa past up to eight more digits
+const std::uint64_t parseScales[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+#ifdef INGEST_SWAR
+
+// Length of the run of ascii digits at the start of eight bytes loaded little
+// endian, xor maps digits to 0-9 and the add sets a byte's top bit past 9
+inline unsigned int swarDigitRun(std::uint64_t values){
+    std::uint64_t over = (((values & 0x7f7f7f7f7f7f7f7fULL) + 0x7676767676767676ULL) | values) & 0x8080808080808080ULL;
+    return over ? __builtin_ctzll(over) >> 3 : 8;
+}
+
+// Number formed by eight digit values, first in the low byte, pairs then
+// quads then the whole in three multiplies instead of eight
+inline std::uint32_t swarParseEight(std::uint64_t values){
+    const std::uint64_t mask = 0x000000ff000000ffULL;
+    const std::uint64_t pairs = 100 + (1000000ULL << 32);
+    const std::uint64_t quads = 1 + (10000ULL << 32);
+    values = values * 10 + (values >> 8);
+    return (((values & mask) * pairs) + (((values >> 16) & mask) * quads)) >> 32;
+}
+
+#endif
+
+// Append the run of digits at p to mantissa, counting them, and return its end
+// Eight bytes at a time the run is measured and converted without branching
+// on each digit, so ragged lengths do not cost mispredictions
+// Past 19 digits the mantissa overflows and only the count is meaningful
+inline const char * parseDigits(const char * p, const char * last, std::uint64_t & mantissa, int & digits){
+#ifdef INGEST_SWAR
+    while(last - p >= 8){
+        std::uint64_t values;
+        std::memcpy(&values, p, 8);
+        values ^= 0x3030303030303030ULL;
+        unsigned int run = swarDigitRun(values);
+        if(run == 0) return p;
+        // Shift the run to the top so the bytes after it read as leading zeros
+        if(run < 8) values <<= 8 * (8 - run);
+        mantissa = mantissa * parseScales[run] + swarParseEight(values);
+        digits += run;
+        p += run;
+        if(run < 8) return p;
+    }
+#endif
+    while(p < last && (unsigned char)(*p - '0') < 10){
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+        p++;
+    }
+    return p;
+}
+
+// Parse the plain decimal at the start of [p, last) and return its end, or
+// NULL if it needs strtod: sign, digits, optional point and digits, exact
+// when the mantissa fits a double and the power of ten is exact (Clinger)
+inline const char * parseSimple(const char * p, const char * last, double & value){
+    bool negative = p < last && *p == '-';
+    if(p < last && (*p == '-' || *p == '+')) p++;
+    std::uint64_t mantissa = 0;
+    int digits = 0, fraction = 0;
+    p = parseDigits(p, last, mantissa, digits);
+    if(p < last && *p == '.'){
+        int whole = digits;
+        p = parseDigits(p + 1, last, mantissa, digits);
+        fraction = digits - whole;
+    }
+    if(digits == 0 || digits > 19 || mantissa > (1ULL << 53) || fraction > 22) return NULL;
+    if(p < last && (*p == 'e' || *p == 'E')) return NULL;
+    double result = (double)mantissa;
+    if(fraction > 0) result /= parsePowers[fraction];
+    value = negative ? -result : result;
+    return p;
+}
+
+// Parse a decimal number in [first, last), returns false if it is not one
+inline bool parseNumber(const char * first, const char * last, double & value){
+    while(first < last && (*first == ' ' || *first == '\t')) first++;
+    while(last > first && (last[-1] == ' ' || last[-1] == '\t')) last--;
+    if(first == last) return false;
+    if(parseSimple(first, last, value) == last) return true;
+
+    // Exponents, long mantissas, inf and nan go through strtod on a terminated copy
+    std::size_t length = last - first;
+    char small[64];
+    std::string large;
+    const char * text = small;
+    if(length < sizeof(small)){
+        std::memcpy(small, first, length);
+        small[length] = '\0';
+    }
+    else{
+        large.assign(first, last);
+        text = large.c_str();
+    }
+    char * end;
+    double result = std::strtod(text, &end);
+    if(end != text + length) return false;
+    value = result;
+    return true;
+}
+
+/*
+ * class ColumnParser
+ * One column of delimited text, a chunk at a time
+ */
+
+// Read column column (0 based) of lines split by delimiter
+inline ColumnParser::ColumnParser(std::size_t column, char delimiter, std::size_t chunkSize)
+    : _column(column), _delimiter(delimiter), _chunkSize(std::max<std::size_t>(chunkSize, 64)) {}
+
+// Find this line's field, parse it and return the start of the next line
+// Fields are short, so one forward scan finds them faster than a memchr per
+// delimiter, and only the rest of the line after the field goes to memchr
+template<typename Function>
+const char * ColumnParser::parseLine(const char * first, const char * last, Function & f){
+    const char * p = first;
+    for(std::size_t c=0; c<_column; c++){
+        while(p < last && *p != _delimiter && *p != '\n') p++;
+        if(p == last || *p == '\n'){
+            _skipped++;
+            return p < last ? p + 1 : last;
+        }
+        p++;
+    }
+
+    // Most fields are plain numbers ending at the delimiter or line end, parse
+    // them in place and only scan for the field end when that fails
+    const char * field = p;
+    double value;
+    p = parseSimple(field, last, value);
+    if(p && (p == last || *p == _delimiter || *p == '\n' || (*p == '\r' && (p + 1 == last || p[1] == '\n' || p[1] == _delimiter)))){
+        f(value);
+    }
+    else{
+        p = field;
+        while(p < last && *p != _delimiter && *p != '\n') p++;
+        const char * fieldEnd = (p > field && p[-1] == '\r') ? p - 1 : p;
+        if(parseNumber(field, fieldEnd, value)){
+            f(value);
+        }
+        else{
+            _skipped++;
+        }
+    }
+
+    if(p < last && *p != '\n'){
+        p = (const char *)std::memchr(p, '\n', last - p);
+        if(!p) return last;
+    }
+    return p < last ? p + 1 : last;
+}
+
+// Call f(value) for each value in [first, last), a run of whole lines
+template<typename Function>
+void ColumnParser::parse(const char * first, const char * last, Function f){
+    while(first < last){
+        first = parseLine(first, last, f);
+    }
+}
+
+// Call f(value) for each value read from fd until end of file
+// Whole lines of each chunk are parsed and the partial last line is moved
+// to the front, a line longer than the buffer doubles it
+template<typename Function>
+void ColumnParser::read(int fd, Function f){
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    std::vector<char> buffer(_chunkSize);
+    std::size_t held = 0;
+    while(true){
+        if(held == buffer.size()){
+            buffer.resize(2 * buffer.size());
+        }
+        ssize_t got = ::read(fd, buffer.data() + held, buffer.size() - held);
+        if(got < 0){
+            if(errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "Could not read column data");
+        }
+        if(got == 0) break;
+
+        std::size_t scanned = held;
+        held += got;
+        std::size_t lines = held;
+        while(lines > scanned && buffer[lines - 1] != '\n') lines--;
+        if(lines == scanned) continue;
+        parse(buffer.data(), buffer.data() + lines, f);
+        held -= lines;
+        std::memmove(buffer.data(), buffer.data() + lines, held);
+    }
+    parse(buffer.data(), buffer.data() + held, f);
+}
+
+// Lines skipped so far
+inline std::size_t ColumnParser::skipped() const {
+    return _skipped;
+}
+
+/*
+ * Parallel column reduction
+ */
+
+// Values buffered per chunk before they go through the vector kernels
+const std::size_t parallelColumnBatch = 4096;
+
+// One var stats of one column of a delimited text file on threads threads
+inline OneVarResult parallelColumnStats(const std::string & path, std::size_t column, char delimiter,
+                                        unsigned int threads, std::size_t * skipped){
+    MappedFile file(path);
+    const char * data = file.data();
+    std::size_t size = file.size();
+    std::size_t chunks = (size + parallelColumnChunk - 1) / parallelColumnChunk;
+
+    // Chunk c holds the lines starting in [c * chunk, (c + 1) * chunk)
+    std::vector<std::size_t> starts(chunks + 1, size);
+    for(std::size_t c=0; c<chunks; c++){
+        if(c == 0){
+            starts[c] = 0;
+            continue;
+        }
+        std::size_t from = c * parallelColumnChunk - 1;
+        const char * newline = (const char *)std::memchr(data + from, '\n', size - from);
+        starts[c] = newline ? newline - data + 1 : size;
+    }
+
+    if(threads == 0) threads = 1;
+    if(threads > chunks) threads = chunks > 0 ? chunks : 1;
+    std::vector<OneVarAccumulator<double>> partials(chunks);
+    std::vector<std::size_t> skips(chunks, 0);
+    std::atomic<std::size_t> next(0);
+    auto work = [&](){
+        std::vector<double> batch;
+        batch.reserve(parallelColumnBatch);
+        for(std::size_t c=next++; c<chunks; c=next++){
+            file.willNeed(starts[c], starts[c + 1] - starts[c]);
+            ColumnParser parser(column, delimiter);
+            OneVarAccumulator<double> & partial = partials[c];
+            parser.parse(data + starts[c], data + starts[c + 1], [&](double value){
+                batch.push_back(value);
+                if(batch.size() == parallelColumnBatch){
+                    partial.add(batch.data(), batch.size());
+                    batch.clear();
+                }
+            });
+            if(!batch.empty()){
+                partial.add(batch.data(), batch.size());
+                batch.clear();
+            }
+            skips[c] = parser.skipped();
+        }
+    };
+    std::vector<std::thread> pool;
+    for(unsigned int id=1; id<threads; id++){
+        pool.emplace_back(work);
+    }
+    work();
+    for(auto & thread : pool){
+        thread.join();
+    }
+
+    mergeTree(partials);
+    if(skipped){
+        *skipped = 0;
+        for(std::size_t count : skips) *skipped += count;
+    }
+    return chunks > 0 ? partials[0].result() : OneVarResult();
+}
+
+#endif
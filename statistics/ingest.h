@@ -0,0 +1,137 @@
+/*
+ * ingest.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Feed the stats accumulators straight from files instead of vectors:
+ * memory mapped raw binary arrays, and a chunked parser for one column of
+ * delimited text that reads a stream in fixed size pieces or splits a
+ * mapped file across threads.
+*/
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stats.h"
+
+// Read only memory map of a whole file, unmapped on destruction
+// Throws std::system_error if the file cannot be opened or mapped
+class MappedFile {
+public:
+    // Map path, hinting the kernel it will be read front to back
+    MappedFile(const std::string & path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    // First byte of the file
+    const char * data() const;
+
+    // File size in bytes
+    std::size_t size() const;
+
+    // Hint that [offset, offset + length) will be read soon, for threads
+    // that each start in the middle of the file
+    void willNeed(std::size_t offset, std::size_t length) const;
+
+protected:
+    void * _data = NULL;
+    std::size_t _size = 0;
+};
+
+// Memory mapped file read as a raw array of T in native byte order
+template<typename T>
+class MappedArray {
+public:
+    // Map path, throws std::invalid_argument if its size is not a multiple of sizeof(T)
+    MappedArray(const std::string & path);
+
+    // Values in the file, contiguous so the stats kernels read them directly
+    const T * begin() const;
+    const T * end() const;
+
+    // Number of values
+    std::size_t size() const;
+
+protected:
+    MappedFile _file;
+};
+
+// One var stats of a raw binary array file on threads threads
+template<typename T>
+OneVarResult mappedOneVarStats(const std::string & path, unsigned int threads = std::thread::hardware_concurrency());
+
+// Parse a decimal number in [first, last), returns false if it is not one
+// Plain integers and decimals up to 19 digits take a SWAR fast path that
+// converts eight digits per step, anything else falls back to strtod
+bool parseNumber(const char * first, const char * last, double & value);
+
+// Parser for one column of delimited text, one record per line
+// Fields are not quoted, a trailing \r is dropped, and lines whose field is
+// missing or not a number (a header, say) are counted and skipped
+class ColumnParser {
+public:
+    // Read column column (0 based) of lines split by delimiter, streams
+    // are read chunkSize bytes at a time
+    ColumnParser(std::size_t column = 0, char delimiter = ',', std::size_t chunkSize = 1 << 20);
+
+    // Call f(value) for each value in [first, last), a run of whole lines
+    // A last line without a newline is parsed too
+    template<typename Function>
+    void parse(const char * first, const char * last, Function f);
+
+    // Call f(value) for each value read from fd until end of file, holding
+    // one chunk plus the longest line in memory
+    // Throws std::system_error if a read fails
+    template<typename Function>
+    void read(int fd, Function f);
+
+    // Lines skipped so far
+    std::size_t skipped() const;
+
+protected:
+    // Find this line's field, parse it and return the start of the next line
+    template<typename Function>
+    const char * parseLine(const char * first, const char * last, Function & f);
+
+    std::size_t _column;
+    char _delimiter;
+    std::size_t _chunkSize;
+    std::size_t _skipped = 0;
+};
+
+// Bytes per chunk in parallelColumnStats, chunks start after the first
+// newline at or past each multiple so no line is split
+const std::size_t parallelColumnChunk = 1 << 22;
+
+// One var stats of one column of a delimited text file on threads threads
+// The file is mapped and cut into fixed chunks merged in a fixed tree, so the
+// result does not depend on threads. skipped, if given, gets the lines skipped
+OneVarResult parallelColumnStats(const std::string & path, std::size_t column = 0, char delimiter = ',',
+                                 unsigned int threads = std::thread::hardware_concurrency(),
+                                 std::size_t * skipped = NULL);
+
+#include "ingest.cpp"
+
+#endif
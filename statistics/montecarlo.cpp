@@ -0,0 +1,111 @@
+/*
+ * montecarlo.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Parallel Monte Carlo driver. Rounds are played in fixed chunks, each
+ * from its own counter-based random stream, and streamed into mergeable
+ * accumulators merged in a fixed order, so a seed gives the same result
+ * on any number of threads.
+*/
+
+#ifndef MONTECARLO_CPP
+#define MONTECARLO_CPP
+
+#include "montecarlo.h"
+
+/*
+ * class MonteCarloTally
+ * One variable accumulator plus histogram
+ */
+
+// Start empty, counting into copies of histogram's settings
+template<typename T, typename Histogram>
+MonteCarloTally<T, Histogram>::MonteCarloTally(const Histogram & histogram) : _histogram(histogram) {
+    _histogram.clear();
+}
+
+// Record one round's value
+template<typename T, typename Histogram>
+void MonteCarloTally<T, Histogram>::add(const T & value){
+    _stats.add(value);
+    addToHistogram(_histogram, value);
+}
+
+// Fold in another tally
+template<typename T, typename Histogram>
+void MonteCarloTally<T, Histogram>::merge(const MonteCarloTally & other){
+    _stats.merge(other._stats);
+    mergeHistogram(_histogram, other._histogram);
+}
+
+// Number of rounds recorded
+template<typename T, typename Histogram>
+std::size_t MonteCarloTally<T, Histogram>::count() const {
+    return _stats.count();
+}
+
+// Summary of every value recorded
+template<typename T, typename Histogram>
+OneVarResult MonteCarloTally<T, Histogram>::result() const {
+    return _stats.result();
+}
+
+// Histogram of every value recorded
+template<typename T, typename Histogram>
+const Histogram & MonteCarloTally<T, Histogram>::histogram() const {
+    return _histogram;
+}
+
+/*
+ * Driver
+ */
+
+// Play rounds rounds on threads threads
+// Chunk c always plays from stream c, threads take the next chunk as they
+// finish so uneven rounds balance out, and partials merge in a fixed tree
+template<typename Accumulator, typename Round>
+Accumulator simulate(std::size_t rounds, Round round, const Accumulator & empty, std::uint64_t seed,
+                     unsigned int threads){
+    std::size_t chunk = std::max(monteCarloChunk, (rounds + monteCarloMaxChunks - 1) / monteCarloMaxChunks);
+    std::size_t chunks = (rounds + chunk - 1) / chunk;
+    if(threads == 0) threads = 1;
+    if(threads > chunks) threads = chunks > 0 ? chunks : 1;
+
+    std::vector<Accumulator> partials(chunks, empty);
+    std::atomic<std::size_t> next(0);
+    auto work = [&](){
+        for(std::size_t c=next++; c<chunks; c=next++){
+            // Each chunk plays on a fresh copy of round, so state it keeps is
+            // never shared between threads and every chunk starts the same
+            Round local = round;
+            CounterRandom random(seed, c);
+            Accumulator & partial = partials[c];
+            for(std::size_t i=c*chunk, end=std::min(rounds, i + chunk); i<end; i++){
+                partial.add(local(random));
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for(unsigned int id=1; id<threads; id++){
+        pool.emplace_back(work);
+    }
+    work();
+    for(auto & thread : pool){
+        thread.join();
+    }
+
+    mergeTree(partials);
+    return chunks > 0 ? partials[0] : empty;
+}
+
+// Play rounds rounds into a MonteCarloTally of whatever round returns
+template<typename Round>
+MonteCarloTally<decltype(std::declval<Round &>()(std::declval<CounterRandom &>()))>
+monteCarlo(std::size_t rounds, Round round, std::uint64_t seed, unsigned int threads){
+    typedef decltype(std::declval<Round &>()(std::declval<CounterRandom &>())) T;
+    return simulate(rounds, round, MonteCarloTally<T>(), seed, threads);
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * montecarlo.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Parallel Monte Carlo driver. Rounds are played in fixed chunks, each
+ * from its own counter-based random stream, and streamed into mergeable
+ * accumulators merged in a fixed order, so a seed gives the same result
+ * on any number of threads.
+*/
+
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "random.h"
+#include "stats.h"
+
+// Fewest rounds per chunk, each chunk plays from its own random stream
+const std::size_t monteCarloChunk = 4096;
+
+// Most chunks per run, longer runs get longer chunks so partials stay few
+const std::size_t monteCarloMaxChunks = 1024;
+
+// Summary and histogram of the values a simulation produced
+// Values are counted exactly in a map unless another histogram backend is given
+template<typename T, typename Histogram = std::map<T,std::size_t>>
+class MonteCarloTally {
+public:
+    // Start empty, counting into copies of histogram's settings
+    MonteCarloTally(const Histogram & histogram = Histogram());
+
+    // Record one round's value
+    void add(const T & value);
+
+    // Fold in another tally
+    void merge(const MonteCarloTally & other);
+
+    // Number of rounds recorded
+    std::size_t count() const;
+
+    // Summary of every value recorded
+    OneVarResult result() const;
+
+    // Histogram of every value recorded
+    const Histogram & histogram() const;
+
+protected:
+    OneVarAccumulator<T> _stats;
+    Histogram _histogram;
+};
+
+// Play rounds rounds on threads threads, each round adds round(random) to
+// an accumulator that starts as a copy of empty and supports add and merge
+// Round gets a CounterRandom, which works with any <random> distribution
+// Every chunk plays on its own copy of round, so a round that keeps state
+// such as a deck or a distribution is safe and still gives the same result
+// on any number of threads
+template<typename Accumulator, typename Round>
+Accumulator simulate(std::size_t rounds, Round round, const Accumulator & empty, std::uint64_t seed = 0,
+                     unsigned int threads = std::thread::hardware_concurrency());
+
+// Play rounds rounds into a MonteCarloTally of whatever round returns
+template<typename Round>
+MonteCarloTally<decltype(std::declval<Round &>()(std::declval<CounterRandom &>()))>
+monteCarlo(std::size_t rounds, Round round, std::uint64_t seed = 0,
+           unsigned int threads = std::thread::hardware_concurrency());
+
+#include "montecarlo.cpp"
+
+#endif
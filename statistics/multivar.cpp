@@ -0,0 +1,482 @@
+/*
+ * multivar.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Multivariate stats over column-major tables: means, covariance and
+ * correlation matrices and least squares fits, built from mergeable
+ * co-moments computed a cache sized block of rows at a time.
+*/
+
+#ifndef MULTIVAR_CPP
+#define MULTIVAR_CPP
+
+#include "multivar.h"
+#include "reduce.h"
+
+/*
+ * Co-moment tile kernels
+ * Each call takes two centered columns a, a + stride and four centered
+ * columns b .. b + 3 * stride and writes their eight dot products over
+ * rows rows, rows a multiple of 8 and the scratch zero padded to it
+ */
+
+typedef void (*CoMomentTile)(const double *, const double *, std::size_t, std::size_t, double *);
+
+// Portable tile, eight independent sums so the adds can overlap
+inline void coMomentTileScalar(const double * a, const double * b, std::size_t stride, std::size_t rows, double * out){
+    const double * a1 = a + stride;
+    const double * b1 = b + stride, * b2 = b + 2 * stride, * b3 = b + 3 * stride;
+    double s00 = 0, s01 = 0, s02 = 0, s03 = 0, s10 = 0, s11 = 0, s12 = 0, s13 = 0;
+    for(std::size_t r=0; r<rows; r++){
+        double x0 = a[r], x1 = a1[r];
+        s00 += x0 * b[r];   s10 += x1 * b[r];
+        s01 += x0 * b1[r];  s11 += x1 * b1[r];
+        s02 += x0 * b2[r];  s12 += x1 * b2[r];
+        s03 += x0 * b3[r];  s13 += x1 * b3[r];
+    }
+    out[0] = s00; out[1] = s01; out[2] = s02; out[3] = s03;
+    out[4] = s10; out[5] = s11; out[6] = s12; out[7] = s13;
+}
+
+#ifdef REDUCE_SIMD
+
+// Four rows per vector, eight accumulators and six loads fit the sixteen registers
+__attribute__((target("avx2,fma")))
+inline void coMomentTileAVX2(const double * a, const double * b, std::size_t stride, std::size_t rows, double * out){
+    const double * a1 = a + stride;
+    const double * b1 = b + stride, * b2 = b + 2 * stride, * b3 = b + 3 * stride;
+    __m256d s00 = _mm256_setzero_pd(), s01 = s00, s02 = s00, s03 = s00;
+    __m256d s10 = s00, s11 = s00, s12 = s00, s13 = s00;
+    for(std::size_t r=0; r<rows; r+=4){
+        __m256d x0 = _mm256_loadu_pd(a + r), x1 = _mm256_loadu_pd(a1 + r);
+        __m256d y = _mm256_loadu_pd(b + r);
+        s00 = _mm256_fmadd_pd(x0, y, s00);  s10 = _mm256_fmadd_pd(x1, y, s10);
+        y = _mm256_loadu_pd(b1 + r);
+        s01 = _mm256_fmadd_pd(x0, y, s01);  s11 = _mm256_fmadd_pd(x1, y, s11);
+        y = _mm256_loadu_pd(b2 + r);
+        s02 = _mm256_fmadd_pd(x0, y, s02);  s12 = _mm256_fmadd_pd(x1, y, s12);
+        y = _mm256_loadu_pd(b3 + r);
+        s03 = _mm256_fmadd_pd(x0, y, s03);  s13 = _mm256_fmadd_pd(x1, y, s13);
+    }
+    out[0] = laneSum(s00); out[1] = laneSum(s01); out[2] = laneSum(s02); out[3] = laneSum(s03);
+    out[4] = laneSum(s10); out[5] = laneSum(s11); out[6] = laneSum(s12); out[7] = laneSum(s13);
+}
+
+// Eight rows per vector, same shape as the AVX2 tile
+__attribute__((target("avx512f")))
+inline void coMomentTileAVX512(const double * a, const double * b, std::size_t stride, std::size_t rows, double * out){
+    const double * a1 = a + stride;
+    const double * b1 = b + stride, * b2 = b + 2 * stride, * b3 = b + 3 * stride;
+    __m512d s00 = _mm512_setzero_pd(), s01 = s00, s02 = s00, s03 = s00;
+    __m512d s10 = s00, s11 = s00, s12 = s00, s13 = s00;
+    for(std::size_t r=0; r<rows; r+=8){
+        __m512d x0 = _mm512_loadu_pd(a + r), x1 = _mm512_loadu_pd(a1 + r);
+        __m512d y = _mm512_loadu_pd(b + r);
+        s00 = _mm512_fmadd_pd(x0, y, s00);  s10 = _mm512_fmadd_pd(x1, y, s10);
+        y = _mm512_loadu_pd(b1 + r);
+        s01 = _mm512_fmadd_pd(x0, y, s01);  s11 = _mm512_fmadd_pd(x1, y, s11);
+        y = _mm512_loadu_pd(b2 + r);
+        s02 = _mm512_fmadd_pd(x0, y, s02);  s12 = _mm512_fmadd_pd(x1, y, s12);
+        y = _mm512_loadu_pd(b3 + r);
+        s03 = _mm512_fmadd_pd(x0, y, s03);  s13 = _mm512_fmadd_pd(x1, y, s13);
+    }
+    out[0] = _mm512_reduce_add_pd(s00); out[1] = _mm512_reduce_add_pd(s01);
+    out[2] = _mm512_reduce_add_pd(s02); out[3] = _mm512_reduce_add_pd(s03);
+    out[4] = _mm512_reduce_add_pd(s10); out[5] = _mm512_reduce_add_pd(s11);
+    out[6] = _mm512_reduce_add_pd(s12); out[7] = _mm512_reduce_add_pd(s13);
+}
+
+#endif
+
+// Pick the widest tile the cpu supports
+inline CoMomentTile coMomentSelect(){
+#ifdef REDUCE_SIMD
+    switch(reductionLevel()){
+        case 2: return coMomentTileAVX512;
+        case 1: if(__builtin_cpu_supports("fma")) return coMomentTileAVX2;
+    }
+#endif
+    return coMomentTileScalar;
+}
+
+// Tile kernel on this cpu, picked on first use
+inline CoMomentTile coMomentTile(){
+    static const CoMomentTile tile = coMomentSelect();
+    return tile;
+}
+
+/*
+ * class MultiVarStats
+ * Mergeable means and co-moments of a fixed set of columns
+ */
+
+// Columns per panel of the block, the panel's scratch columns stay in L1
+// while every pair of columns before it streams past
+const std::size_t multiVarPanel = 16;
+
+// Track columns columns, scratch is allocated on the first add
+inline MultiVarStats::MultiVarStats(std::size_t columns) : _columns(columns), _width((columns + 3) / 4 * 4),
+    _means(columns, 0), _comoments(columns * columns, 0), _delta(columns, 0) {}
+
+// Add rows rows given a pointer to each column
+template<typename T>
+void MultiVarStats::add(const T * const * columns, std::size_t rows){
+    if(_centered.empty()){
+        _centered.assign(multiVarBlock * _width, 0);
+        _blockMeans.assign(_columns, 0);
+        _blockComoments.assign(_columns * _columns, 0);
+    }
+    for(std::size_t first=0; first<rows; first+=multiVarBlock){
+        addBlock(columns, first, std::min(multiVarBlock, rows - first));
+    }
+}
+
+// Add rows rows of column-major data, column j starting at data + j * stride
+template<typename T>
+void MultiVarStats::add(const T * data, std::size_t rows, std::size_t stride){
+    std::vector<const T *> columns(_columns);
+    for(std::size_t j=0; j<_columns; j++){
+        columns[j] = data + j * stride;
+    }
+    add(columns.data(), rows);
+}
+
+// Center one block of rows into the scratch buffer and fold it in
+template<typename T>
+void MultiVarStats::addBlock(const T * const * columns, std::size_t first, std::size_t rows){
+    // Kernels step eight rows at a time, the zeros past the block add nothing
+    std::size_t padded = (rows + 7) / 8 * 8;
+    for(std::size_t j=0; j<_columns; j++){
+        const T * column = columns[j] + first;
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        std::size_t r = 0;
+        for(; r+4<=rows; r+=4){
+            s0 += column[r];
+            s1 += column[r + 1];
+            s2 += column[r + 2];
+            s3 += column[r + 3];
+        }
+        for(; r<rows; r++){
+            s0 += column[r];
+        }
+        double mean = ((s0 + s1) + (s2 + s3)) / rows;
+        _blockMeans[j] = mean;
+
+        double * centered = &_centered[j * multiVarBlock];
+        for(r=0; r<rows; r++){
+            centered[r] = column[r] - mean;
+        }
+        std::fill(centered + rows, centered + padded, 0.0);
+    }
+
+    // Upper triangle of the block's co-moments, one 2 x 4 tile per kernel call
+    CoMomentTile tile = coMomentTile();
+    double out[8];
+    for(std::size_t panel=0; panel<_width; panel+=multiVarPanel){
+        std::size_t panelEnd = std::min(panel + multiVarPanel, _width);
+        for(std::size_t i=0; i<panelEnd && i<_columns; i+=2){
+            for(std::size_t j=std::max(panel, i / 4 * 4); j<panelEnd; j+=4){
+                tile(&_centered[i * multiVarBlock], &_centered[j * multiVarBlock], multiVarBlock, padded, out);
+                for(std::size_t a=0; a<2; a++){
+                    for(std::size_t b=0; b<4; b++){
+                        if(i + a <= j + b && j + b < _columns){
+                            _blockComoments[(i + a) * _columns + j + b] = out[a * 4 + b];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    mergeBlock(rows, _blockMeans.data(), _blockComoments.data());
+}
+
+// Fold in a block's count, means and upper triangle co-moments
+inline void MultiVarStats::mergeBlock(std::size_t count, const double * means, const double * comoments){
+    if(count == 0) return;
+    if(_count == 0){
+        _count = count;
+        std::copy(means, means + _columns, _means.begin());
+        for(std::size_t i=0; i<_columns; i++){
+            std::copy(comoments + i * _columns + i, comoments + (i + 1) * _columns, &_comoments[i * _columns + i]);
+        }
+        return;
+    }
+
+    double n = _count + count;
+    double weight = (double)_count * count / n;
+    double * delta = _delta.data();
+    for(std::size_t i=0; i<_columns; i++){
+        delta[i] = means[i] - _means[i];
+    }
+    for(std::size_t i=0; i<_columns; i++){
+        double scaled = weight * delta[i];
+        double * row = &_comoments[i * _columns];
+        const double * from = comoments + i * _columns;
+        for(std::size_t j=i; j<_columns; j++){
+            row[j] += from[j] + scaled * delta[j];
+        }
+    }
+    for(std::size_t i=0; i<_columns; i++){
+        _means[i] += delta[i] * count / n;
+    }
+    _count += count;
+}
+
+// Fold in the rows another accumulator over the same columns has seen
+inline void MultiVarStats::merge(const MultiVarStats & other){
+    if(other._columns != _columns){
+        throw std::invalid_argument("Cannot merge stats over different columns.");
+    }
+    mergeBlock(other._count, other._means.data(), other._comoments.data());
+}
+
+// Number of rows added
+inline std::size_t MultiVarStats::count() const {
+    return _count;
+}
+
+// Number of columns
+inline std::size_t MultiVarStats::columns() const {
+    return _columns;
+}
+
+// Mean of each column
+inline const std::vector<double> & MultiVarStats::means() const {
+    return _means;
+}
+
+// Population covariance matrix, row-major columns x columns
+inline std::vector<double> MultiVarStats::covariance() const {
+    std::vector<double> result(_columns * _columns, std::numeric_limits<double>::quiet_NaN());
+    if(_count == 0) return result;
+    for(std::size_t i=0; i<_columns; i++){
+        for(std::size_t j=i; j<_columns; j++){
+            result[i * _columns + j] = result[j * _columns + i] = _comoments[i * _columns + j] / _count;
+        }
+    }
+    return result;
+}
+
+// Bessel corrected covariance matrix, row-major columns x columns
+inline std::vector<double> MultiVarStats::sampleCovariance() const {
+    std::vector<double> result(_columns * _columns, std::numeric_limits<double>::quiet_NaN());
+    if(_count < 2) return result;
+    for(std::size_t i=0; i<_columns; i++){
+        for(std::size_t j=i; j<_columns; j++){
+            result[i * _columns + j] = result[j * _columns + i] = _comoments[i * _columns + j] / (_count - 1);
+        }
+    }
+    return result;
+}
+
+// Pearson correlation matrix, row-major columns x columns
+// Pairs with a constant column are NaN
+inline std::vector<double> MultiVarStats::correlation() const {
+    std::vector<double> result(_columns * _columns, std::numeric_limits<double>::quiet_NaN());
+    for(std::size_t i=0; i<_columns; i++){
+        double vi = _comoments[i * _columns + i];
+        if(vi <= 0) continue;
+        result[i * _columns + i] = 1;
+        for(std::size_t j=i+1; j<_columns; j++){
+            double vj = _comoments[j * _columns + j];
+            if(vj <= 0) continue;
+            result[i * _columns + j] = result[j * _columns + i] = _comoments[i * _columns + j] / std::sqrt(vi * vj);
+        }
+    }
+    return result;
+}
+
+// Fit response = intercept + sum coefficients[k] * predictors[k]
+// Solves the centered normal equations by Cholesky, the co-moments are
+// already the centered cross products so no centered data is needed
+inline Regression MultiVarStats::regress(std::size_t response, const std::vector<std::size_t> & predictors) const {
+    auto comoment = [&](std::size_t i, std::size_t j){
+        return i <= j ? _comoments[i * _columns + j] : _comoments[j * _columns + i];
+    };
+    std::size_t k = predictors.size();
+    if(response >= _columns) throw std::invalid_argument("Response column out of range.");
+    for(std::size_t p : predictors){
+        if(p >= _columns) throw std::invalid_argument("Predictor column out of range.");
+    }
+    // An intercept and k slopes leave _count - k - 1 degrees of freedom for the residual
+    if(_count <= k + 1) throw std::runtime_error("Too few rows to fit the regression.");
+
+    // Lower triangular factor of the predictors' co-moment matrix
+    std::vector<double> factor(k * k, 0);
+    for(std::size_t i=0; i<k; i++){
+        for(std::size_t j=0; j<=i; j++){
+            double sum = comoment(predictors[i], predictors[j]);
+            for(std::size_t m=0; m<j; m++){
+                sum -= factor[i * k + m] * factor[j * k + m];
+            }
+            if(i == j){
+                // A pivot lost to rounding means the column is a combination of earlier ones
+                if(!(sum > 1e-12 * comoment(predictors[i], predictors[i]))){
+                    throw std::runtime_error("Predictors are collinear.");
+                }
+                factor[i * k + i] = std::sqrt(sum);
+            }
+            else{
+                factor[i * k + j] = sum / factor[j * k + j];
+            }
+        }
+    }
+
+    // Solve L L^T x = rhs in place
+    auto solve = [&](std::vector<double> & x){
+        for(std::size_t i=0; i<k; i++){
+            for(std::size_t m=0; m<i; m++){
+                x[i] -= factor[i * k + m] * x[m];
+            }
+            x[i] /= factor[i * k + i];
+        }
+        for(std::size_t i=k; i-->0; ){
+            for(std::size_t m=i+1; m<k; m++){
+                x[i] -= factor[m * k + i] * x[m];
+            }
+            x[i] /= factor[i * k + i];
+        }
+    };
+
+    Regression result;
+    result.coefficients.resize(k);
+    for(std::size_t i=0; i<k; i++){
+        result.coefficients[i] = comoment(predictors[i], response);
+    }
+    solve(result.coefficients);
+
+    result.intercept = _means[response];
+    double explained = 0;
+    for(std::size_t i=0; i<k; i++){
+        result.intercept -= result.coefficients[i] * _means[predictors[i]];
+        explained += result.coefficients[i] * comoment(predictors[i], response);
+    }
+    double total = comoment(response, response);
+    double residual = std::max(total - explained, 0.0);
+    result.r2 = total > 0 ? 1 - residual / total : 1;
+    result.residualVariance = residual / (_count - k - 1);
+
+    // Standard errors from the diagonal of the inverse co-moment matrix
+    result.standardErrors.resize(k);
+    std::vector<double> unit(k);
+    for(std::size_t i=0; i<k; i++){
+        std::fill(unit.begin(), unit.end(), 0.0);
+        unit[i] = 1;
+        solve(unit);
+        result.standardErrors[i] = std::sqrt(result.residualVariance * unit[i]);
+    }
+    return result;
+}
+
+// Fit response against every other column
+inline Regression MultiVarStats::regress(std::size_t response) const {
+    std::vector<std::size_t> predictors;
+    for(std::size_t j=0; j<_columns; j++){
+        if(j != response) predictors.push_back(j);
+    }
+    return regress(response, predictors);
+}
+
+// Forget every row
+inline void MultiVarStats::reset(){
+    _count = 0;
+    std::fill(_means.begin(), _means.end(), 0.0);
+    std::fill(_comoments.begin(), _comoments.end(), 0.0);
+}
+
+/*
+ * Parallel accumulation
+ */
+
+// Rows per chunk in parallelMultiVarStats
+const std::size_t parallelMultiVarRows = 1 << 16;
+
+// Node of the merge tree in parallelMultiVarStats, covering chunks
+// [start, start + 2^level)
+struct MultiVarNode {
+    std::size_t start;
+    unsigned int level;
+    MultiVarStats stats;
+};
+
+// Push a node onto a stack of finished subtrees in chunk order and merge it
+// up the tree while its sibling is done, binary counter style. Node (s, l + 1)
+// is node (s, l) merged with node (s + 2^l, l), or node (s, l) alone when
+// that is past the last chunk, so any split of the chunks builds the same tree
+inline void pushMultiVarNode(std::vector<MultiVarNode> & stack, MultiVarNode node, std::size_t chunks){
+    stack.push_back(std::move(node));
+    while(((std::size_t)1 << stack.back().level) < chunks){
+        MultiVarNode & top = stack.back();
+        std::size_t width = (std::size_t)1 << top.level;
+        if(top.start & width){
+            // Right child, folds into its left sibling once that is complete
+            if(stack.size() < 2) break;
+            MultiVarNode & left = stack[stack.size() - 2];
+            if(left.level != top.level || left.start + width != top.start) break;
+            left.stats.merge(top.stats);
+            left.level++;
+            stack.pop_back();
+        }
+        else if(top.start + width >= chunks){
+            // Left child with no right sibling passes up unchanged
+            top.level++;
+        }
+        else{
+            break;
+        }
+    }
+}
+
+// Accumulate a column-major table on threads threads
+// Each thread merges finished subtrees of its chunks as it goes and only the
+// partial subtrees at its edges are left to merge at the end, so about
+// log2(chunks) matrices per thread are alive rather than one per chunk
+template<typename T>
+MultiVarStats parallelMultiVarStats(const T * data, std::size_t rows, std::size_t columns, std::size_t stride,
+                                    unsigned int threads){
+    std::size_t chunks = (rows + parallelMultiVarRows - 1) / parallelMultiVarRows;
+    if(chunks == 0) return MultiVarStats(columns);
+    if(threads == 0) threads = 1;
+    if(threads > chunks) threads = chunks;
+
+    // Each thread reuses one accumulator's scratch and keeps its own stack
+    std::vector<std::vector<MultiVarNode>> stacks(threads);
+    auto work = [&](unsigned int id){
+        MultiVarStats local(columns);
+        std::vector<const T *> pointers(columns);
+        std::size_t begin = chunks * id / threads, end = chunks * (id + 1) / threads;
+        for(std::size_t c=begin; c<end; c++){
+            std::size_t first = c * parallelMultiVarRows;
+            for(std::size_t j=0; j<columns; j++){
+                pointers[j] = data + j * stride + first;
+            }
+            local.reset();
+            local.add(pointers.data(), std::min(parallelMultiVarRows, rows - first));
+            MultiVarNode leaf{c, 0, MultiVarStats(columns)};
+            leaf.stats.merge(local);
+            pushMultiVarNode(stacks[id], std::move(leaf), chunks);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(unsigned int id=1; id<threads; id++){
+        pool.emplace_back(work, id);
+    }
+    work(0);
+    for(auto & thread : pool){
+        thread.join();
+    }
+
+    // Finish the tree from the subtrees left at the thread boundaries, in chunk order
+    std::vector<MultiVarNode> stack;
+    for(auto & partial : stacks){
+        for(auto & node : partial){
+            pushMultiVarNode(stack, std::move(node), chunks);
+        }
+        partial.clear();
+    }
+    return stack.front().stats;
+}
+
+#endif
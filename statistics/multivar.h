@@ -0,0 +1,116 @@
+/*
+ * multivar.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Multivariate stats over column-major tables: means, covariance and
+ * correlation matrices and least squares fits, built from mergeable
+ * co-moments computed a cache sized block of rows at a time.
+*/
+
+#ifndef MULTIVAR_H
+#define MULTIVAR_H
+
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+
+// Least squares fit of one column against others
+struct Regression {
+    double intercept = 0;
+    std::vector<double> coefficients;       // One per predictor, in the order given
+    std::vector<double> standardErrors;     // Of the coefficients
+    double r2 = 0;                          // Fraction of variance explained
+    double residualVariance = 0;            // Unbiased estimate of the error variance
+};
+
+// Rows per block in MultiVarStats, a block of every column is centered in
+// scratch and walked from cache once per pair of columns
+const std::size_t multiVarBlock = 256;
+
+// Streaming means and co-moments of a fixed set of columns
+// Rows are taken a block at a time, centered on the block's own means in a
+// small scratch buffer and folded into the totals with the pairwise update
+// of Chan, Golub and LeVeque, so two accumulators merge exactly the same way
+class MultiVarStats {
+public:
+    // Track columns columns
+    MultiVarStats(std::size_t columns);
+
+    // Add rows rows given a pointer to each column
+    template<typename T>
+    void add(const T * const * columns, std::size_t rows);
+
+    // Add rows rows of column-major data, column j starting at data + j * stride
+    template<typename T>
+    void add(const T * data, std::size_t rows, std::size_t stride);
+
+    // Fold in the rows another accumulator over the same columns has seen
+    void merge(const MultiVarStats & other);
+
+    // Number of rows added
+    std::size_t count() const;
+
+    // Number of columns
+    std::size_t columns() const;
+
+    // Mean of each column
+    const std::vector<double> & means() const;
+
+    // Population covariance matrix, row-major columns x columns
+    std::vector<double> covariance() const;
+
+    // Bessel corrected covariance matrix, row-major columns x columns
+    std::vector<double> sampleCovariance() const;
+
+    // Pearson correlation matrix, row-major columns x columns
+    std::vector<double> correlation() const;
+
+    // Fit response = intercept + sum coefficients[k] * predictors[k]
+    // Throws std::runtime_error if the predictors are collinear or there are
+    // not more rows than predictors plus one
+    Regression regress(std::size_t response, const std::vector<std::size_t> & predictors) const;
+
+    // Fit response against every other column
+    Regression regress(std::size_t response) const;
+
+    // Forget every row
+    void reset();
+
+protected:
+    // Center one block of rows into the scratch buffer and fold it in
+    template<typename T>
+    void addBlock(const T * const * columns, std::size_t first, std::size_t rows);
+
+    // Fold in a block's count, means and upper triangle co-moments
+    void mergeBlock(std::size_t count, const double * means, const double * comoments);
+
+    std::size_t _columns;
+    std::size_t _width;                 // Columns rounded up to the kernel tile
+    std::size_t _count = 0;
+    std::vector<double> _means;
+    std::vector<double> _comoments;     // Upper triangle of sum (x_i - mean_i)(x_j - mean_j), row-major
+
+    // Scratch for one block, reused between calls
+    std::vector<double> _centered;      // multiVarBlock x _width, column-major
+    std::vector<double> _blockMeans;
+    std::vector<double> _blockComoments;
+    std::vector<double> _delta;         // Difference of means in mergeBlock, sized up front for merge
+};
+
+// Accumulate a column-major table on threads threads, rows are split in
+// fixed chunks merged in a fixed tree so the result does not depend on threads
+// Subtrees merge as soon as they are complete, so only about log2(chunks)
+// partials per thread are held at once
+template<typename T>
+MultiVarStats parallelMultiVarStats(const T * data, std::size_t rows, std::size_t columns, std::size_t stride,
+                                    unsigned int threads = std::thread::hardware_concurrency());
+
+#include "multivar.cpp"
+
+#endif
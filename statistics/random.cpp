@@ -0,0 +1,57 @@
+/*
+ * random.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Counter-based random streams for the stats library. Any stream of any
+ * seed can be started anywhere without state from the others, which is
+ * what makes parallel resampling and simulation repeatable.
+*/
+
+#ifndef RANDOM_CPP
+#define RANDOM_CPP
+
+#include "random.h"
+
+/*
+ * class CounterRandom
+ * SplitMix64 read as a counter-based generator
+ */
+
+// Stafford's variant 13 finalizer, a bijection that scrambles every bit
+inline std::uint64_t counterMix(std::uint64_t x){
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Stream stream of the generator keyed by seed
+inline CounterRandom::CounterRandom(std::uint64_t seed, std::uint64_t stream)
+    : _key(counterMix(counterMix(seed) ^ (stream * 0xd1b54a32d192ed03ULL + 1))) {}
+
+// Next 64 random bits, the mixed key plus counter times the golden gamma
+inline std::uint64_t CounterRandom::operator()(){
+    return counterMix(_key + ++_counter * 0x9e3779b97f4a7c15ULL);
+}
+
+// Uniform integer in [0, bound) by Lemire's multiply and reject
+inline std::uint64_t CounterRandom::below(std::uint64_t bound){
+    unsigned __int128 product = (unsigned __int128)(*this)() * bound;
+    std::uint64_t low = (std::uint64_t)product;
+    if(low < bound){
+        std::uint64_t threshold = -bound % bound;
+        while(low < threshold){
+            product = (unsigned __int128)(*this)() * bound;
+            low = (std::uint64_t)product;
+        }
+    }
+    return (std::uint64_t)(product >> 64);
+}
+
+// Uniform double in [0, 1) from the top 53 bits
+inline double CounterRandom::uniform(){
+    return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * random.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Counter-based random streams for the stats library. Any stream of any
+ * seed can be started anywhere without state from the others, which is
+ * what makes parallel resampling and simulation repeatable.
+*/
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// Counter-based generator, the nth output of stream s under seed k is a
+// pure function of (k, s, n), so any replicate can be drawn on any thread
+// Meets UniformRandomBitGenerator, so <random> distributions accept it
+class CounterRandom {
+public:
+    typedef std::uint64_t result_type;
+
+    // Stream stream of the generator keyed by seed
+    CounterRandom(std::uint64_t seed, std::uint64_t stream);
+
+    // Next 64 random bits
+    std::uint64_t operator()();
+
+    // Uniform integer in [0, bound), bound > 0
+    std::uint64_t below(std::uint64_t bound);
+
+    // Uniform double in [0, 1)
+    double uniform();
+
+    // Range of operator()
+    static constexpr result_type min(){ return 0; }
+    static constexpr result_type max(){ return ~(result_type)0; }
+
+protected:
+    std::uint64_t _key;
+    std::uint64_t _counter = 0;
+};
+
+#include "random.cpp"
+
+#endif
@@ -0,0 +1,494 @@
+/*
+ * reduce.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Vectorized reductions over contiguous int32, int64, float and double
+ * arrays for the stats library, with AVX2 and AVX-512 kernels picked at
+ * runtime and a scalar fallback for everything else.
+*/
+
+#ifndef REDUCE_CPP
+#define REDUCE_CPP
+
+#include "reduce.h"
+
+/*
+ * Shared helpers
+ */
+
+// Kahan compensated running sum
+struct KahanSum {
+    double sum = 0;
+    double error = 0;
+
+    // Add x, carrying the low bits lost to rounding
+    void add(double x){
+        double y = x - error;
+        double t = sum + y;
+        error = (t - sum) - y;
+        sum = t;
+    }
+};
+
+// Fold the moments of one run into another with the pairwise update of Chan and Pebay
+inline void mergeMoments(Moments & into, const Moments & from){
+    if(from.count == 0){
+        return;
+    }
+    if(into.count == 0){
+        into = from;
+        return;
+    }
+    double na = (double)into.count, nb = (double)from.count;
+    double n = na + nb;
+    double delta = from.mean - into.mean;
+    double delta2 = delta * delta;
+
+    double m2 = into.m2 + from.m2 + delta2 * na * nb / n;
+    double m3 = into.m3 + from.m3 + delta2 * delta * na * nb * (na - nb) / (n * n)
+              + 3 * delta * (na * from.m2 - nb * into.m2) / n;
+    double m4 = into.m4 + from.m4 + delta2 * delta2 * na * nb * (na*na - na*nb + nb*nb) / (n * n * n)
+              + 6 * delta2 * (na*na * from.m2 + nb*nb * into.m2) / (n * n)
+              + 4 * delta * (na * from.m3 - nb * into.m3) / n;
+
+    into.mean += delta * nb / n;
+    into.m2 = m2;
+    into.m3 = m3;
+    into.m4 = m4;
+    into.count += from.count;
+    if(from.min < into.min) into.min = from.min;
+    if(from.max > into.max) into.max = from.max;
+}
+
+// Merge partials pairwise into partials[0] in a fixed tree
+template<typename Partial>
+void mergeTree(std::vector<Partial> & partials){
+    for(std::size_t stride=1; stride<partials.size(); stride*=2){
+        for(std::size_t i=0; i+stride<partials.size(); i+=2*stride){
+            partials[i].merge(partials[i + stride]);
+        }
+    }
+}
+
+// Central moments from sums of powers of deviations from a guess c of the
+// mean, correcting for the guess being off by s1/n
+inline Moments shiftedMoments(std::size_t count, double c, double s1, double s2, double s3, double s4,
+                              double min, double max){
+    Moments result;
+    double n = (double)count;
+    double d = s1 / n;
+    result.count = count;
+    result.mean = c + d;
+    result.m2 = s2 - n * d * d;
+    result.m3 = s3 - 3 * d * s2 + 2 * n * d * d * d;
+    result.m4 = s4 - 4 * d * s3 + 6 * d * d * s2 - 3 * n * d * d * d * d;
+    result.min = min;
+    result.max = max;
+    return result;
+}
+
+/*
+ * Scalar kernels
+ * Used for any type the vector kernels do not load and for array tails
+ */
+
+// Count, compensated sums and extremes
+template<typename T>
+Reduction reduceScalar(const T * values, std::size_t count){
+    Reduction result;
+    KahanSum sum, squares;
+    for(std::size_t i=0; i<count; i++){
+        double x = (double)values[i];
+        sum.add(x);
+        squares.add(x * x);
+        if(x < result.min) result.min = x;
+        if(x > result.max) result.max = x;
+    }
+    result.count = count;
+    result.sum = sum.sum;
+    result.sumSquares = squares.sum;
+    return result;
+}
+
+// Moments of one block, summing first to center the second pass
+template<typename T>
+Moments momentsScalar(const T * values, std::size_t count){
+    double sum = 0, min = std::numeric_limits<double>::infinity(), max = -min;
+    for(std::size_t i=0; i<count; i++){
+        double x = (double)values[i];
+        sum += x;
+        if(x < min) min = x;
+        if(x > max) max = x;
+    }
+    double c = sum / count;
+    double s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+    for(std::size_t i=0; i<count; i++){
+        double d = (double)values[i] - c;
+        double d2 = d * d;
+        s1 += d;
+        s2 += d2;
+        s3 += d2 * d;
+        s4 += d2 * d2;
+    }
+    return shiftedMoments(count, c, s1, s2, s3, s4, min, max);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// GCC 12 flags the AVX-512 intrinsics' own undefined vectors when they are
+// inlined into target attribute functions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+
+#define REDUCE_SIMD
+
+/*
+ * AVX2 kernels
+ * Four doubles per vector, two vectors per step to hide add latency
+ */
+
+// Load four values widened to double
+__attribute__((target("avx2")))
+inline __m256d reduceLoad4(const double * p){
+    return _mm256_loadu_pd(p);
+}
+
+__attribute__((target("avx2")))
+inline __m256d reduceLoad4(const float * p){
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 4, int>::type = 0>
+__attribute__((target("avx2")))
+inline __m256d reduceLoad4(const T * p){
+    return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)p));
+}
+
+// AVX2 has no 64 bit integer to double conversion
+template<typename T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8, int>::type = 0>
+__attribute__((target("avx2")))
+inline __m256d reduceLoad4(const T * p){
+    return _mm256_setr_pd((double)p[0], (double)p[1], (double)p[2], (double)p[3]);
+}
+
+// Vector Kahan step
+__attribute__((target("avx2")))
+inline void kahanAdd(__m256d & sum, __m256d & error, __m256d x){
+    __m256d y = _mm256_sub_pd(x, error);
+    __m256d t = _mm256_add_pd(sum, y);
+    error = _mm256_sub_pd(_mm256_sub_pd(t, sum), y);
+    sum = t;
+}
+
+// Sum of the lanes of a vector
+__attribute__((target("avx2")))
+inline double laneSum(__m256d v){
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// Count, compensated sums and extremes, 8 values per step
+template<typename T>
+__attribute__((target("avx2")))
+Reduction reduceAVX2(const T * values, std::size_t count){
+    __m256d sum[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    __m256d sumError[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    __m256d squares[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    __m256d squaresError[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    __m256d low = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d high = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        for(int j=0; j<2; j++){
+            __m256d x = reduceLoad4(values + i + 4*j);
+            kahanAdd(sum[j], sumError[j], x);
+            kahanAdd(squares[j], squaresError[j], _mm256_mul_pd(x, x));
+            low = _mm256_min_pd(low, x);
+            high = _mm256_max_pd(high, x);
+        }
+    }
+
+    // Fold the lanes through scalar Kahan sums, then finish the tail
+    Reduction result = reduceScalar(values + i, count - i);
+    KahanSum totalSum, totalSquares;
+    totalSum.add(result.sum);
+    totalSquares.add(result.sumSquares);
+    double lanes[8];
+    for(int j=0; j<2; j++){
+        _mm256_storeu_pd(lanes, sum[j]);
+        _mm256_storeu_pd(lanes + 4, sumError[j]);
+        for(int k=0; k<4; k++) totalSum.add(lanes[k] - lanes[k + 4]);
+        _mm256_storeu_pd(lanes, squares[j]);
+        _mm256_storeu_pd(lanes + 4, squaresError[j]);
+        for(int k=0; k<4; k++) totalSquares.add(lanes[k] - lanes[k + 4]);
+    }
+    _mm256_storeu_pd(lanes, low);
+    _mm256_storeu_pd(lanes + 4, high);
+    for(int k=0; k<4; k++){
+        if(lanes[k] < result.min) result.min = lanes[k];
+        if(lanes[k + 4] > result.max) result.max = lanes[k + 4];
+    }
+    result.count = count;
+    result.sum = totalSum.sum;
+    result.sumSquares = totalSquares.sum;
+    return result;
+}
+
+// Moments of one block, 8 values per step
+template<typename T>
+__attribute__((target("avx2")))
+Moments momentsAVX2(const T * values, std::size_t count){
+    __m256d sum[2] = { _mm256_setzero_pd(), _mm256_setzero_pd() };
+    __m256d low = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d high = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        for(int j=0; j<2; j++){
+            __m256d x = reduceLoad4(values + i + 4*j);
+            sum[j] = _mm256_add_pd(sum[j], x);
+            low = _mm256_min_pd(low, x);
+            high = _mm256_max_pd(high, x);
+        }
+    }
+    double total = laneSum(_mm256_add_pd(sum[0], sum[1]));
+    double lanes[8];
+    _mm256_storeu_pd(lanes, low);
+    _mm256_storeu_pd(lanes + 4, high);
+    double min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    double max = std::max(std::max(lanes[4], lanes[5]), std::max(lanes[6], lanes[7]));
+    for(std::size_t t=i; t<count; t++){
+        double x = (double)values[t];
+        total += x;
+        if(x < min) min = x;
+        if(x > max) max = x;
+    }
+    double c = total / count;
+
+    // Second pass over the block, now in cache
+    __m256d center = _mm256_set1_pd(c);
+    __m256d s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd(), s4 = _mm256_setzero_pd();
+    for(i=0; i + 4 <= count; i += 4){
+        __m256d d = _mm256_sub_pd(reduceLoad4(values + i), center);
+        __m256d d2 = _mm256_mul_pd(d, d);
+        s1 = _mm256_add_pd(s1, d);
+        s2 = _mm256_add_pd(s2, d2);
+        s3 = _mm256_add_pd(s3, _mm256_mul_pd(d2, d));
+        s4 = _mm256_add_pd(s4, _mm256_mul_pd(d2, d2));
+    }
+    double t1 = laneSum(s1), t2 = laneSum(s2), t3 = laneSum(s3), t4 = laneSum(s4);
+    for(; i<count; i++){
+        double d = (double)values[i] - c;
+        double d2 = d * d;
+        t1 += d;
+        t2 += d2;
+        t3 += d2 * d;
+        t4 += d2 * d2;
+    }
+    return shiftedMoments(count, c, t1, t2, t3, t4, min, max);
+}
+
+/*
+ * AVX-512 kernels
+ * Eight doubles per vector, two vectors per step
+ */
+
+// Load eight values widened to double
+__attribute__((target("avx512f,avx512dq")))
+inline __m512d reduceLoad8(const double * p){
+    return _mm512_loadu_pd(p);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+inline __m512d reduceLoad8(const float * p){
+    return _mm512_cvtps_pd(_mm256_loadu_ps(p));
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 4, int>::type = 0>
+__attribute__((target("avx512f,avx512dq")))
+inline __m512d reduceLoad8(const T * p){
+    return _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i *)p));
+}
+
+template<typename T, typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 8, int>::type = 0>
+__attribute__((target("avx512f,avx512dq")))
+inline __m512d reduceLoad8(const T * p){
+    return _mm512_cvtepi64_pd(_mm512_loadu_si512((const void *)p));
+}
+
+// Vector Kahan step
+__attribute__((target("avx512f,avx512dq")))
+inline void kahanAdd(__m512d & sum, __m512d & error, __m512d x){
+    __m512d y = _mm512_sub_pd(x, error);
+    __m512d t = _mm512_add_pd(sum, y);
+    error = _mm512_sub_pd(_mm512_sub_pd(t, sum), y);
+    sum = t;
+}
+
+// Count, compensated sums and extremes, 16 values per step
+template<typename T>
+__attribute__((target("avx512f,avx512dq")))
+Reduction reduceAVX512(const T * values, std::size_t count){
+    __m512d sum[2] = { _mm512_setzero_pd(), _mm512_setzero_pd() };
+    __m512d sumError[2] = { _mm512_setzero_pd(), _mm512_setzero_pd() };
+    __m512d squares[2] = { _mm512_setzero_pd(), _mm512_setzero_pd() };
+    __m512d squaresError[2] = { _mm512_setzero_pd(), _mm512_setzero_pd() };
+    __m512d low = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    __m512d high = _mm512_set1_pd(-std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        for(int j=0; j<2; j++){
+            __m512d x = reduceLoad8(values + i + 8*j);
+            kahanAdd(sum[j], sumError[j], x);
+            kahanAdd(squares[j], squaresError[j], _mm512_mul_pd(x, x));
+            low = _mm512_min_pd(low, x);
+            high = _mm512_max_pd(high, x);
+        }
+    }
+
+    // Fold the lanes through scalar Kahan sums, then finish the tail
+    Reduction result = reduceScalar(values + i, count - i);
+    KahanSum totalSum, totalSquares;
+    totalSum.add(result.sum);
+    totalSquares.add(result.sumSquares);
+    double lanes[16];
+    for(int j=0; j<2; j++){
+        _mm512_storeu_pd(lanes, sum[j]);
+        _mm512_storeu_pd(lanes + 8, sumError[j]);
+        for(int k=0; k<8; k++) totalSum.add(lanes[k] - lanes[k + 8]);
+        _mm512_storeu_pd(lanes, squares[j]);
+        _mm512_storeu_pd(lanes + 8, squaresError[j]);
+        for(int k=0; k<8; k++) totalSquares.add(lanes[k] - lanes[k + 8]);
+    }
+    result.min = std::min(result.min, _mm512_reduce_min_pd(low));
+    result.max = std::max(result.max, _mm512_reduce_max_pd(high));
+    result.count = count;
+    result.sum = totalSum.sum;
+    result.sumSquares = totalSquares.sum;
+    return result;
+}
+
+// Moments of one block, 16 values per step
+template<typename T>
+__attribute__((target("avx512f,avx512dq")))
+Moments momentsAVX512(const T * values, std::size_t count){
+    __m512d sum[2] = { _mm512_setzero_pd(), _mm512_setzero_pd() };
+    __m512d low = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    __m512d high = _mm512_set1_pd(-std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        for(int j=0; j<2; j++){
+            __m512d x = reduceLoad8(values + i + 8*j);
+            sum[j] = _mm512_add_pd(sum[j], x);
+            low = _mm512_min_pd(low, x);
+            high = _mm512_max_pd(high, x);
+        }
+    }
+    double total = _mm512_reduce_add_pd(_mm512_add_pd(sum[0], sum[1]));
+    double min = _mm512_reduce_min_pd(low), max = _mm512_reduce_max_pd(high);
+    for(std::size_t t=i; t<count; t++){
+        double x = (double)values[t];
+        total += x;
+        if(x < min) min = x;
+        if(x > max) max = x;
+    }
+    double c = total / count;
+
+    // Second pass over the block, now in cache
+    __m512d center = _mm512_set1_pd(c);
+    __m512d s1 = _mm512_setzero_pd(), s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd(), s4 = _mm512_setzero_pd();
+    for(i=0; i + 8 <= count; i += 8){
+        __m512d d = _mm512_sub_pd(reduceLoad8(values + i), center);
+        __m512d d2 = _mm512_mul_pd(d, d);
+        s1 = _mm512_add_pd(s1, d);
+        s2 = _mm512_add_pd(s2, d2);
+        s3 = _mm512_fmadd_pd(d2, d, s3);
+        s4 = _mm512_fmadd_pd(d2, d2, s4);
+    }
+    double t1 = _mm512_reduce_add_pd(s1), t2 = _mm512_reduce_add_pd(s2);
+    double t3 = _mm512_reduce_add_pd(s3), t4 = _mm512_reduce_add_pd(s4);
+    for(; i<count; i++){
+        double d = (double)values[i] - c;
+        double d2 = d * d;
+        t1 += d;
+        t2 += d2;
+        t3 += d2 * d;
+        t4 += d2 * d2;
+    }
+    return shiftedMoments(count, c, t1, t2, t3, t4, min, max);
+}
+#endif
+
+/*
+ * Dispatch
+ */
+
+// Reduction kernels picked for one value type
+template<typename T>
+struct ReductionKernels {
+    Reduction (*reduce)(const T *, std::size_t);
+    Moments (*moments)(const T *, std::size_t);
+};
+
+// Widest level the cpu supports, 2 for AVX-512, 1 for AVX2, 0 for neither
+inline int reductionLevel(){
+#ifdef REDUCE_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return 2;
+    if(__builtin_cpu_supports("avx2")) return 1;
+#endif
+    return 0;
+}
+
+// Types the vector kernels cannot load only get the scalar kernels
+template<typename T>
+ReductionKernels<T> reductionSelect(std::false_type){
+    return ReductionKernels<T>{reduceScalar<T>, momentsScalar<T>};
+}
+
+// Pick the widest kernels the cpu supports
+template<typename T>
+ReductionKernels<T> reductionSelect(std::true_type){
+#ifdef REDUCE_SIMD
+    switch(reductionLevel()){
+        case 2: return ReductionKernels<T>{reduceAVX512<T>, momentsAVX512<T>};
+        case 1: return ReductionKernels<T>{reduceAVX2<T>, momentsAVX2<T>};
+    }
+#endif
+    return ReductionKernels<T>{reduceScalar<T>, momentsScalar<T>};
+}
+
+// Kernels for T on this cpu, picked on first use
+template<typename T>
+const ReductionKernels<T> & reductionKernels(){
+    static const ReductionKernels<T> kernels = reductionSelect<T>(SimdReducible<T>());
+    return kernels;
+}
+
+// Count, Kahan compensated sum and sum of squares, min and max in one pass
+template<typename T>
+Reduction reduce(const T * values, std::size_t count){
+    return reductionKernels<T>().reduce(values, count);
+}
+
+// Central moments in one pass over memory, merging block moments as it goes
+template<typename T>
+Moments moments(const T * values, std::size_t count){
+    Moments result;
+    for(std::size_t i=0; i<count; i+=momentsBlock){
+        mergeMoments(result, reductionKernels<T>().moments(values + i, std::min(momentsBlock, count - i)));
+    }
+    return result;
+}
+
+// Name of the reduction kernel used on this cpu
+inline const char * reductionKernel(){
+    static const char * names[] = { "scalar", "avx2", "avx512" };
+    return names[reductionLevel()];
+}
+
+
+#endif
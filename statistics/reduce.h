@@ -0,0 +1,73 @@
+/*
+ * reduce.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Vectorized reductions over contiguous int32, int64, float and double
+ * arrays for the stats library, with AVX2 and AVX-512 kernels picked at
+ * runtime and a scalar fallback for everything else.
+*/
+
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Count, compensated sums and extremes of a run of values
+struct Reduction {
+    std::size_t count = 0;
+    double sum = 0;
+    double sumSquares = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+};
+
+// Count, mean, sums of powers of deviations from the mean and extremes of a run of values
+struct Moments {
+    std::size_t count = 0;
+    double mean = 0;
+    double m2 = 0, m3 = 0, m4 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+};
+
+// Types the vector kernels load directly, everything else takes the scalar path
+template<typename T>
+struct SimdReducible : std::integral_constant<bool,
+    std::is_same<T, float>::value || std::is_same<T, double>::value ||
+    (std::is_integral<T>::value && std::is_signed<T>::value && (sizeof(T) == 4 || sizeof(T) == 8))> {};
+
+// Values per block in moments(), each block is read from memory once and
+// walked a second time from cache to center it on its own mean
+const std::size_t momentsBlock = 2048;
+
+// Count, Kahan compensated sum and sum of squares, min and max in one pass
+template<typename T>
+Reduction reduce(const T * values, std::size_t count);
+
+// Central moments in one pass over memory, block by block
+template<typename T>
+Moments moments(const T * values, std::size_t count);
+
+// Fold the moments of one run into another with the pairwise update of Chan and Pebay
+void mergeMoments(Moments & into, const Moments & from);
+
+// Merge partials pairwise into partials[0] with Partial::merge, in a tree whose
+// shape depends only on how many partials there are, so splitting the work over
+// any number of threads gives the same result bit for bit
+template<typename Partial>
+void mergeTree(std::vector<Partial> & partials);
+
+// Name of the reduction kernel used on this cpu ("avx512", "avx2" or "scalar")
+const char * reductionKernel();
+
+#include "reduce.cpp"
+
+#endif
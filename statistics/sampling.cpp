@@ -0,0 +1,198 @@
+/*
+ * sampling.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Allocation free sampling without replacement: a fixed array urn drawn
+ * by partial Fisher-Yates, a card deck that also keeps the count left of
+ * each rank, and a batch of independent decks laid out one game per lane
+ * so every draw is a handful of loops the compiler vectorizes.
+*/
+
+#ifndef SAMPLING_CPP
+#define SAMPLING_CPP
+
+#include "sampling.h"
+
+/*
+ * class Urn
+ * Partial Fisher-Yates over a fixed array
+ */
+
+// Urn holding items
+template<typename T, std::size_t N>
+Urn<T, N>::Urn(const std::array<T, N> & items) : _items(items) {}
+
+// Draw a uniformly random item, one step of Fisher-Yates from the back
+template<typename T, std::size_t N>
+T Urn<T, N>::draw(CounterRandom & random){
+    std::size_t pick = random.below(_remaining);
+    _remaining--;
+    std::swap(_items[pick], _items[_remaining]);
+    return _items[_remaining];
+}
+
+// Put every drawn item back, the array still holds the same multiset
+template<typename T, std::size_t N>
+void Urn<T, N>::reset(){
+    _remaining = N;
+}
+
+// Items still in the urn
+template<typename T, std::size_t N>
+std::size_t Urn<T, N>::remaining() const {
+    return _remaining;
+}
+
+/*
+ * class RankDeck
+ * Urn of ranks plus the count left of each rank
+ */
+
+// Full deck
+template<std::size_t Ranks, std::size_t Copies>
+RankDeck<Ranks, Copies>::RankDeck() : _cards(fullDeck()) {
+    _counts.fill(Copies);
+}
+
+// Every card of the deck in rank order
+template<std::size_t Ranks, std::size_t Copies>
+std::array<std::uint8_t, Ranks * Copies> RankDeck<Ranks, Copies>::fullDeck(){
+    std::array<std::uint8_t, Ranks * Copies> cards;
+    for(std::size_t i=0; i<cards.size(); i++){
+        cards[i] = i / Copies;
+    }
+    return cards;
+}
+
+// Draw a uniformly random card, returning its rank
+template<std::size_t Ranks, std::size_t Copies>
+int RankDeck<Ranks, Copies>::draw(CounterRandom & random){
+    std::uint8_t rank = _cards.draw(random);
+    _counts[rank]--;
+    return rank;
+}
+
+// Shuffle every card back in
+template<std::size_t Ranks, std::size_t Copies>
+void RankDeck<Ranks, Copies>::reset(){
+    _cards.reset();
+    _counts.fill(Copies);
+}
+
+// Cards left in the deck
+template<std::size_t Ranks, std::size_t Copies>
+std::size_t RankDeck<Ranks, Copies>::remaining() const {
+    return _cards.remaining();
+}
+
+// Cards of rank rank left
+template<std::size_t Ranks, std::size_t Copies>
+int RankDeck<Ranks, Copies>::count(int rank) const {
+    return _counts[rank];
+}
+
+// Cards left ranked above rank
+template<std::size_t Ranks, std::size_t Copies>
+int RankDeck<Ranks, Copies>::above(int rank) const {
+    int sum = 0;
+    for(std::size_t r=rank+1; r<Ranks; r++){
+        sum += _counts[r];
+    }
+    return sum;
+}
+
+// Cards left ranked below rank
+template<std::size_t Ranks, std::size_t Copies>
+int RankDeck<Ranks, Copies>::below(int rank) const {
+    int sum = 0;
+    for(int r=0; r<rank; r++){
+        sum += _counts[r];
+    }
+    return sum;
+}
+
+/*
+ * class DeckLanes
+ * Rank counts of many decks, one byte per lane
+ */
+
+// Every lane holds a full deck
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+DeckLanes<Ranks, Copies, Lanes>::DeckLanes(){
+    static_assert(Ranks * Copies < 256, "Deck must fit byte counts");
+    static_assert(Lanes >= 16 && (Lanes & (Lanes - 1)) == 0, "Lanes must be a power of two of at least 16");
+    reset();
+}
+
+// Draw one card in every lane
+// Each lane takes 32 random bits and scales them to a position below the
+// cards it has left (bias about 2^-26 for decks this small), then finds the
+// rank holding that position by a running count over ranks
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+void DeckLanes<Ranks, Copies, Lanes>::draw(CounterRandom & random, std::uint8_t * ranks){
+    std::uint8_t left[Lanes], picks[Lanes];
+    std::memcpy(left, &_remaining, Lanes);
+    for(std::size_t lane=0; lane<Lanes; lane+=2){
+        std::uint64_t bits = random();
+        picks[lane] = ((bits & 0xffffffff) * left[lane]) >> 32;
+        picks[lane + 1] = ((bits >> 32) * left[lane + 1]) >> 32;
+    }
+    Bytes position, seen = {}, rank = {};
+    std::memcpy(&position, picks, Lanes);
+
+    // Comparisons give all ones in true lanes, so subtracting them counts
+    for(std::size_t r=0; r<Ranks; r++){
+        seen += _counts[r];
+        rank -= (Bytes)(seen <= position);
+    }
+    for(std::size_t r=0; r<Ranks; r++){
+        _counts[r] += (Bytes)(rank == (std::uint8_t)r);
+    }
+    _remaining += (Bytes)(_remaining > 0);
+    std::memcpy(ranks, &rank, Lanes);
+}
+
+// Shuffle every card back in for lanes with reset[lane] set
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+void DeckLanes<Ranks, Copies, Lanes>::reset(const std::uint8_t * reset){
+    Bytes mask;
+    std::memcpy(&mask, reset, Lanes);
+    mask = (Bytes)(mask != 0);
+    for(std::size_t r=0; r<Ranks; r++){
+        _counts[r] = (_counts[r] & ~mask) | (mask & (std::uint8_t)Copies);
+    }
+    _remaining = (_remaining & ~mask) | (mask & (std::uint8_t)(Ranks * Copies));
+}
+
+// Shuffle every card back in for every lane
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+void DeckLanes<Ranks, Copies, Lanes>::reset(){
+    Bytes full = {};
+    for(std::size_t r=0; r<Ranks; r++){
+        _counts[r] = full + (std::uint8_t)Copies;
+    }
+    _remaining = full + (std::uint8_t)(Ranks * Copies);
+}
+
+// Cards left above and below ranks[lane] in each lane
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+void DeckLanes<Ranks, Copies, Lanes>::around(const std::uint8_t * ranks, std::uint8_t * above, std::uint8_t * below) const {
+    Bytes card, over = {}, under = {};
+    std::memcpy(&card, ranks, Lanes);
+    for(std::size_t r=0; r<Ranks; r++){
+        over += _counts[r] & (Bytes)(card < (std::uint8_t)r);
+        under += _counts[r] & (Bytes)(card > (std::uint8_t)r);
+    }
+    std::memcpy(above, &over, Lanes);
+    std::memcpy(below, &under, Lanes);
+}
+
+// Cards left in lane lane
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes>
+std::size_t DeckLanes<Ranks, Copies, Lanes>::remaining(std::size_t lane) const {
+    return ((const std::uint8_t *)&_remaining)[lane];
+}
+
+#endif
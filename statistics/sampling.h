@@ -0,0 +1,127 @@
+/*
+ * sampling.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Allocation free sampling without replacement: a fixed array urn drawn
+ * by partial Fisher-Yates, a card deck that also keeps the count left of
+ * each rank, and a batch of independent decks laid out one game per lane
+ * so every draw is a handful of loops the compiler vectorizes.
+*/
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <array>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "random.h"
+
+// Fixed multiset of N items drawn without replacement
+// Drawn items are swapped to the back of the array, so reset() only has to
+// forget how many were drawn
+template<typename T, std::size_t N>
+class Urn {
+public:
+    // Urn holding items
+    explicit Urn(const std::array<T, N> & items);
+
+    // Draw a uniformly random item still in the urn, remaining() > 0
+    T draw(CounterRandom & random);
+
+    // Put every drawn item back
+    void reset();
+
+    // Items still in the urn
+    std::size_t remaining() const;
+
+protected:
+    std::array<T, N> _items;
+    std::size_t _remaining = N;
+};
+
+// Deck of Ranks ranks with Copies cards of each, drawn without replacement,
+// that knows how many cards of each rank are left
+template<std::size_t Ranks, std::size_t Copies>
+class RankDeck {
+public:
+    // Full deck
+    RankDeck();
+
+    // Draw a uniformly random card, returning its rank
+    int draw(CounterRandom & random);
+
+    // Shuffle every card back in
+    void reset();
+
+    // Cards left in the deck
+    std::size_t remaining() const;
+
+    // Cards of rank rank left
+    int count(int rank) const;
+
+    // Cards left ranked above rank
+    int above(int rank) const;
+
+    // Cards left ranked below rank
+    int below(int rank) const;
+
+protected:
+    // Every card of the deck in rank order
+    static std::array<std::uint8_t, Ranks * Copies> fullDeck();
+
+    Urn<std::uint8_t, Ranks * Copies> _cards;
+    std::array<std::uint8_t, Ranks> _counts;
+};
+
+// Standard 52 card deck, 13 ranks from 0 (low) to 12
+typedef RankDeck<13, 4> CardDeck;
+
+// Lanes independent RankDecks drawn together, one game per lane
+// State is a vector of byte counts per rank, one byte per lane, so each step
+// is a few vector instructions over every lane at once. Cards are picked by
+// rank count rather than position, the same distribution for the
+// indistinguishable cards of a rank
+template<std::size_t Ranks, std::size_t Copies, std::size_t Lanes = 16>
+class DeckLanes {
+public:
+    static const std::size_t lanes = Lanes;
+
+    // Every lane holds a full deck
+    DeckLanes();
+
+    // Draw one card in every lane, writing its rank to ranks[lane]
+    // Lanes with an empty deck draw rank Ranks
+    void draw(CounterRandom & random, std::uint8_t * ranks);
+
+    // Shuffle every card back in for lanes with reset[lane] set
+    void reset(const std::uint8_t * reset);
+
+    // Shuffle every card back in for every lane
+    void reset();
+
+    // Cards left above and below ranks[lane] in each lane
+    void around(const std::uint8_t * ranks, std::uint8_t * above, std::uint8_t * below) const;
+
+    // Cards left in lane lane
+    std::size_t remaining(std::size_t lane) const;
+
+protected:
+    // One byte per lane, 16 lanes fill one SSE2 or NEON register, wider
+    // vectors only stay in registers when built for AVX2 or better
+    typedef std::uint8_t Bytes __attribute__((vector_size(Lanes)));
+
+    Bytes _counts[Ranks];
+    Bytes _remaining;
+};
+
+// Standard 52 card decks, 16 games at once
+typedef DeckLanes<13, 4> CardDeckLanes;
+
+#include "sampling.cpp"
+
+#endif
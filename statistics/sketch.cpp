@@ -0,0 +1,506 @@
+/*
+ * sketch.cpp
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Mergeable streaming quantile sketches in fixed memory, a t-digest for
+ * accurate tails and a KLL sketch with a uniform rank error bound. Both
+ * serialize to a portable byte string so partial sketches built in
+ * different processes can be combined.
+*/
+
+#ifndef SKETCH_CPP
+#define SKETCH_CPP
+
+#include "sketch.h"
+
+/*
+ * Serialization helpers
+ * Every field is 64 bits, least significant byte first
+ */
+
+// Append a 64 bit integer
+inline void sketchPut(std::string & out, std::uint64_t value){
+    for(int i=0; i<8; i++){
+        out.push_back((char)(value >> (8*i)));
+    }
+}
+
+// Append a double by its bit pattern
+inline void sketchPutDouble(std::string & out, double value){
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    sketchPut(out, bits);
+}
+
+// Read a 64 bit integer at pos and step past it
+inline std::uint64_t sketchGet(const std::string & data, std::size_t & pos){
+    if(data.size() < pos + 8){
+        throw std::invalid_argument("Serialized sketch is truncated.");
+    }
+    std::uint64_t value = 0;
+    for(int i=0; i<8; i++){
+        value |= (std::uint64_t)(unsigned char)data[pos + i] << (8*i);
+    }
+    pos += 8;
+    return value;
+}
+
+// Read a double at pos and step past it
+inline double sketchGetDouble(const std::string & data, std::size_t & pos){
+    std::uint64_t bits = sketchGet(data, pos);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*
+ * class TDigest
+ * Merging t-digest with the logistic scale function
+ */
+
+// More compression keeps more centroids
+inline TDigest::TDigest(double compression): _compression(compression){
+    if(!(compression >= 10)){
+        throw std::invalid_argument("t-digest compression must be at least 10.");
+    }
+    _bufferLimit = (std::size_t)std::ceil(5 * compression);
+    clear();
+}
+
+// Add a value with the given weight
+inline void TDigest::add(double value, double weight){
+    if(_buffer.size() >= _bufferLimit){
+        compress();
+    }
+    _buffer.push_back(Centroid{value, weight});
+    _count += weight;
+    _min = std::min(_min, value);
+    _max = std::max(_max, value);
+}
+
+// Add every value in a range
+template<typename Iterator>
+void TDigest::add(Iterator first, Iterator last){
+    for(; first != last; ++first){
+        add((double)*first);
+    }
+}
+
+// Fold in the values another digest has seen, centroids and buffer alike,
+// leaving other untouched
+inline void TDigest::merge(const TDigest & other){
+    for(const auto * list : { &other._centroids, &other._buffer }){
+        for(const auto & centroid : *list){
+            if(_buffer.size() >= _bufferLimit){
+                compress();
+            }
+            _buffer.push_back(centroid);
+        }
+    }
+    _count += other._count;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    compress();
+}
+
+// Estimated value at quantile q, interpolating between centroid centers
+// with the exact extremes as the end points
+inline double TDigest::quantile(double q){
+    compress();
+    if(_centroids.empty()){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if(q <= 0) return _min;
+    if(q >= 1) return _max;
+
+    double target = q * _count;
+    double left = 0, leftValue = _min;
+    double before = 0;
+    for(const auto & centroid : _centroids){
+        double center = before + centroid.weight / 2;
+        if(target < center){
+            if(center <= left){
+                return centroid.mean;
+            }
+            return leftValue + (centroid.mean - leftValue) * (target - left) / (center - left);
+        }
+        before += centroid.weight;
+        left = center;
+        leftValue = centroid.mean;
+    }
+    if(_count <= left){
+        return _max;
+    }
+    return leftValue + (_max - leftValue) * (target - left) / (_count - left);
+}
+
+// Estimated fraction of values at or below x
+inline double TDigest::cdf(double x){
+    compress();
+    if(_centroids.empty()){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if(x < _min) return 0;
+    if(x >= _max) return 1;
+
+    double left = 0, leftValue = _min;
+    double before = 0;
+    for(const auto & centroid : _centroids){
+        double center = before + centroid.weight / 2;
+        if(x < centroid.mean){
+            if(centroid.mean <= leftValue){
+                return left / _count;
+            }
+            return (left + (center - left) * (x - leftValue) / (centroid.mean - leftValue)) / _count;
+        }
+        before += centroid.weight;
+        left = center;
+        leftValue = centroid.mean;
+    }
+    return (left + (_count - left) * (x - leftValue) / (_max - leftValue)) / _count;
+}
+
+// Total weight added
+inline double TDigest::count() const{
+    return _count;
+}
+
+// Number of centroids once buffered values are merged
+inline std::size_t TDigest::size(){
+    compress();
+    return _centroids.size();
+}
+
+// Approximate memory used in bytes
+inline std::size_t TDigest::bytes() const{
+    return sizeof(TDigest) + (_centroids.capacity() + _buffer.capacity()) * sizeof(Centroid);
+}
+
+// Portable byte string holding the whole digest
+inline std::string TDigest::serialize(){
+    compress();
+    std::string out("TDG1");
+    sketchPutDouble(out, _compression);
+    sketchPutDouble(out, _count);
+    sketchPutDouble(out, _min);
+    sketchPutDouble(out, _max);
+    sketchPut(out, _centroids.size());
+    for(const auto & centroid : _centroids){
+        sketchPutDouble(out, centroid.mean);
+        sketchPutDouble(out, centroid.weight);
+    }
+    return out;
+}
+
+// Rebuild a digest from serialize()
+inline TDigest TDigest::deserialize(const std::string & data){
+    if(data.compare(0, 4, "TDG1") != 0){
+        throw std::invalid_argument("Not a serialized t-digest.");
+    }
+    std::size_t pos = 4;
+    TDigest digest(sketchGetDouble(data, pos));
+    digest._count = sketchGetDouble(data, pos);
+    digest._min = sketchGetDouble(data, pos);
+    digest._max = sketchGetDouble(data, pos);
+    std::uint64_t size = sketchGet(data, pos);
+    if(size > (data.size() - pos) / 16){
+        throw std::invalid_argument("Serialized sketch is truncated.");
+    }
+    digest._centroids.resize(size);
+    for(auto & centroid : digest._centroids){
+        centroid.mean = sketchGetDouble(data, pos);
+        centroid.weight = sketchGetDouble(data, pos);
+    }
+    return digest;
+}
+
+// Forget every value
+inline void TDigest::clear(){
+    _count = 0;
+    _min = std::numeric_limits<double>::infinity();
+    _max = -std::numeric_limits<double>::infinity();
+    _centroids.clear();
+    _buffer.clear();
+    _buffer.reserve(_bufferLimit);
+}
+
+// Merge buffered values into the centroid list in one sorted pass, letting
+// each centroid grow until it spans one unit of k(q) = d/z log(q/(1-q)),
+// where z = 4 log(n/d) + 24 keeps the centroid count near d whatever n is
+inline void TDigest::compress(){
+    if(_buffer.empty()){
+        return;
+    }
+    _buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+    std::sort(_buffer.begin(), _buffer.end(), [](const Centroid & a, const Centroid & b){
+        return a.mean < b.mean;
+    });
+
+    double total = 0;
+    for(const auto & centroid : _buffer){
+        total += centroid.weight;
+    }
+    // Largest cumulative weight the centroid starting at soFar may reach
+    double z = 4 * std::log(std::max(total / _compression, 1.0)) + 24;
+    auto limit = [&](double soFar){
+        double q = soFar / total;
+        if(q <= 0) return 0.0;
+        if(q >= 1) return total;
+        double k = _compression / z * std::log(q / (1 - q)) + 1;
+        return total / (1 + std::exp(-k * z / _compression));
+    };
+
+    _centroids.clear();
+    Centroid current = _buffer[0];
+    double soFar = 0, bound = limit(0);
+    for(std::size_t i=1; i<_buffer.size(); i++){
+        const Centroid & next = _buffer[i];
+        if(soFar + current.weight + next.weight <= bound){
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        }
+        else{
+            soFar += current.weight;
+            _centroids.push_back(current);
+            bound = limit(soFar);
+            current = next;
+        }
+    }
+    _centroids.push_back(current);
+    _buffer.clear();
+}
+
+/*
+ * class KLLSketch
+ * KLL sketch over doubles
+ */
+
+// Larger k keeps more values
+inline KLLSketch::KLLSketch(std::size_t k, std::uint64_t seed): _k(k), _random(seed ? seed : 1){
+    if(k < 8){
+        throw std::invalid_argument("KLL sketch needs k of at least 8.");
+    }
+    clear();
+}
+
+// Add one value
+inline void KLLSketch::add(double value){
+    _min = std::min(_min, value);
+    _max = std::max(_max, value);
+    _levels[0].push_back(value);
+    _count++;
+    if(++_size >= _maxSize){
+        compress();
+    }
+}
+
+// Add every value in a range
+template<typename Iterator>
+void KLLSketch::add(Iterator first, Iterator last){
+    for(; first != last; ++first){
+        add((double)*first);
+    }
+}
+
+// Fold in the values another sketch has seen
+inline void KLLSketch::merge(const KLLSketch & other){
+    while(_levels.size() < other._levels.size()){
+        grow();
+    }
+    for(std::size_t h=0; h<other._levels.size(); h++){
+        _levels[h].insert(_levels[h].end(), other._levels[h].begin(), other._levels[h].end());
+        _size += other._levels[h].size();
+    }
+    _count += other._count;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    while(_size >= _maxSize){
+        compress();
+    }
+}
+
+// Estimated value at quantile q, values at level h weigh 2^h
+inline double KLLSketch::quantile(double q) const{
+    if(_count == 0){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if(q <= 0) return _min;
+    if(q >= 1) return _max;
+
+    std::vector<std::pair<double, std::uint64_t>> items;
+    items.reserve(_size);
+    for(std::size_t h=0; h<_levels.size(); h++){
+        for(double value : _levels[h]){
+            items.emplace_back(value, std::uint64_t(1) << h);
+        }
+    }
+    std::sort(items.begin(), items.end());
+
+    double target = q * _count;
+    std::uint64_t rank = 0;
+    for(const auto & item : items){
+        rank += item.second;
+        if(rank >= target){
+            return item.first;
+        }
+    }
+    return _max;
+}
+
+// Estimated fraction of values at or below x
+inline double KLLSketch::cdf(double x) const{
+    if(_count == 0){
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    std::uint64_t rank = 0;
+    for(std::size_t h=0; h<_levels.size(); h++){
+        for(double value : _levels[h]){
+            if(value <= x) rank += std::uint64_t(1) << h;
+        }
+    }
+    return (double)rank / _count;
+}
+
+// Number of values added
+inline std::uint64_t KLLSketch::count() const{
+    return _count;
+}
+
+// Number of values stored
+inline std::size_t KLLSketch::size() const{
+    return _size;
+}
+
+// Approximate memory used in bytes
+inline std::size_t KLLSketch::bytes() const{
+    std::size_t bytes = sizeof(KLLSketch) + _levels.capacity() * sizeof(std::vector<double>);
+    for(const auto & level : _levels){
+        bytes += level.capacity() * sizeof(double);
+    }
+    return bytes;
+}
+
+// Portable byte string holding the whole sketch
+inline std::string KLLSketch::serialize() const{
+    std::string out("KLL1");
+    sketchPut(out, _k);
+    sketchPut(out, _count);
+    sketchPut(out, _random);
+    sketchPutDouble(out, _min);
+    sketchPutDouble(out, _max);
+    sketchPut(out, _levels.size());
+    for(const auto & level : _levels){
+        sketchPut(out, level.size());
+        for(double value : level){
+            sketchPutDouble(out, value);
+        }
+    }
+    return out;
+}
+
+// Rebuild a sketch from serialize()
+inline KLLSketch KLLSketch::deserialize(const std::string & data){
+    if(data.compare(0, 4, "KLL1") != 0){
+        throw std::invalid_argument("Not a serialized KLL sketch.");
+    }
+    std::size_t pos = 4;
+    std::uint64_t k = sketchGet(data, pos);
+    std::uint64_t count = sketchGet(data, pos);
+    KLLSketch sketch(k, sketchGet(data, pos));
+    sketch._count = count;
+    sketch._min = sketchGetDouble(data, pos);
+    sketch._max = sketchGetDouble(data, pos);
+    std::uint64_t levels = sketchGet(data, pos);
+    if(levels > 64){
+        throw std::invalid_argument("Serialized KLL sketch has too many levels.");
+    }
+    while(sketch._levels.size() < levels){
+        sketch.grow();
+    }
+    for(auto & level : sketch._levels){
+        std::uint64_t size = sketchGet(data, pos);
+        if(size > (data.size() - pos) / 8){
+            throw std::invalid_argument("Serialized sketch is truncated.");
+        }
+        level.resize(size);
+        for(auto & value : level){
+            value = sketchGetDouble(data, pos);
+        }
+        sketch._size += size;
+    }
+    while(sketch._size >= sketch._maxSize){
+        sketch.compress();
+    }
+    return sketch;
+}
+
+// Forget every value
+inline void KLLSketch::clear(){
+    _count = 0;
+    _size = 0;
+    _min = std::numeric_limits<double>::infinity();
+    _max = -std::numeric_limits<double>::infinity();
+    _levels.clear();
+    grow();
+}
+
+// Values a level may hold, shrinking by 2/3 per level below the top
+inline std::size_t KLLSketch::capacity(std::size_t level) const{
+    std::size_t depth = _levels.size() - level - 1;
+    return (std::size_t)std::ceil(_k * std::pow(2.0 / 3.0, (double)depth)) + 1;
+}
+
+// Add a level on top
+inline void KLLSketch::grow(){
+    _levels.emplace_back();
+    _maxSize = 0;
+    for(std::size_t h=0; h<_levels.size(); h++){
+        _maxSize += capacity(h);
+    }
+}
+
+// Compact the lowest full level, sorting it and promoting every other
+// value to the next level with a random offset
+inline void KLLSketch::compress(){
+    for(std::size_t h=0; h<_levels.size(); h++){
+        if(_levels[h].size() < capacity(h)){
+            continue;
+        }
+        if(h + 1 == _levels.size()){
+            grow();
+        }
+        std::vector<double> & level = _levels[h];
+        std::vector<double> & above = _levels[h + 1];
+        std::sort(level.begin(), level.end());
+
+        // An odd value out stays behind
+        std::size_t even = level.size() & ~std::size_t(1);
+        for(std::size_t i=coin() ? 1 : 0; i<even; i+=2){
+            above.push_back(level[i]);
+        }
+        if(level.size() > even){
+            level[0] = level.back();
+            level.resize(1);
+        }
+        else{
+            level.clear();
+        }
+        _size -= even / 2;
+        if(_size < _maxSize){
+            return;
+        }
+    }
+}
+
+// Next random bit from a xorshift generator
+inline bool KLLSketch::coin(){
+    _random ^= _random << 13;
+    _random ^= _random >> 7;
+    _random ^= _random << 17;
+    return _random & 1;
+}
+
+
+#endif
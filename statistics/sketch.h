@@ -0,0 +1,156 @@
+/*
+ * sketch.h
+ * Author: Aven Bross
+ * Date: 10/19/2015
+ *
+ * Description:
+ * Mergeable streaming quantile sketches in fixed memory, a t-digest for
+ * accurate tails and a KLL sketch with a uniform rank error bound. Both
+ * serialize to a portable byte string so partial sketches built in
+ * different processes can be combined.
+*/
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+
+// Merging t-digest (Dunning) with the logistic k2 scale function
+// Centroids shrink toward single values near q = 0 and q = 1, so p99.9 and
+// beyond stay accurate while memory is bounded by about compression centroids
+// Rank error grows toward the median in exchange
+// Queries merge buffered values first, so they are not const and a digest
+// shared between threads needs a lock even to read it
+class TDigest {
+public:
+    // More compression keeps more centroids and gives smaller errors
+    TDigest(double compression = 200);
+
+    // Add a value with the given weight
+    void add(double value, double weight = 1);
+
+    // Add every value in a range
+    template<typename Iterator>
+    void add(Iterator first, Iterator last);
+
+    // Fold in the values another digest has seen
+    void merge(const TDigest & other);
+
+    // Estimated value at quantile q in [0, 1]
+    double quantile(double q);
+
+    // Estimated fraction of values at or below x
+    double cdf(double x);
+
+    // Total weight added
+    double count() const;
+
+    // Number of centroids once buffered values are merged
+    std::size_t size();
+
+    // Approximate memory used in bytes
+    std::size_t bytes() const;
+
+    // Portable byte string holding the whole digest
+    std::string serialize();
+
+    // Rebuild a digest from serialize(), throws std::invalid_argument on bad input
+    static TDigest deserialize(const std::string & data);
+
+    // Forget every value
+    void clear();
+
+protected:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // Merge buffered values into the centroid list
+    void compress();
+
+    double _compression;
+    double _count = 0;
+    double _min, _max;
+    std::size_t _bufferLimit;   // Buffered values before a merge pass
+
+    // Sorted centroids and unsorted new values, merged by the first query after an add
+    std::vector<Centroid> _centroids;
+    std::vector<Centroid> _buffer;
+};
+
+// KLL sketch (Karnin, Lang, Liberty) over doubles
+// Rank error is about 1.7/k of the count with high probability, whatever
+// the distribution, using about 3k stored values
+class KLLSketch {
+public:
+    // Larger k keeps more values and gives smaller errors
+    KLLSketch(std::size_t k = 200, std::uint64_t seed = 0x9e3779b97f4a7c15ULL);
+
+    // Add one value
+    void add(double value);
+
+    // Add every value in a range
+    template<typename Iterator>
+    void add(Iterator first, Iterator last);
+
+    // Fold in the values another sketch has seen
+    void merge(const KLLSketch & other);
+
+    // Estimated value at quantile q in [0, 1]
+    double quantile(double q) const;
+
+    // Estimated fraction of values at or below x
+    double cdf(double x) const;
+
+    // Number of values added
+    std::uint64_t count() const;
+
+    // Number of values stored
+    std::size_t size() const;
+
+    // Approximate memory used in bytes
+    std::size_t bytes() const;
+
+    // Portable byte string holding the whole sketch
+    std::string serialize() const;
+
+    // Rebuild a sketch from serialize(), throws std::invalid_argument on bad input
+    static KLLSketch deserialize(const std::string & data);
+
+    // Forget every value
+    void clear();
+
+protected:
+    // Values a level may hold before it is compacted
+    std::size_t capacity(std::size_t level) const;
+
+    // Add a level on top
+    void grow();
+
+    // Compact full levels until the sketch fits again
+    void compress();
+
+    // Next random bit for picking which half survives a compaction
+    bool coin();
+
+    std::size_t _k;
+    std::uint64_t _count = 0;
+    std::size_t _size = 0;      // Values stored over all levels
+    std::size_t _maxSize = 0;   // Sum of level capacities
+    double _min, _max;
+    std::uint64_t _random;
+    std::vector<std::vector<double>> _levels;   // Values at level h stand for 2^h values each
+};
+
+#include "sketch.cpp"
+
+#endif
@@ -12,41 +12,220 @@
 
 #include "stats.h"
 
+/*
+ * class OneVarAccumulator
+ * Streaming one pass accumulator for one variable
+ */
+
+// Start empty
 template<typename T>
-void oneVarStats(std::vector<T> records){
-    double rounds = records.size();
-    // Histogram of iteration numbers
-    std::map<T,int> histogram;
+OneVarAccumulator<T>::OneVarAccumulator(){
+    reset();
+}
+
+// Add one value, updating the central moments highest first so each uses the old lower ones
+template<typename T>
+void OneVarAccumulator<T>::add(const T & value){
+    Moments & m = _moments;
+    double x = (double)value;
+    double n1 = (double)m.count;
+    double n = n1 + 1;
+    double delta = x - m.mean;
+    double deltaN = delta / n;
+    double deltaN2 = deltaN * deltaN;
+    double term = delta * deltaN * n1;
+    
+    m.mean += deltaN;
+    m.m4 += term * deltaN2 * (n*n - 3*n + 3) + 6 * deltaN2 * m.m2 - 4 * deltaN * m.m3;
+    m.m3 += term * deltaN * (n - 2) - 3 * deltaN * m.m2;
+    m.m2 += term;
+    m.count++;
     
-    // Find mean and fill histogram
-    double total = 0;
-    for(auto iterations : records){
-        total += (double)iterations;
-        histogram[iterations]+=1;
+    if(x < m.min) m.min = x;
+    if(x > m.max) m.max = x;
+}
+
+// Add count values stored contiguously, a cached block at a time
+template<typename T>
+void OneVarAccumulator<T>::add(const T * values, std::size_t count){
+    mergeMoments(_moments, moments(values, count));
+}
+
+// Add every value in a range
+template<typename T>
+template<typename Iterator>
+void OneVarAccumulator<T>::add(Iterator first, Iterator last){
+    addRange(first, last, IsContiguous<Iterator>());
+}
+
+// Fold in moments computed elsewhere
+template<typename T>
+void OneVarAccumulator<T>::add(const Moments & moments){
+    mergeMoments(_moments, moments);
+}
+
+// Fold in another accumulator with the pairwise update of Chan and Pebay
+template<typename T>
+void OneVarAccumulator<T>::merge(const OneVarAccumulator & other){
+    mergeMoments(_moments, other._moments);
+}
+
+// Number of values added
+template<typename T>
+std::size_t OneVarAccumulator<T>::count() const{
+    return _moments.count;
+}
+
+// Summary of every value added so far
+template<typename T>
+OneVarResult OneVarAccumulator<T>::result() const{
+    const Moments & m = _moments;
+    OneVarResult result;
+    result.count = m.count;
+    if(m.count == 0){
+        return result;
+    }
+    double n = (double)m.count;
+    result.mean = m.mean;
+    result.variance = m.m2 / n;
+    result.sampleVariance = (m.count > 1) ? m.m2 / (n - 1) : 0;
+    result.sd = std::sqrt(result.variance);
+    result.min = m.min;
+    result.max = m.max;
+    if(m.m2 > 0){
+        result.skewness = std::sqrt(n) * m.m3 / std::pow(m.m2, 1.5);
+        result.kurtosis = n * m.m4 / (m.m2 * m.m2) - 3;
+    }
+    return result;
+}
+
+// Forget every value
+template<typename T>
+void OneVarAccumulator<T>::reset(){
+    _moments = Moments();
+}
+
+// Add a range one value at a time
+template<typename T>
+template<typename Iterator>
+void OneVarAccumulator<T>::addRange(Iterator first, Iterator last, std::false_type){
+    for(; first != last; ++first){
+        add(*first);
+    }
+}
+
+// Add a contiguous range through the vector kernels
+template<typename T>
+template<typename Iterator>
+void OneVarAccumulator<T>::addRange(Iterator first, Iterator last, std::true_type){
+    if(first != last){
+        add(&*first, last - first);
     }
-    double average = total/rounds;
+}
+
+/*
+ * Parallel reduction
+ */
+
+// Shared body of parallelOneVarStats, histogram may be NULL
+template<typename Iterator, typename Histogram>
+OneVarResult parallelOneVarStats(Iterator first, Iterator last, Histogram * histogram, unsigned int threads){
+    typedef typename std::iterator_traits<Iterator>::value_type T;
+    
+    std::size_t size = last - first;
+    std::size_t blocks = (size + parallelStatsBlock - 1) / parallelStatsBlock;
+    if(threads == 0) threads = 1;
+    if(threads > blocks) threads = blocks > 0 ? blocks : 1;
     
-    // Find standard deviation
-    double total_square = 0;
-    for(auto iterations : records){
-        total_square += ((double)iterations-average)*((double)iterations-average);
+    // Each thread summarizes a contiguous run of blocks, one partial per block
+    std::vector<OneVarAccumulator<T>> partials(blocks);
+    // Per thread histograms start as empty copies so they share the backend's settings
+    std::vector<Histogram> histograms;
+    if(histogram){
+        Histogram empty(*histogram);
+        empty.clear();
+        histograms.assign(threads, empty);
+    }
+    auto work = [&](unsigned int id){
+        std::size_t begin = blocks * id / threads, end = blocks * (id + 1) / threads;
+        for(std::size_t b=begin; b<end; b++){
+            Iterator from = first + b * parallelStatsBlock;
+            Iterator to = (b + 1 == blocks) ? last : from + parallelStatsBlock;
+            partials[b].add(from, to);
+            if(histogram){
+                addToHistogram(histograms[id], from, to);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for(unsigned int id=1; id<threads; id++){
+        pool.emplace_back(work, id);
+    }
+    work(0);
+    for(auto & thread : pool){
+        thread.join();
     }
-    double sd = std::sqrt(total_square/rounds);
     
-    // Print out main stats
-    std::cout << "MAIN STATS:\n";
-    std::cout << "Rounds: " << rounds << "\n";
-    std::cout << "Average: " << average << "\n";
-    std::cout << "Standard Deviation: " << sd << "\n\n";
+    mergeTree(partials);
+    if(histogram){
+        for(const auto & partial : histograms){
+            mergeHistogram(*histogram, partial);
+        }
+    }
+    return blocks > 0 ? partials[0].result() : OneVarResult();
+}
+
+// Summarize a random access range on threads threads
+template<typename Iterator>
+OneVarResult parallelOneVarStats(Iterator first, Iterator last, unsigned int threads){
+    typedef typename std::iterator_traits<Iterator>::value_type T;
+    return parallelOneVarStats(first, last, (std::map<T,std::size_t> *)NULL, threads);
+}
+
+// Summarize a random access range on threads threads and count each value into histogram
+template<typename Iterator, typename Histogram>
+typename std::enable_if<!std::is_arithmetic<Histogram>::value, OneVarResult>::type
+parallelOneVarStats(Iterator first, Iterator last, Histogram & histogram, unsigned int threads){
+    return parallelOneVarStats(first, last, &histogram, threads);
+}
+
+/*
+ * Formatting
+ */
+
+// Print the summary the way oneVarStats always has
+inline void printStats(const OneVarResult & result, std::ostream & out){
+    out << "MAIN STATS:\n";
+    out << "Rounds: " << result.count << "\n";
+    out << "Average: " << result.mean << "\n";
+    out << "Standard Deviation: " << result.sd << "\n";
+    out << "Min: " << result.min << "\tMax: " << result.max << "\n";
+    out << "Skewness: " << result.skewness << "\tKurtosis: " << result.kurtosis << "\n\n";
+}
+
+// Print a histogram of values with its pdf and cdf
+template<typename Histogram>
+void printHistogram(const Histogram & histogram, std::ostream & out){
+    double rounds = 0;
+    forEachBin(histogram, [&](const auto &, std::size_t count){
+        rounds += count;
+    });
     
-    // Print out round data
-    std::cout << "ROUND DATA:\n";
+    out << "ROUND DATA:\n";
     double sum = 0;
-    for(const auto cat : histogram){
-        sum += cat.second;
-        std::cout << "Iterations: " << cat.first << "\tRounds: " << ((double)cat.second) << "\tPDF: " << ((double)cat.second)/rounds  << "\tCDF: " << sum/rounds << "\n";
-    }
+    forEachBin(histogram, [&](const auto & value, std::size_t count){
+        sum += count;
+        out << "Iterations: " << value << "\tRounds: " << ((double)count) << "\tPDF: " << ((double)count)/rounds  << "\tCDF: " << sum/rounds << "\n";
+    });
 }
 
+// Print summary and histogram of records
+template<typename T, typename Histogram>
+void oneVarStats(const std::vector<T> & records){
+    Histogram histogram;
+    OneVarResult result = parallelOneVarStats(records.begin(), records.end(), histogram);
+    printStats(result);
+    printHistogram(histogram);
+}
 
 #endif
@@ -14,9 +14,108 @@
 #include <map>
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <type_traits>
 
+#include "histogram.h"
+#include "reduce.h"
+
+// Summary of one variable, moments are population moments
+struct OneVarResult {
+    std::size_t count = 0;
+    double mean = 0;
+    double variance = 0;        // Population variance
+    double sampleVariance = 0;  // Bessel corrected variance
+    double sd = 0;              // Population standard deviation
+    double min = 0;
+    double max = 0;
+    double skewness = 0;
+    double kurtosis = 0;        // Excess kurtosis, 0 for a normal distribution
+};
+
+// Iterators known to point into contiguous storage
+template<typename Iterator, typename T = typename std::iterator_traits<Iterator>::value_type>
+struct IsContiguous : std::integral_constant<bool, !std::is_same<T, bool>::value &&
+    (std::is_pointer<Iterator>::value ||
+     std::is_same<Iterator, typename std::vector<T>::iterator>::value ||
+     std::is_same<Iterator, typename std::vector<T>::const_iterator>::value)> {};
+
+// Streaming one pass accumulator for count, mean, variance, extremes, skewness and kurtosis
+// Central moments are updated per value (Welford, Pebay) so nothing is stored
+// Contiguous runs go through the vector moment kernels in reduce.h instead
 template<typename T>
-void oneVarStats(std::vector<T> records);
+class OneVarAccumulator {
+public:
+    // Start empty
+    OneVarAccumulator();
+    
+    // Add one value
+    void add(const T & value);
+    
+    // Add count values stored contiguously
+    void add(const T * values, std::size_t count);
+    
+    // Add every value in a range
+    template<typename Iterator>
+    void add(Iterator first, Iterator last);
+    
+    // Fold in moments computed elsewhere
+    void add(const Moments & moments);
+    
+    // Fold in the values another accumulator has seen, as if they were added here
+    void merge(const OneVarAccumulator & other);
+    
+    // Number of values added
+    std::size_t count() const;
+    
+    // Summary of every value added so far
+    OneVarResult result() const;
+    
+    // Forget every value
+    void reset();
+    
+protected:
+    // Add a range one value at a time
+    template<typename Iterator>
+    void addRange(Iterator first, Iterator last, std::false_type);
+    
+    // Add a contiguous range through the vector kernels
+    template<typename Iterator>
+    void addRange(Iterator first, Iterator last, std::true_type);
+    
+    Moments _moments;
+};
+
+// Values per block in parallelOneVarStats, blocks are reduced in a fixed tree
+// so the result does not depend on the thread count
+const std::size_t parallelStatsBlock = 1 << 16;
+
+// Summarize a random access range on threads threads
+template<typename Iterator>
+OneVarResult parallelOneVarStats(Iterator first, Iterator last,
+                                 unsigned int threads = std::thread::hardware_concurrency());
+
+// Summarize a random access range on threads threads and count each value into histogram,
+// which may be a std::map or any histogram backend
+template<typename Iterator, typename Histogram>
+typename std::enable_if<!std::is_arithmetic<Histogram>::value, OneVarResult>::type
+parallelOneVarStats(Iterator first, Iterator last, Histogram & histogram,
+                    unsigned int threads = std::thread::hardware_concurrency());
+
+// Print the summary the way oneVarStats always has
+void printStats(const OneVarResult & result, std::ostream & out = std::cout);
+
+// Print a histogram of values with its pdf and cdf
+template<typename Histogram>
+void printHistogram(const Histogram & histogram, std::ostream & out = std::cout);
+
+// Print summary and histogram of records, reduced on every core
+// Values are counted exactly in a map unless another histogram backend is given
+template<typename T, typename Histogram = std::map<T,std::size_t>>
+void oneVarStats(const std::vector<T> & records);
 
 #include "stats.cpp"
 